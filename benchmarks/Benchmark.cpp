@@ -0,0 +1,48 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+void Benchmark::NoiseSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    for (int ch = 0; ch < bufferToFill.buffer->getNumChannels(); ++ch)
+    {
+        auto* dest = bufferToFill.buffer->getWritePointer(ch, bufferToFill.startSample);
+
+        for (int i = 0; i < bufferToFill.numSamples; ++i)
+            dest[i] = level * (2.0f * random.nextFloat() - 1.0f);
+    }
+}
+
+Benchmark::CallbackTimes::CallbackTimes(int blockSize, int numCallbacks)
+    : budget(blockSize / kSampleRate)
+{
+    seconds.reserve(static_cast<size_t>(numCallbacks));
+}
+
+void Benchmark::CallbackTimes::add(juce::int64 startTicks, juce::int64 endTicks)
+{
+    seconds.push_back(juce::Time::highResolutionTicksToSeconds(endTicks - startTicks));
+}
+
+juce::String Benchmark::CallbackTimes::summarise() const
+{
+    if (seconds.empty())
+        return "no callbacks";
+
+    auto sorted = seconds;
+    std::sort(sorted.begin(), sorted.end());
+
+    const double mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+    const double p99 = sorted[static_cast<size_t>(0.99 * static_cast<double>(sorted.size() - 1))];
+    const double worst = sorted.back();
+
+    return "mean " + juce::String(mean * 1.0e6, 1) + " us (" + juce::String(100.0 * mean / budget, 2) + "%)"
+         + ", p99 " + juce::String(p99 * 1.0e6, 1) + " us"
+         + ", max " + juce::String(worst * 1.0e6, 1) + " us (" + juce::String(100.0 * worst / budget, 2) + "%)";
+}
+
+void Benchmark::report(const juce::String& line)
+{
+    std::cout << line.toStdString() << std::endl;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <vector>
+
+// Timings for engine processors in isolation, printed one line per case.
+// Each processor is driven by loud noise, and each callback's wall time is
+// compared with the real-time budget of its block.
+class Benchmark
+{
+public:
+    static void runLimiter();
+    static void runReverb();
+    static void runEditLatency();
+    static void runLowPower();
+    static void runOneShots();
+
+    static constexpr double kSampleRate = 48000.0;
+
+    // Stereo white noise at a fixed peak level
+    class NoiseSource : public juce::AudioSource
+    {
+    public:
+        explicit NoiseSource(float peakLevel) : level(peakLevel) {}
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    private:
+        juce::Random random { 1 };
+        float level;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(NoiseSource)
+    };
+
+    // Per-callback times for one block size, summarised as mean, 99th
+    // percentile and worst, in microseconds and as a share of the budget
+    class CallbackTimes
+    {
+    public:
+        CallbackTimes(int blockSize, int numCallbacks);
+
+        void add(juce::int64 startTicks, juce::int64 endTicks);
+        juce::String summarise() const;
+
+    private:
+        std::vector<double> seconds;
+        double budget;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CallbackTimes)
+    };
+
+    static void report(const juce::String& line);
+
+private:
+    static bool writeImpulse(const juce::File& file, double seconds);
+};
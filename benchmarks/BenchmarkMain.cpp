@@ -0,0 +1,26 @@
+#include "Benchmark.h"
+
+// Runs every benchmark, or only the one named on the command line
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const juce::String only = argc > 1 ? juce::String(argv[1]) : juce::String();
+
+    if (only.isEmpty() || only == "limiter")
+        Benchmark::runLimiter();
+
+    if (only.isEmpty() || only == "reverb")
+        Benchmark::runReverb();
+
+    if (only.isEmpty() || only == "latency")
+        Benchmark::runEditLatency();
+
+    if (only.isEmpty() || only == "lowpower")
+        Benchmark::runLowPower();
+
+    if (only.isEmpty() || only == "oneshots")
+        Benchmark::runOneShots();
+
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+#include "EngineTransport.h"
+#include "RenderAheadSource.h"
+#include <algorithm>
+
+// Edit-to-audible latency through the render-ahead ring, as the engine
+// measures it: a setting changes between two device callbacks and the time
+// is taken to the first callback that hands the redone audio over, plus the
+// device.  The device here is one 512-sample buffer with no driver latency of
+// its own, so a real one adds its output latency on top.  Callbacks are
+// paced in real time and the edits land a second apart.
+void Benchmark::runEditLatency()
+{
+    constexpr int kBlockSize = 512;
+    constexpr int kEdits = 20;
+    constexpr int kCallbacksPerEdit = 94;    // about a second
+    constexpr int kWarmupCallbacks = 100;
+
+    struct Mode
+    {
+        const char* name;
+        bool renderAhead;
+        bool lowPower;
+    };
+
+    for (const auto& mode : { Mode { "render-ahead", true, false },
+                              Mode { "render-ahead, low power", true, true },
+                              Mode { "direct", false, false } })
+    {
+        NoiseSource noise(0.5f);
+        EngineTransport transport(&noise);
+        RenderAheadSource renderAhead(&transport, transport);
+        renderAhead.setEnabled(mode.renderAhead);
+        renderAhead.setLowPower(mode.lowPower);
+        renderAhead.setDeviceLatency(kBlockSize / kSampleRate);
+        renderAhead.prepareToPlay(kBlockSize, kSampleRate);
+
+        juce::AudioBuffer<float> buffer(2, kBlockSize);
+        const juce::AudioSourceChannelInfo info(&buffer, 0, kBlockSize);
+
+        const double blockMs = 1000.0 * kBlockSize / kSampleRate;
+        auto due = juce::Time::getMillisecondCounterHiRes();
+
+        auto play = [&](int numCallbacks)
+        {
+            for (int i = 0; i < numCallbacks; ++i)
+            {
+                due += blockMs;
+                juce::Time::waitForMillisecondCounter(static_cast<juce::uint32>(due));
+                renderAhead.getNextAudioBlock(info);
+            }
+        };
+
+        play(kWarmupCallbacks);
+
+        std::vector<double> latencies;
+        for (int edit = 0; edit < kEdits; ++edit)
+        {
+            const int measured = renderAhead.getEditCount();
+            transport.parameterChanged();
+            play(kCallbacksPerEdit);
+
+            if (renderAhead.getEditCount() > measured)
+                latencies.push_back(renderAhead.getEditLatencyMs());
+        }
+
+        renderAhead.releaseResources();
+
+        if (latencies.empty())
+        {
+            report(juce::String("edit latency, ") + mode.name + ": no edit was heard");
+            continue;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        double sum = 0.0;
+        for (auto latency : latencies)
+            sum += latency;
+
+        report(juce::String("edit latency, ") + mode.name + ": min " + juce::String(latencies.front(), 1)
+               + " ms, mean " + juce::String(sum / static_cast<double>(latencies.size()), 1)
+               + " ms, max " + juce::String(latencies.back(), 1)
+               + " ms over " + juce::String(static_cast<int>(latencies.size())) + " edits");
+    }
+}
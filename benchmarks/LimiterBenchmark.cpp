@@ -0,0 +1,39 @@
+#include "Benchmark.h"
+#include "EngineTransport.h"
+#include "MasterLimiter.h"
+
+// The limiter's cost is per sample, so each block size should take the same
+// share of its budget; noise 12 dB over the ceiling keeps it limiting
+// throughout.  Callbacks run back to back.
+void Benchmark::runLimiter()
+{
+    constexpr int kWarmupCallbacks = 200;
+    constexpr int kCallbacks = 5000;
+
+    for (const int blockSize : { 64, 256, 512, 1024 })
+    {
+        NoiseSource noise(4.0f);
+        EngineTransport transport(nullptr);
+        MasterLimiter limiter(&noise, transport);
+        limiter.prepareToPlay(blockSize, kSampleRate);
+
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        const juce::AudioSourceChannelInfo info(&buffer, 0, blockSize);
+        CallbackTimes times(blockSize, kCallbacks);
+
+        for (int i = 0; i < kWarmupCallbacks + kCallbacks; ++i)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            limiter.getNextAudioBlock(info);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            if (i >= kWarmupCallbacks)
+                times.add(start, end);
+        }
+
+        report("limiter, " + juce::String(blockSize) + " samples: " + times.summarise()
+               + ", reduction " + juce::String(limiter.getGainReductionDecibels(), 1) + " dB");
+
+        limiter.releaseResources();
+    }
+}
@@ -0,0 +1,78 @@
+#include "Benchmark.h"
+#include "EngineTransport.h"
+#include "MasterLimiter.h"
+#include "RenderAheadSource.h"
+#include "AnalysisEngine.h"
+#include "AnalysisTap.h"
+#include <ctime>
+
+// Wakeups and CPU time of the audio path with low power off and on, played
+// in real time: the device callbacks, the render-ahead thread and the
+// analysis thread are counted, and CPU is the process time spent over the
+// wall time.  Low power is what MainComponent switches to, the largest
+// buffer a typical device offers plus burst refills and idle analysis;
+// the GUI's own timers are not part of this.
+void Benchmark::runLowPower()
+{
+    constexpr double kSeconds = 10.0;
+
+    struct Mode
+    {
+        const char* name;
+        int blockSize;
+        bool lowPower;
+    };
+
+    for (const auto& mode : { Mode { "normal", 512, false },
+                              Mode { "low power", 4096, true } })
+    {
+        NoiseSource noise(0.5f);
+        EngineTransport transport(&noise);
+        MasterLimiter limiter(&transport, transport);
+        RenderAheadSource renderAhead(&limiter, transport);
+        AnalysisTap tap;
+        AnalysisEngine analysis;
+
+        limiter.setOutputTap(&tap);
+        analysis.addTap(&tap);
+        analysis.setIdle(mode.lowPower);
+        renderAhead.setLowPower(mode.lowPower);
+        renderAhead.prepareToPlay(mode.blockSize, kSampleRate);
+
+        juce::AudioBuffer<float> buffer(2, mode.blockSize);
+        const juce::AudioSourceChannelInfo info(&buffer, 0, mode.blockSize);
+
+        const double blockMs = 1000.0 * mode.blockSize / kSampleRate;
+        const int numCallbacks = static_cast<int>(kSeconds * 1000.0 / blockMs);
+
+        const int renderWakeups = renderAhead.getWakeupCount();
+        const int passes = analysis.getPassCount();
+        const auto cpuStart = std::clock();
+        const auto wallStart = juce::Time::getMillisecondCounterHiRes();
+        auto due = wallStart;
+
+        for (int i = 0; i < numCallbacks; ++i)
+        {
+            due += blockMs;
+            juce::Time::waitForMillisecondCounter(static_cast<juce::uint32>(due));
+            renderAhead.getNextAudioBlock(info);
+        }
+
+        const double wallSeconds = (juce::Time::getMillisecondCounterHiRes() - wallStart) / 1000.0;
+        const double cpuSeconds = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        const int renderCount = renderAhead.getWakeupCount() - renderWakeups;
+        const int passCount = analysis.getPassCount() - passes;
+
+        renderAhead.releaseResources();
+        analysis.removeTap(&tap);
+        limiter.setOutputTap(nullptr);
+
+        auto perSecond = [wallSeconds](int count) { return juce::String(count / wallSeconds, 1); };
+
+        report(juce::String("low power, ") + mode.name + ": " + juce::String(mode.blockSize) + " samples, "
+               + perSecond(numCallbacks + renderCount + passCount) + " wakeups/s ("
+               + perSecond(numCallbacks) + " callbacks, " + perSecond(renderCount) + " render, "
+               + perSecond(passCount) + " analysis), CPU " + juce::String(100.0 * cpuSeconds / wallSeconds, 1)
+               + "% of one core, " + juce::String(renderAhead.getUnderrunCount()) + " underruns");
+    }
+}
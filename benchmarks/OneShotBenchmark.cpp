@@ -0,0 +1,67 @@
+#include "Benchmark.h"
+#include "OneShotEventSource.h"
+
+// Callback cost of an event layer at rates up to well past what a scene
+// would use.  The samples are decaying noise bursts of one to three
+// seconds, so the faster rates keep most of the voice pool busy and the
+// fastest one steals voices.  Nothing here runs on another thread, so the
+// callbacks aren't paced; every case renders the same two minutes of audio.
+void Benchmark::runOneShots()
+{
+    constexpr int kBlockSize = 512;
+    constexpr double kSeconds = 120.0;
+    constexpr int kCallbacks = static_cast<int>(kSeconds * kSampleRate / kBlockSize);
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    juce::OwnedArray<juce::TemporaryFile> sampleFiles;
+    juce::Array<juce::File> files;
+
+    for (const double seconds : { 1.0, 1.5, 2.0, 3.0 })
+    {
+        auto* sampleFile = sampleFiles.add(new juce::TemporaryFile(".wav"));
+        if (!writeImpulse(sampleFile->getFile(), seconds))
+        {
+            report("one-shots: couldn't write the samples");
+            return;
+        }
+
+        files.add(sampleFile->getFile());
+    }
+
+    for (const float eventsPerMinute : { 0.0f, 60.0f, 300.0f, 600.0f, 1200.0f })
+    {
+        OneShotEventSource events(formatManager, files);
+        if (!events.isValid())
+        {
+            report("one-shots: couldn't load the samples");
+            return;
+        }
+
+        OneShotEventSource::Settings settings;
+        settings.eventsPerMinute = eventsPerMinute;
+        events.setSettings(settings);
+        events.prepareToPlay(kBlockSize, kSampleRate);
+
+        juce::AudioBuffer<float> buffer(2, kBlockSize);
+        const juce::AudioSourceChannelInfo info(&buffer, 0, kBlockSize);
+        CallbackTimes times(kBlockSize, kCallbacks);
+        int mostVoices = 0;
+
+        for (int i = 0; i < kCallbacks; ++i)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            events.getNextAudioBlock(info);
+            const auto end = juce::Time::getHighResolutionTicks();
+
+            times.add(start, end);
+            mostVoices = juce::jmax(mostVoices, events.getActiveVoiceCount());
+        }
+
+        report("one-shots, " + juce::String(eventsPerMinute, 0) + " per minute: " + times.summarise()
+               + ", " + juce::String(events.getTriggerCount()) + " triggers"
+               + ", up to " + juce::String(mostVoices) + " of "
+               + juce::String(OneShotEventSource::kMaxVoices) + " voices");
+    }
+}
@@ -0,0 +1,48 @@
+#include "AnalysisEngine.h"
+
+AnalysisEngine::AnalysisEngine()
+    : juce::Thread("analysis"),
+      fftData(static_cast<size_t>(2 * AnalysisTap::kFftSize), 0.0f)
+{
+    startThread(juce::Thread::Priority::low);
+}
+
+AnalysisEngine::~AnalysisEngine()
+{
+    stopThread(1000);
+}
+
+void AnalysisEngine::addTap(AnalysisTap* tap)
+{
+    const juce::ScopedLock sl(lock);
+    taps.addIfNotAlreadyThere(tap);
+}
+
+void AnalysisEngine::removeTap(AnalysisTap* tap)
+{
+    // Waits for a pass in progress, so the tap is safe to destroy afterwards
+    const juce::ScopedLock sl(lock);
+    taps.removeFirstMatchingValue(tap);
+}
+
+void AnalysisEngine::run()
+{
+    auto lastTicks = juce::Time::getHighResolutionTicks();
+
+    while (!threadShouldExit())
+    {
+        const auto now = juce::Time::getHighResolutionTicks();
+        const double elapsed = juce::Time::highResolutionTicksToSeconds(now - lastTicks);
+        lastTicks = now;
+
+        {
+            const juce::ScopedLock sl(lock);
+            for (auto* tap : taps)
+                tap->analyse(fft, window, fftData, elapsed);
+        }
+
+        passes.fetch_add(1);
+
+        wait(idle.load() ? kIdleIntervalMs : kIntervalMs);
+    }
+}
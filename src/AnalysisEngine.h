@@ -0,0 +1,44 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include <vector>
+#include "AnalysisTap.h"
+
+// The one background thread that turns every AnalysisTap's audio into meter
+// readings and spectra, using a single FFT plan and window for all of them.
+class AnalysisEngine : private juce::Thread
+{
+public:
+    AnalysisEngine();
+    ~AnalysisEngine() override;
+
+    // Message thread.  A tap must be removed before it is destroyed.
+    void addTap(AnalysisTap* tap);
+    void removeTap(AnalysisTap* tap);
+
+    // With nothing on screen the taps are only drained now and then; their
+    // rings are sized for that gap plus a render-ahead burst
+    void setIdle(bool shouldIdle) { idle.store(shouldIdle); }
+
+    // Times the thread has woken to drain the taps
+    int getPassCount() const { return passes.load(); }
+
+private:
+    void run() override;
+
+    juce::CriticalSection lock;
+    juce::Array<AnalysisTap*> taps;
+
+    juce::dsp::FFT fft { AnalysisTap::kFftOrder };
+    juce::dsp::WindowingFunction<float> window { static_cast<size_t>(AnalysisTap::kFftSize),
+                                                 juce::dsp::WindowingFunction<float>::hann, false };
+    std::vector<float> fftData;
+    std::atomic<bool> idle { false };
+    std::atomic<int> passes { 0 };
+
+    static constexpr int kIntervalMs = 16;
+    static constexpr int kIdleIntervalMs = static_cast<int>(AnalysisTap::kIdleDrainSeconds * 1000.0);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisEngine)
+};
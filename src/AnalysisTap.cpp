@@ -0,0 +1,125 @@
+#include "AnalysisTap.h"
+#include <cmath>
+#include <cstring>
+
+AnalysisTap::AnalysisTap()
+{
+    Snapshot silent;
+    silent.peakDb.fill(kFloorDb);
+    silent.rmsDb.fill(kFloorDb);
+    silent.spectrumDb.fill(kFloorDb);
+    results.write(silent);
+
+    setSampleRate(sampleRate.load());
+}
+
+void AnalysisTap::setSampleRate(double newSampleRate)
+{
+    sampleRate.store(newSampleRate);
+
+    // The fifo holds one sample less than its size
+    const auto needed = static_cast<int>(std::ceil(kMaxBacklogSeconds * newSampleRate)) + 1;
+    if (needed <= fifo.getTotalSize())
+        return;
+
+    const juce::SpinLock::ScopedLockType sl(resizeLock);
+
+    for (auto& channel : ring)
+        channel.assign(static_cast<size_t>(needed), 0.0f);
+
+    fifo.setTotalSize(needed);
+}
+
+void AnalysisTap::push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels)
+{
+    numChannels = juce::jmin(numChannels, kMaxChannels);
+    if (numChannels <= 0 || numSamples <= 0)
+        return;
+
+    channelsInRing.store(numChannels, std::memory_order_relaxed);
+
+    // Never wait on the reader: whatever doesn't fit is dropped
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(juce::jmin(numSamples, fifo.getFreeSpace()), start1, size1, start2, size2);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* src = buffer.getReadPointer(ch, startSample);
+        auto& dest = ring[static_cast<size_t>(ch)];
+
+        std::memcpy(dest.data() + start1, src, static_cast<size_t>(size1) * sizeof(float));
+        std::memcpy(dest.data() + start2, src + size1, static_cast<size_t>(size2) * sizeof(float));
+    }
+
+    fifo.finishedWrite(size1 + size2);
+}
+
+void AnalysisTap::analyse(juce::dsp::FFT& fft, juce::dsp::WindowingFunction<float>& window,
+                          std::vector<float>& fftData, double secondsSinceLast)
+{
+    // A pass that meets a resize is skipped; the next one picks up
+    const juce::SpinLock::ScopedTryLockType sl(resizeLock);
+    if (!sl.isLocked())
+        return;
+
+    const int numChannels = juce::jlimit(1, kMaxChannels, channelsInRing.load(std::memory_order_relaxed));
+    const float rmsCoeff = static_cast<float>(std::exp(-1.0 / (kRmsSeconds * sampleRate.load())));
+    std::array<float, kMaxChannels> blockPeak {};
+
+    auto consume = [&](int start, int size)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            float mono = 0.0f;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const float x = ring[static_cast<size_t>(ch)][static_cast<size_t>(start + i)];
+                auto& ms = meanSquare[static_cast<size_t>(ch)];
+
+                blockPeak[static_cast<size_t>(ch)] = juce::jmax(blockPeak[static_cast<size_t>(ch)], std::abs(x));
+                ms = x * x + (ms - x * x) * rmsCoeff;
+                mono += x;
+            }
+
+            history[static_cast<size_t>(historyPos)] = mono / static_cast<float>(numChannels);
+            historyPos = (historyPos + 1) & (kFftSize - 1);
+        }
+    };
+
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+    consume(start1, size1);
+    consume(start2, size2);
+    fifo.finishedRead(size1 + size2);
+
+    Snapshot snapshot;
+    snapshot.numChannels = numChannels;
+
+    // Peaks fall back at a fixed rate unless something louder arrives
+    const float fall = juce::Decibels::decibelsToGain(-kPeakFallDbPerSecond * static_cast<float>(secondsSinceLast));
+
+    for (int ch = 0; ch < kMaxChannels; ++ch)
+    {
+        const auto c = static_cast<size_t>(ch);
+        peak[c] = juce::jmax(blockPeak[c], peak[c] * fall);
+        snapshot.peakDb[c] = juce::Decibels::gainToDecibels(peak[c], kFloorDb);
+        snapshot.rmsDb[c] = juce::Decibels::gainToDecibels(std::sqrt(meanSquare[c]), kFloorDb);
+    }
+
+    // Spectrum of the most recent kFftSize samples, oldest first
+    const auto tail = static_cast<size_t>(kFftSize - historyPos);
+    std::copy(history.begin() + historyPos, history.end(), fftData.begin());
+    std::copy(history.begin(), history.begin() + historyPos, fftData.begin() + static_cast<std::ptrdiff_t>(tail));
+    std::fill(fftData.begin() + kFftSize, fftData.end(), 0.0f);
+
+    window.multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(kFftSize));
+    fft.performFrequencyOnlyForwardTransform(fftData.data());
+
+    // Scaled so a full-scale sine reads 0 dB through the Hann window
+    constexpr float scale = 4.0f / static_cast<float>(kFftSize);
+    for (int bin = 0; bin < kNumBins; ++bin)
+        snapshot.spectrumDb[static_cast<size_t>(bin)] = juce::Decibels::gainToDecibels(fftData[static_cast<size_t>(bin)] * scale, kFloorDb);
+
+    results.write(snapshot);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include "SeqLock.h"
+
+// Wait-free handoff of audio from the audio thread to the analysis thread,
+// plus the meter and spectrum results that come back for the GUI.
+//
+// The audio thread's only cost is copying the block into a single-producer /
+// single-consumer ring; a block that doesn't fit is dropped rather than
+// waited for.  AnalysisEngine drains the ring and publishes a Snapshot that
+// the GUI reads at display rate.
+class AnalysisTap
+{
+public:
+    static constexpr int kMaxChannels = 2;
+    static constexpr int kFftOrder = 11;
+    static constexpr int kFftSize = 1 << kFftOrder;
+    static constexpr int kNumBins = kFftSize / 2;
+    static constexpr float kFloorDb = -100.0f;
+
+    struct Snapshot
+    {
+        std::array<float, kMaxChannels> peakDb {};
+        std::array<float, kMaxChannels> rmsDb {};
+        std::array<float, kNumBins> spectrumDb {};
+        int numChannels = 0;
+    };
+
+    AnalysisTap();
+
+    // Audio thread.  setSampleRate() is called as the owner is prepared,
+    // before anything is pushed, and grows the ring to hold kMaxBacklogSeconds.
+    void setSampleRate(double newSampleRate);
+    void push(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, int numChannels);
+
+    // Analysis thread: drains the ring and publishes a new snapshot.  The FFT,
+    // window and scratch are shared between taps.
+    void analyse(juce::dsp::FFT& fft, juce::dsp::WindowingFunction<float>& window,
+                 std::vector<float>& fftData, double secondsSinceLast);
+
+    // GUI
+    Snapshot getSnapshot() const { return results.read(); }
+    double getSampleRate() const { return sampleRate.load(); }
+
+    // The longest the analysis thread leaves a tap undrained, when nothing
+    // is on screen, and the most audio that can arrive at once: render-ahead
+    // refills its whole ring in one burst
+    static constexpr double kIdleDrainSeconds = 0.25;
+    static constexpr double kMaxBurstSeconds = 0.4;
+    static constexpr double kMaxBacklogSeconds = kIdleDrainSeconds + kMaxBurstSeconds;
+
+private:
+    static constexpr double kRmsSeconds = 0.3;
+    static constexpr float kPeakFallDbPerSecond = 20.0f;
+
+    juce::AbstractFifo fifo { 1 };
+    std::array<std::vector<float>, kMaxChannels> ring;
+    juce::SpinLock resizeLock;    // keeps the analysis thread out while the ring grows
+    std::atomic<int> channelsInRing { 0 };
+    std::atomic<double> sampleRate { 44100.0 };
+
+    // Analysis thread only
+    std::array<float, kFftSize> history {};
+    int historyPos = 0;
+    std::array<float, kMaxChannels> peak {};
+    std::array<float, kMaxChannels> meanSquare {};
+
+    SeqLock<Snapshot> results;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalysisTap)
+};
@@ -0,0 +1,606 @@
+#include "ConvolutionReverb.h"
+#include <algorithm>
+#include <cmath>
+
+ConvolutionReverb::ConvolutionReverb(juce::AudioSource* src, juce::AudioFormatManager& fm)
+    : juce::Thread("reverb-tail"),
+      source(src),
+      formatManager(fm),
+      headFft(kHeadOrder),
+      headFftData(static_cast<size_t>(4 * kHeadBlock), 0.0f),
+      headSum(static_cast<size_t>(2 * kHeadBlock + 2), 0.0f)
+{
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    loader.removeAllJobs(true, 5000);
+    stopThread(1000);
+
+    delete pendingKernel.exchange(nullptr);
+    delete retiredKernel.exchange(nullptr);
+    delete activeKernel;
+}
+
+void ConvolutionReverb::loadImpulse(const juce::File& file, std::function<void(bool)> onLoaded)
+{
+    {
+        const juce::ScopedLock sl(fileLock);
+        impulseFile = file;
+    }
+
+    launchBuild(file, std::move(onLoaded));
+}
+
+void ConvolutionReverb::clearImpulse()
+{
+    loadImpulse(juce::File{});
+}
+
+juce::File ConvolutionReverb::getImpulseFile() const
+{
+    const juce::ScopedLock sl(fileLock);
+    return impulseFile;
+}
+
+void ConvolutionReverb::launchBuild(const juce::File& file, std::function<void(bool)> onLoaded)
+{
+    const double rate = configRate.load();
+    const int block = configTailBlock.load();
+
+    // Until the device is known prepareToPlay does the build
+    if (rate <= 0.0)
+        return;
+
+    juce::WeakReference<ConvolutionReverb> weakThis(this);
+
+    loader.addJob([this, weakThis, file, rate, block, onLoaded]
+    {
+        // No file makes an empty kernel, which swaps out whatever is playing
+        auto kernel = file == juce::File{} ? std::make_unique<Kernel>()
+                                           : buildKernel(formatManager, file, rate, block);
+        const bool loaded = kernel != nullptr;
+
+        if (loaded)
+        {
+            kernel->sampleRate = rate;
+            kernel->tailBlock = block;
+            delete pendingKernel.exchange(kernel.release(), std::memory_order_acq_rel);
+        }
+
+        if (onLoaded != nullptr)
+        {
+            juce::MessageManager::callAsync([weakThis, loaded, onLoaded]
+            {
+                if (weakThis.get() != nullptr)
+                    onLoaded(loaded);
+            });
+        }
+    });
+}
+
+int ConvolutionReverb::fftOrder(int fftSize)
+{
+    int order = 0;
+    while ((1 << order) < fftSize)
+        ++order;
+
+    return order;
+}
+
+std::unique_ptr<ConvolutionReverb::Kernel> ConvolutionReverb::buildKernel(juce::AudioFormatManager& formatManager,
+                                                                          const juce::File& file,
+                                                                          double sampleRate, int tailBlock)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+        return nullptr;
+
+    const auto fileLength = static_cast<int>(juce::jmin(reader->lengthInSamples,
+                                                        static_cast<juce::int64>(kMaxImpulseSeconds * reader->sampleRate)));
+    const int numChannels = juce::jlimit(1, kMaxChannels, static_cast<int>(reader->numChannels));
+
+    juce::AudioBuffer<float> raw(numChannels, fileLength);
+    reader->read(&raw, 0, fileLength, 0, true, numChannels > 1);
+
+    // Resample to the device rate; the interpolator stops short of the end
+    // rather than read past it
+    const double ratio = reader->sampleRate / sampleRate;
+    const int length = juce::jmax(1, static_cast<int>((fileLength - 1) / ratio));
+    juce::AudioBuffer<float> impulse(numChannels, length);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        if (ratio == 1.0)
+        {
+            impulse.copyFrom(ch, 0, raw, ch, 0, length);
+            continue;
+        }
+
+        juce::LagrangeInterpolator interpolator;
+        interpolator.process(ratio, raw.getReadPointer(ch), impulse.getWritePointer(ch), length);
+    }
+
+    // Unit energy per channel, so the wet level means the same for any room
+    double energy = 0.0;
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* samples = impulse.getReadPointer(ch);
+        for (int i = 0; i < length; ++i)
+            energy += static_cast<double>(samples[i]) * samples[i];
+    }
+
+    energy /= numChannels;
+    if (energy <= 0.0)
+        return nullptr;
+
+    impulse.applyGain(static_cast<float>(1.0 / std::sqrt(energy)));
+
+    const int headLength = 2 * tailBlock;
+    const int headSamples = juce::jmin(length, headLength);
+
+    auto kernel = std::make_unique<Kernel>();
+    kernel->numChannels = numChannels;
+    kernel->lengthSeconds = length / sampleRate;
+    kernel->headPartitions = (headSamples + kHeadBlock - 1) / kHeadBlock;
+    kernel->tailPartitions = length > headLength ? (length - headLength + tailBlock - 1) / tailBlock : 0;
+
+    const juce::dsp::FFT headTransform(kHeadOrder);
+    const juce::dsp::FFT tailTransform(fftOrder(2 * tailBlock));
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* samples = impulse.getReadPointer(ch);
+        transformPartitions(headTransform, samples, headSamples, kHeadBlock,
+                            kernel->headPartitions, kernel->head[ch]);
+
+        if (kernel->tailPartitions > 0)
+            transformPartitions(tailTransform, samples + headLength, length - headLength, tailBlock,
+                                kernel->tailPartitions, kernel->tail[ch]);
+    }
+
+    return kernel;
+}
+
+void ConvolutionReverb::transformPartitions(const juce::dsp::FFT& fft, const float* impulse, int length,
+                                            int blockSize, int numPartitions, std::vector<float>& spectra)
+{
+    const int fftSize = 2 * blockSize;
+    const int stride = fftSize + 2;
+
+    spectra.assign(static_cast<size_t>(numPartitions * stride), 0.0f);
+    std::vector<float> work(static_cast<size_t>(2 * fftSize));
+
+    for (int p = 0; p < numPartitions; ++p)
+    {
+        const int offset = p * blockSize;
+        const int count = juce::jmin(blockSize, length - offset);
+
+        std::fill(work.begin(), work.end(), 0.0f);
+        std::copy(impulse + offset, impulse + offset + count, work.begin());
+        fft.performRealOnlyForwardTransform(work.data(), true);
+        std::copy(work.begin(), work.begin() + stride, spectra.begin() + p * stride);
+    }
+}
+
+void ConvolutionReverb::multiplyAccumulate(const float* a, const float* b, float* sum, int numBins)
+{
+    for (int k = 0; k < 2 * numBins; k += 2)
+    {
+        sum[k]     += a[k] * b[k] - a[k + 1] * b[k + 1];
+        sum[k + 1] += a[k] * b[k + 1] + a[k + 1] * b[k];
+    }
+}
+
+void ConvolutionReverb::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    stopThread(1000);
+    source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    currentSampleRate = sampleRate;
+    tailBlock = juce::jmax(kMinTailBlock, juce::nextPowerOfTwo(2 * samplesPerBlockExpected));
+    headLength = 2 * tailBlock;
+    maxHeadPartitions = headLength / kHeadBlock;
+
+    headInput.setSize(kMaxChannels, 2 * kHeadBlock);
+    headOutput.setSize(kMaxChannels, kHeadBlock);
+    headSpectra.setSize(kMaxChannels, maxHeadPartitions * (2 * kHeadBlock + 2));
+    wetScratch.setSize(kMaxChannels, juce::jmax(1, samplesPerBlockExpected));
+    headInput.clear();
+    headOutput.clear();
+    headSpectra.clear();
+    headPos = 0;
+    headSlot = 0;
+    pendingZeros = 0;
+    outputDebt = 0;
+    stalled = false;
+
+    tailFft = std::make_unique<juce::dsp::FFT>(fftOrder(2 * tailBlock));
+    tailInput.setSize(kMaxChannels, 2 * tailBlock);
+    tailInput.clear();
+    tailFftData.assign(static_cast<size_t>(4 * tailBlock), 0.0f);
+    tailSum.assign(static_cast<size_t>(2 * tailBlock + 2), 0.0f);
+
+    // Room for a few late tail passes.  The output side starts with the
+    // head's length plus its latency in silence, which lines each tail
+    // result up behind the head output for the same input.
+    const int fifoSize = 4 * tailBlock + 2 * samplesPerBlockExpected;
+    const int prefill = headLength + kHeadBlock;
+
+    tailInputFifo.setTotalSize(fifoSize);
+    tailInputBuffer.setSize(kMaxChannels, fifoSize);
+    tailInputBuffer.clear();
+
+    tailOutputFifo.setTotalSize(fifoSize + prefill);
+    tailOutputBuffer.setSize(kMaxChannels, fifoSize + prefill);
+    tailOutputBuffer.clear();
+    tailOutputFifo.finishedWrite(prefill);
+
+    wetGain.reset(sampleRate, kDuckSeconds);
+    wetGain.setCurrentAndTargetValue(0.0f);
+
+    // Kernels are transformed for one rate and tail block; a change rebuilds
+    const bool rebuild = configRate.load() != sampleRate || configTailBlock.load() != tailBlock;
+    configRate.store(sampleRate);
+    configTailBlock.store(tailBlock);
+
+    if (rebuild)
+    {
+        delete pendingKernel.exchange(nullptr);
+        delete retiredKernel.exchange(nullptr);
+        delete activeKernel;
+        activeKernel = nullptr;
+        liveKernel.store(nullptr);
+        headPartitionCount.store(0);
+        tailPartitionCount.store(0);
+        impulseSeconds.store(0.0);
+
+        const auto file = getImpulseFile();
+        if (file != juce::File{})
+            launchBuild(file, nullptr);
+    }
+
+    // Make the tail thread start from a clean delay line
+    tailKernel = nullptr;
+    tailGeneration = generation.load() + 1;
+
+    startThread(juce::Thread::Priority::high);
+}
+
+void ConvolutionReverb::releaseResources()
+{
+    stopThread(1000);
+    source->releaseResources();
+}
+
+bool ConvolutionReverb::adoptPendingKernel()
+{
+    // Only this thread fills retired, so once it's empty it stays empty
+    if (retiredKernel.load(std::memory_order_acquire) != nullptr)
+        return false;
+
+    auto* next = pendingKernel.exchange(nullptr, std::memory_order_acq_rel);
+    if (next == nullptr)
+        return false;
+
+    // Built against an older configuration; prepareToPlay has queued another
+    if (next->sampleRate != currentSampleRate || next->tailBlock != tailBlock)
+    {
+        retiredKernel.store(next, std::memory_order_release);
+        notify();
+        return false;
+    }
+
+    // The new kernel is live before the old one can be deleted
+    generation.fetch_add(1, std::memory_order_release);
+    liveKernel.store(next, std::memory_order_release);
+    retiredKernel.store(activeKernel, std::memory_order_release);
+    activeKernel = next;
+    notify();
+
+    headPartitionCount.store(next->headPartitions);
+    tailPartitionCount.store(next->tailPartitions);
+    impulseSeconds.store(next->lengthSeconds);
+    return true;
+}
+
+void ConvolutionReverb::pushTailInput(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int numChannels = juce::jmin(buffer.getNumChannels(), kMaxChannels);
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+
+    // Input there was no room for goes in as silence once there is, so the
+    // tail stays in step with the head
+    const int zeros = juce::jmin(pendingZeros, tailInputFifo.getFreeSpace());
+    if (zeros > 0)
+    {
+        tailInputFifo.prepareToWrite(zeros, start1, size1, start2, size2);
+        for (int ch = 0; ch < kMaxChannels; ++ch)
+        {
+            tailInputBuffer.clear(ch, start1, size1);
+            tailInputBuffer.clear(ch, start2, size2);
+        }
+
+        tailInputFifo.finishedWrite(size1 + size2);
+        pendingZeros -= size1 + size2;
+    }
+
+    const int count = pendingZeros > 0 ? 0 : juce::jmin(numSamples, tailInputFifo.getFreeSpace());
+    tailInputFifo.prepareToWrite(count, start1, size1, start2, size2);
+
+    for (int ch = 0; ch < kMaxChannels; ++ch)
+    {
+        const int sourceChannel = juce::jmin(ch, numChannels - 1);
+        if (size1 > 0)
+            tailInputBuffer.copyFrom(ch, start1, buffer, sourceChannel, startSample, size1);
+        if (size2 > 0)
+            tailInputBuffer.copyFrom(ch, start2, buffer, sourceChannel, startSample + size1, size2);
+    }
+
+    tailInputFifo.finishedWrite(size1 + size2);
+    pendingZeros += numSamples - (size1 + size2);
+}
+
+void ConvolutionReverb::addTailOutput(int numSamples)
+{
+    int ready = tailOutputFifo.getNumReady();
+
+    // Results that missed their slot are dropped to stay in step
+    if (outputDebt > 0)
+    {
+        const int skip = juce::jmin(outputDebt, ready);
+        tailOutputFifo.finishedRead(skip);
+        outputDebt -= skip;
+        ready -= skip;
+    }
+
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    tailOutputFifo.prepareToRead(juce::jmin(numSamples, ready), start1, size1, start2, size2);
+
+    for (int ch = 0; ch < kMaxChannels; ++ch)
+    {
+        if (size1 > 0)
+            wetScratch.addFrom(ch, 0, tailOutputBuffer, ch, start1, size1);
+        if (size2 > 0)
+            wetScratch.addFrom(ch, size1, tailOutputBuffer, ch, start2, size2);
+    }
+
+    tailOutputFifo.finishedRead(size1 + size2);
+
+    const int missing = numSamples - (size1 + size2);
+    if (missing > 0)
+    {
+        if (!stalled)
+            underruns.fetch_add(1);
+
+        outputDebt += missing;
+    }
+
+    stalled = missing > 0;
+}
+
+void ConvolutionReverb::runHead(int numChannels)
+{
+    const int fftSize = 2 * kHeadBlock;
+    const int stride = fftSize + 2;
+    const auto* kernel = activeKernel;
+
+    // Newest spectrum in front; partition p meets the input from p blocks ago
+    headSlot = (headSlot + maxHeadPartitions - 1) % maxHeadPartitions;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* window = headInput.getWritePointer(ch);
+        auto* line = headSpectra.getWritePointer(ch);
+        const auto& spectra = kernel->head[juce::jmin(ch, kernel->numChannels - 1)];
+
+        std::fill(headFftData.begin(), headFftData.end(), 0.0f);
+        std::copy(window, window + fftSize, headFftData.begin());
+        headFft.performRealOnlyForwardTransform(headFftData.data(), true);
+        std::copy(headFftData.begin(), headFftData.begin() + stride, line + headSlot * stride);
+
+        std::fill(headSum.begin(), headSum.end(), 0.0f);
+        for (int p = 0; p < kernel->headPartitions; ++p)
+        {
+            const int slot = (headSlot + p) % maxHeadPartitions;
+            multiplyAccumulate(line + slot * stride, spectra.data() + p * stride, headSum.data(), kHeadBlock + 1);
+        }
+
+        std::fill(headFftData.begin(), headFftData.end(), 0.0f);
+        std::copy(headSum.begin(), headSum.end(), headFftData.begin());
+        headFft.performRealOnlyInverseTransform(headFftData.data());
+
+        // Overlap-save: the second half is the part free of wrap-around
+        headOutput.copyFrom(ch, 0, headFftData.data() + kHeadBlock, kHeadBlock);
+        std::copy(window + kHeadBlock, window + fftSize, window);
+    }
+}
+
+void ConvolutionReverb::processChunk(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int numChannels = juce::jmin(buffer.getNumChannels(), kMaxChannels);
+
+    pushTailInput(buffer, startSample, numSamples);
+
+    // The tail thread sleeps until there's a whole block for it
+    if (tailInputFifo.getNumReady() >= tailBlock)
+        notify();
+
+    int done = 0;
+    while (done < numSamples)
+    {
+        const int count = juce::jmin(kHeadBlock - headPos, numSamples - done);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            headInput.copyFrom(ch, kHeadBlock + headPos, buffer, ch, startSample + done, count);
+            wetScratch.copyFrom(ch, done, headOutput, ch, headPos, count);
+        }
+
+        headPos += count;
+        done += count;
+
+        if (headPos == kHeadBlock)
+        {
+            runHead(numChannels);
+            headPos = 0;
+        }
+    }
+
+    addTailOutput(numSamples);
+
+    float* out[kMaxChannels] {};
+    const float* wet[kMaxChannels] {};
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        out[ch] = buffer.getWritePointer(ch, startSample);
+        wet[ch] = wetScratch.getReadPointer(ch);
+    }
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        const float gain = wetGain.getNextValue();
+        for (int ch = 0; ch < numChannels; ++ch)
+            out[ch][i] += wet[ch][i] * gain;
+    }
+}
+
+void ConvolutionReverb::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    source->getNextAudioBlock(bufferToFill);
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    // Kernels only change with the wet path ducked, so a swap can't click
+    const float target = suspended.load() ? 0.0f : wetLevel.load();
+    wetGain.setTargetValue(pendingKernel.load() != nullptr ? 0.0f : target);
+    if (!wetGain.isSmoothing() && wetGain.getTargetValue() == 0.0f && adoptPendingKernel())
+        wetGain.setTargetValue(target);
+
+    // Fully dry stops feeding the tail as well; both sides pause together,
+    // so it picks up in step
+    const bool dry = activeKernel == nullptr || activeKernel->headPartitions == 0
+                  || (!wetGain.isSmoothing() && wetGain.getTargetValue() == 0.0f);
+
+    if (!dry && bufferToFill.buffer->getNumChannels() > 0)
+    {
+        for (int done = 0; done < bufferToFill.numSamples;)
+        {
+            const int count = juce::jmin(bufferToFill.numSamples - done, wetScratch.getNumSamples());
+            processChunk(*bufferToFill.buffer, bufferToFill.startSample + done, count);
+            done += count;
+        }
+    }
+
+    if (bufferToFill.numSamples > 0)
+    {
+        const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const double budget = bufferToFill.numSamples / currentSampleRate;
+        const auto load = static_cast<float>(elapsed / budget);
+        cpuLoad.store(cpuLoad.load() + 0.05f * (load - cpuLoad.load()));
+    }
+}
+
+void ConvolutionReverb::run()
+{
+    while (!threadShouldExit())
+    {
+        // Woken by the audio thread when a tail block is in or a kernel retired
+        if (!processTailBlock())
+            wait(-1);
+    }
+}
+
+bool ConvolutionReverb::processTailBlock()
+{
+    // Deleting first means whatever is live below was published before the
+    // kernel it replaced went
+    delete retiredKernel.exchange(nullptr, std::memory_order_acq_rel);
+
+    const auto gen = generation.load(std::memory_order_acquire);
+    auto* kernel = liveKernel.load(std::memory_order_acquire);
+
+    const int fftSize = 2 * tailBlock;
+    const int stride = fftSize + 2;
+
+    if (kernel != tailKernel || gen != tailGeneration)
+    {
+        // Input spectra from before the change would be at the wrong stride
+        const auto size = static_cast<size_t>(kernel != nullptr ? kernel->tailPartitions * stride : 0);
+        for (auto& spectra : tailSpectra)
+            spectra.assign(size, 0.0f);
+
+        tailKernel = kernel;
+        tailGeneration = gen;
+        tailSlot = 0;
+    }
+
+    if (tailInputFifo.getNumReady() < tailBlock || tailOutputFifo.getFreeSpace() < tailBlock)
+        return false;
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    int start1 = 0, size1 = 0, start2 = 0, size2 = 0;
+    tailInputFifo.prepareToRead(tailBlock, start1, size1, start2, size2);
+
+    for (int ch = 0; ch < kMaxChannels; ++ch)
+    {
+        auto* window = tailInput.getWritePointer(ch);
+        std::copy(window + tailBlock, window + fftSize, window);
+
+        if (size1 > 0)
+            tailInput.copyFrom(ch, tailBlock, tailInputBuffer, ch, start1, size1);
+        if (size2 > 0)
+            tailInput.copyFrom(ch, tailBlock + size1, tailInputBuffer, ch, start2, size2);
+    }
+
+    tailInputFifo.finishedRead(size1 + size2);
+    tailOutputFifo.prepareToWrite(tailBlock, start1, size1, start2, size2);
+
+    const int partitions = kernel != nullptr ? kernel->tailPartitions : 0;
+    if (partitions > 0)
+        tailSlot = (tailSlot + partitions - 1) % partitions;
+
+    for (int ch = 0; ch < kMaxChannels; ++ch)
+    {
+        if (partitions == 0)
+        {
+            tailOutputBuffer.clear(ch, start1, size1);
+            tailOutputBuffer.clear(ch, start2, size2);
+            continue;
+        }
+
+        auto* line = tailSpectra[ch].data();
+        const auto& spectra = kernel->tail[juce::jmin(ch, kernel->numChannels - 1)];
+        const auto* window = tailInput.getReadPointer(ch);
+
+        std::fill(tailFftData.begin(), tailFftData.end(), 0.0f);
+        std::copy(window, window + fftSize, tailFftData.begin());
+        tailFft->performRealOnlyForwardTransform(tailFftData.data(), true);
+        std::copy(tailFftData.begin(), tailFftData.begin() + stride, line + tailSlot * stride);
+
+        std::fill(tailSum.begin(), tailSum.end(), 0.0f);
+        for (int p = 0; p < partitions; ++p)
+        {
+            const int slot = (tailSlot + p) % partitions;
+            multiplyAccumulate(line + slot * stride, spectra.data() + p * stride, tailSum.data(), tailBlock + 1);
+        }
+
+        std::fill(tailFftData.begin(), tailFftData.end(), 0.0f);
+        std::copy(tailSum.begin(), tailSum.end(), tailFftData.begin());
+        tailFft->performRealOnlyInverseTransform(tailFftData.data());
+
+        const auto* result = tailFftData.data() + tailBlock;
+        if (size1 > 0)
+            tailOutputBuffer.copyFrom(ch, start1, result, size1);
+        if (size2 > 0)
+            tailOutputBuffer.copyFrom(ch, start2, result + size1, size2);
+    }
+
+    tailOutputFifo.finishedWrite(size1 + size2);
+
+    const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+    const auto load = static_cast<float>(elapsed * currentSampleRate / tailBlock);
+    tailLoad.store(tailLoad.load() + 0.05f * (load - tailLoad.load()));
+    return true;
+}
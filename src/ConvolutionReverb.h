@@ -0,0 +1,168 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Convolution room reverb for the master bus, mixed in under the dry signal.
+//
+// The impulse response is split in two.  Its first headLength samples are
+// convolved on the audio thread in uniform partitions of kHeadBlock samples:
+// overlap-save with a frequency-domain delay line, so each block costs one
+// small FFT pair and a multiply-add per head partition whatever the IR
+// length.  The rest uses partitions of tailBlock samples on a background
+// thread fed through FIFOs.  The tail starts two of its blocks into the IR,
+// which gives the thread a whole block's time to deliver each result.
+//
+// The wet path runs kHeadBlock samples late, which is heard as pre-delay.
+// Impulse responses are read, resampled and transformed on a worker, and
+// swapped in at a block boundary while the wet level is briefly ducked.
+class ConvolutionReverb : public juce::AudioSource,
+                          private juce::Thread
+{
+public:
+    ConvolutionReverb(juce::AudioSource* source, juce::AudioFormatManager& formatManager);
+    ~ConvolutionReverb() override;
+
+    // Message thread.  The callback runs on the message thread once the IR
+    // is ready to swap in, with false if the file couldn't be read.
+    void loadImpulse(const juce::File& file, std::function<void(bool)> onLoaded = nullptr);
+    void clearImpulse();
+    juce::File getImpulseFile() const;
+
+    void setWetLevel(float level) { wetLevel.store(juce::jlimit(0.0f, 1.0f, level)); }
+    float getWetLevel() const { return wetLevel.load(); }
+
+    // Fades the room out and stops convolving until resumed, keeping the
+    // wet level and impulse as they are
+    void setSuspended(bool shouldSuspend) { suspended.store(shouldSuspend); }
+
+    // Cost of the impulse currently playing: the audio-thread share as a
+    // fraction of each block's budget, and the tail thread's as a fraction
+    // of each tail block's, both smoothed
+    float getCpuLoad() const { return cpuLoad.load(); }
+    float getTailLoad() const { return tailLoad.load(); }
+    double getImpulseSeconds() const { return impulseSeconds.load(); }
+    int getHeadPartitionCount() const { return headPartitionCount.load(); }
+    int getTailPartitionCount() const { return tailPartitionCount.load(); }
+
+    // Tail blocks that arrived too late to play; should stay at zero
+    int getUnderrunCount() const { return underruns.load(); }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static constexpr int kHeadBlock = 256;
+    static constexpr int kMinTailBlock = 2048;
+    static constexpr double kMaxImpulseSeconds = 10.0;
+
+private:
+    static constexpr int kMaxChannels = 2;
+
+    // One impulse response, transformed for a given sample rate and tail
+    // block.  Spectra hold the non-negative bins of each zero-padded
+    // partition, interleaved re/im, partitions back to back.
+    struct Kernel
+    {
+        double sampleRate = 0.0;
+        int tailBlock = 0;
+        int numChannels = 0;
+        int headPartitions = 0;
+        int tailPartitions = 0;
+        double lengthSeconds = 0.0;
+        std::vector<float> head[kMaxChannels];
+        std::vector<float> tail[kMaxChannels];
+    };
+
+    void run() override;
+    bool processTailBlock();
+
+    void launchBuild(const juce::File& file, std::function<void(bool)> onLoaded);
+    static std::unique_ptr<Kernel> buildKernel(juce::AudioFormatManager& formatManager, const juce::File& file,
+                                               double sampleRate, int tailBlock);
+    static void transformPartitions(const juce::dsp::FFT& fft, const float* impulse, int length,
+                                    int blockSize, int numPartitions, std::vector<float>& spectra);
+    static void multiplyAccumulate(const float* a, const float* b, float* sum, int numBins);
+    static int fftOrder(int fftSize);
+
+    bool adoptPendingKernel();
+    void pushTailInput(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+    void addTailOutput(int numSamples);
+    void runHead(int numChannels);
+    void processChunk(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    juce::AudioSource* source;
+    juce::AudioFormatManager& formatManager;
+    juce::ThreadPool loader { 1 };
+
+    juce::CriticalSection fileLock;
+    juce::File impulseFile;
+
+    // Kernel hand-offs.  A finished load waits in pending; the audio thread
+    // publishes what it plays in live and leaves the kernel it replaced in
+    // retired for the tail thread to delete.
+    std::atomic<Kernel*> pendingKernel { nullptr };
+    std::atomic<Kernel*> liveKernel { nullptr };
+    std::atomic<Kernel*> retiredKernel { nullptr };
+    std::atomic<juce::uint32> generation { 0 };
+
+    // Configuration the kernels have to match; set by prepareToPlay
+    std::atomic<double> configRate { 0.0 };
+    std::atomic<int> configTailBlock { 0 };
+
+    std::atomic<float> wetLevel { 0.3f };
+    std::atomic<bool> suspended { false };
+    std::atomic<float> cpuLoad { 0.0f };
+    std::atomic<float> tailLoad { 0.0f };
+    std::atomic<double> impulseSeconds { 0.0 };
+    std::atomic<int> headPartitionCount { 0 };
+    std::atomic<int> tailPartitionCount { 0 };
+    std::atomic<int> underruns { 0 };
+
+    // Audio thread
+    Kernel* activeKernel = nullptr;
+    juce::dsp::FFT headFft;
+    juce::AudioBuffer<float> headInput;    // last two head blocks of dry input
+    juce::AudioBuffer<float> headOutput;   // wet head output being played out
+    juce::AudioBuffer<float> headSpectra;  // delay line, one row per channel
+    std::vector<float> headFftData;
+    std::vector<float> headSum;
+    juce::AudioBuffer<float> wetScratch;
+    juce::SmoothedValue<float> wetGain;
+    int headPos = 0;
+    int headSlot = 0;
+    int maxHeadPartitions = 0;
+    int pendingZeros = 0;    // input the tail FIFO had no room for
+    int outputDebt = 0;      // tail output played as silence, to be skipped
+    bool stalled = false;
+    double currentSampleRate = 44100.0;
+
+    // Shared FIFOs: dry input to the tail thread, tail output back
+    juce::AbstractFifo tailInputFifo { 1 };
+    juce::AbstractFifo tailOutputFifo { 1 };
+    juce::AudioBuffer<float> tailInputBuffer;
+    juce::AudioBuffer<float> tailOutputBuffer;
+
+    // Tail thread
+    std::unique_ptr<juce::dsp::FFT> tailFft;
+    juce::AudioBuffer<float> tailInput;    // last two tail blocks of dry input
+    std::vector<float> tailSpectra[kMaxChannels];
+    std::vector<float> tailFftData;
+    std::vector<float> tailSum;
+    Kernel* tailKernel = nullptr;
+    juce::uint32 tailGeneration = 0;
+    int tailSlot = 0;
+    int tailBlock = kMinTailBlock;
+    int headLength = 2 * kMinTailBlock;
+
+    static constexpr int kHeadOrder = 9;   // FFT of two head blocks
+    static_assert((1 << kHeadOrder) == 2 * kHeadBlock, "the head FFT spans two head blocks");
+    static constexpr double kDuckSeconds = 0.05;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(ConvolutionReverb)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ConvolutionReverb)
+};
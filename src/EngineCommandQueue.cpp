@@ -0,0 +1,43 @@
+#include "EngineCommandQueue.h"
+
+EngineCommandQueue::EngineCommandQueue(std::function<void(const EngineCommand&)> applyCommand)
+    : apply(std::move(applyCommand))
+{
+}
+
+EngineCommandQueue::~EngineCommandQueue()
+{
+    cancelPendingUpdate();
+}
+
+bool EngineCommandQueue::push(const EngineCommand& command)
+{
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        commands[static_cast<size_t>(start1)] = command;
+    else if (size2 > 0)
+        commands[static_cast<size_t>(start2)] = command;
+    else
+        return false;
+
+    fifo.finishedWrite(size1 + size2);
+    triggerAsyncUpdate();
+    return true;
+}
+
+void EngineCommandQueue::handleAsyncUpdate()
+{
+    while (fifo.getNumReady() > 0)
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(1, start1, size1, start2, size2);
+
+        // Copied out first, so the slot is free again before the command runs
+        const auto command = commands[static_cast<size_t>(size1 > 0 ? start1 : start2)];
+        fifo.finishedRead(size1 + size2);
+
+        apply(command);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <functional>
+
+// A control request for the engine, as sent by a remote client
+struct EngineCommand
+{
+    enum class Type { LoadPreset, CrossfadeToPreset, SetVolume, Start, Stop, Quit };
+
+    Type type = Type::Stop;
+    juce::String path;
+    float value = 0.0f;     // volume gain, or crossfade seconds
+};
+
+// Hands commands from one control thread to the message thread.
+//
+// Commands go through a single-producer / single-consumer ring, so the
+// sender never waits for the engine; a full ring refuses the command.  Each
+// push triggers an async update, and the message thread then applies every
+// queued command in order.
+class EngineCommandQueue : private juce::AsyncUpdater
+{
+public:
+    explicit EngineCommandQueue(std::function<void(const EngineCommand&)> apply);
+    ~EngineCommandQueue() override;
+
+    // Control thread
+    bool push(const EngineCommand& command);
+
+private:
+    void handleAsyncUpdate() override;
+
+    std::function<void(const EngineCommand&)> apply;
+
+    static constexpr int kCapacity = 64;
+    juce::AbstractFifo fifo { kCapacity };
+    std::array<EngineCommand, kCapacity> commands;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EngineCommandQueue)
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+// The JUCE modules the engine library is built on.  Engine code includes
+// this instead of the generated JuceHeader.h, which belongs to an app target
+// and would drag the GUI modules in with it.
+#include <juce_core/juce_core.h>
+#include <juce_events/juce_events.h>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_audio_devices/juce_audio_devices.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
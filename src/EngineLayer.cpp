@@ -0,0 +1,456 @@
+#include "EngineLayer.h"
+#include "LoudnessAnalyzer.h"
+
+EngineLayer::EngineLayer(juce::AudioFormatManager& fm, juce::TimeSliceThread& thread, EngineTransport& engine)
+    : formatManager(fm),
+      readAheadThread(thread),
+      engineTransport(engine)
+{
+}
+
+EngineLayer::~EngineLayer()
+{
+    releaseSources();
+}
+
+void EngineLayer::releaseSources()
+{
+    gate.setRewindableSource(nullptr);
+    transportSource.stop();
+    transportSource.setSource(nullptr);
+    loopingSource.reset();
+    headStream.reset();
+    streamingSource.reset();
+    sequenceSource.reset();
+    eventSource.reset();
+}
+
+bool EngineLayer::load(const PresetLayer& layer)
+{
+    setTone(layer.tone);
+
+    bool loaded = false;
+
+    if (layer.kind == PresetLayer::Kind::Sequence)
+    {
+        loaded = loadSequence(layer.files, layer.crossfadeSamples);
+    }
+    else if (layer.kind == PresetLayer::Kind::Events)
+    {
+        loaded = loadEvents(layer.files, layer.eventSettings);
+    }
+    else if (!layer.files.isEmpty())
+    {
+        setCrossfadeEqualPower(layer.equalPower);
+        loaded = loadFile(layer.files.getFirst(), layer.loopStart, layer.loopEnd,
+                          layer.crossfadeSamples, layer.curveX, layer.curveY);
+
+        if (loaded)
+            setPlaylist(layer.playlist);
+    }
+
+    if (!loaded)
+        return false;
+
+    volume = layer.volume;
+    autoGain = layer.autoGain && loopingSource != nullptr;
+    adoptLoudness(layer);
+    applyGain();
+    return true;
+}
+
+PresetLayer EngineLayer::describe() const
+{
+    PresetLayer layer;
+    layer.volume = volume;
+    layer.autoGain = autoGain;
+    layer.equalPower = equalPower;
+    layer.tone = getTone();
+    layer.crossfadeSamples = getCrossfadeSamples();
+
+    if (sequenceSource != nullptr)
+    {
+        layer.kind = PresetLayer::Kind::Sequence;
+        layer.files = sequenceSource->getFiles();
+    }
+    else if (eventSource != nullptr)
+    {
+        layer.kind = PresetLayer::Kind::Events;
+        layer.files = eventSource->getFiles();
+        layer.eventSettings = eventSource->getSettings();
+    }
+    else
+    {
+        layer.files.add(filePath);
+
+        if (loopingSource != nullptr)
+        {
+            layer.loopStart = loopingSource->getLoopStart();
+            layer.loopEnd = loopingSource->getLoopEnd();
+            layer.curveX = loopingSource->getCurveX();
+            layer.curveY = loopingSource->getCurveY();
+            layer.playlist = loopingSource->getPlaylist();
+
+            if (hasLoudness)
+                layer.measuredLoudness = measuredLoudness;
+        }
+    }
+
+    return layer;
+}
+
+void EngineLayer::applySettings(const PresetLayer& layer)
+{
+    const auto current = describe();
+    setTone(layer.tone);
+
+    if (loopingSource != nullptr)
+    {
+        auto loopStart = layer.loopStart;
+        auto loopEnd = layer.loopEnd;
+        clampLoopRange(loopStart, loopEnd, getTotalLength());
+
+        // Each edit throws away and re-renders the audio queued ahead, so
+        // leave alone what matches
+        if (layer.equalPower != current.equalPower)
+            setCrossfadeEqualPower(layer.equalPower);
+        if (loopStart != current.loopStart || loopEnd != current.loopEnd)
+            setLoopRange(loopStart, loopEnd);
+        if (layer.crossfadeSamples != current.crossfadeSamples)
+            setCrossfadeSamples(layer.crossfadeSamples);
+        if (layer.curveX != current.curveX || layer.curveY != current.curveY)
+            setCrossfadeCurve(layer.curveX, layer.curveY);
+        if (layer.playlist.numSegments > 0 || current.playlist.numSegments > 0)
+            setPlaylist(layer.playlist);
+    }
+    else if (sequenceSource != nullptr)
+    {
+        if (layer.crossfadeSamples != current.crossfadeSamples)
+            setCrossfadeSamples(layer.crossfadeSamples);
+    }
+    else if (eventSource != nullptr)
+    {
+        setEventSettings(layer.eventSettings);
+    }
+
+    volume = layer.volume;
+    autoGain = layer.autoGain && loopingSource != nullptr;
+    adoptLoudness(layer);
+    applyGain();
+}
+
+// A bundle carries its loops' loudness, for a machine that has only the
+// embedded region to measure
+void EngineLayer::adoptLoudness(const PresetLayer& layer)
+{
+    if (loopingSource == nullptr || std::isnan(layer.measuredLoudness))
+        return;
+
+    measuredLoudness = layer.measuredLoudness;
+    hasLoudness = true;
+}
+
+const BundleAudio* EngineLayer::getEmbeddedAudio() const
+{
+    return bundle != nullptr ? bundle->findAudio(filePath) : nullptr;
+}
+
+bool EngineLayer::isPrimed() const
+{
+    // Sequences open their next file a whole file ahead, and one-shots are
+    // decoded into memory as they load
+    if (loopingSource == nullptr)
+        return true;
+
+    const auto loopStart = loopingSource->getLoopStart();
+    const auto headEnd = juce::jmin(loopingSource->getLoopEnd(),
+                                    loopStart + static_cast<juce::int64>(kPrimeSeconds * fileSampleRate));
+    return streamingSource->isRangeResident(loopStart, headEnd);
+}
+
+void EngineLayer::clampLoopRange(juce::int64& loopStart, juce::int64& loopEnd, juce::int64 totalSamples)
+{
+    if (loopEnd < 0 || loopEnd > totalSamples)
+        loopEnd = totalSamples;
+    if (loopStart < 0 || loopStart >= loopEnd)
+        loopStart = 0;
+}
+
+bool EngineLayer::loadFile(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                           int crossfadeSamples, float curveX, float curveY)
+{
+    releaseSources();
+
+    auto streaming = std::make_unique<StreamingAudioSource>(formatManager, file, readAheadThread,
+                                                            kStreamingBudgetBytes, bundle);
+    if (!streaming->isValid())
+        return false;
+
+    fileSampleRate = streaming->getSampleRate();
+
+    clampLoopRange(loopStart, loopEnd, streaming->getTotalLength());
+
+    // Until the loop engine first runs, point the prefetcher at where it starts
+    streaming->prefetchFrom(loopStart);
+
+    streamingSource = std::move(streaming);
+    filePath = file;
+    loopingSource = std::make_unique<LoopingAudioSource>(streamingSource.get(), false);
+    loopingSource->setLoopRange(loopStart, loopEnd);
+    loopingSource->setLooping(true);
+    setCrossfadeSamples(crossfadeSamples);
+    loopingSource->setCrossfadeCurve(curveX, curveY);
+    loopingSource->setCrossfadeEqualPower(equalPower);
+
+    // No read-ahead here: StreamingAudioSource already prefetches below the loop engine
+    transportSource.setSource(loopingSource.get(), 0, nullptr, fileSampleRate);
+    transportSource.start();
+
+    hasLoudness = false;
+    applyGain();
+    return true;
+}
+
+bool EngineLayer::loadSequence(const juce::Array<juce::File>& files, int crossfadeSamples)
+{
+    releaseSources();
+
+    if (files.isEmpty())
+        return false;
+
+    // Current and next file each get half the layer's usual budget
+    auto sequence = std::make_unique<SequenceAudioSource>(formatManager, files, readAheadThread,
+                                                          kStreamingBudgetBytes / 2, bundle);
+    if (!sequence->isValid())
+        return false;
+
+    sequenceSource = std::move(sequence);
+    sequenceSource->setCrossfadeSamples(crossfadeSamples);
+    fileSampleRate = sequenceSource->getSampleRate();
+    filePath = files.getFirst();
+
+    transportSource.setSource(sequenceSource.get(), 0, nullptr, fileSampleRate);
+    transportSource.start();
+    gate.setRewindableSource(sequenceSource.get());
+
+    autoGain = false;
+    hasLoudness = false;
+    applyGain();
+    return true;
+}
+
+bool EngineLayer::loadEvents(const juce::Array<juce::File>& files, const OneShotEventSource::Settings& settings)
+{
+    releaseSources();
+
+    auto events = std::make_unique<OneShotEventSource>(formatManager, files, bundle.get());
+    if (!events->isValid())
+        return false;
+
+    eventSource = std::move(events);
+    eventSource->setSettings(settings);
+    fileSampleRate = 0.0;
+    filePath = files.getFirst();
+
+    // Voices resample each one-shot themselves, so the transport passes through
+    transportSource.setSource(eventSource.get(), 0, nullptr, 0.0);
+    transportSource.start();
+    gate.setRewindableSource(eventSource.get());
+
+    autoGain = false;
+    hasLoudness = false;
+    applyGain();
+    return true;
+}
+
+void EngineLayer::setLoopRange(juce::int64 loopStart, juce::int64 loopEnd)
+{
+    if (loopingSource == nullptr)
+        return;
+
+    loopingSource->setLoopRange(loopStart, loopEnd);
+    engineTransport.parameterChanged();
+}
+
+juce::int64 EngineLayer::getTotalLength() const
+{
+    return streamingSource != nullptr ? streamingSource->getTotalLength() : 0;
+}
+
+void EngineLayer::setCrossfadeSamples(int samples)
+{
+    if (sequenceSource != nullptr)
+    {
+        sequenceSource->setCrossfadeSamples(samples);
+        engineTransport.parameterChanged();
+        return;
+    }
+
+    if (loopingSource == nullptr)
+        return;
+
+    // The first long crossfade brings up the head reader; it then stays for
+    // the life of this file, so the audio thread never sees it go away
+    if (headStream == nullptr && samples > kSharedReaderCrossfadeSeconds * fileSampleRate)
+    {
+        auto stream = std::make_unique<StreamingAudioSource>(formatManager, filePath, readAheadThread,
+                                                             kHeadStreamBudgetBytes, bundle);
+        if (stream->isValid())
+        {
+            headStream = std::move(stream);
+            streamingSource->setHeadStreamedSeparately(true);
+            loopingSource->setHeadStream(headStream.get());
+        }
+    }
+
+    loopingSource->setCrossfadeSamples(samples);
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::applyLoopSuggestion(const LoopPointFinder::Suggestion& suggestion)
+{
+    if (loopingSource == nullptr || fileSampleRate <= 0.0)
+        return;
+
+    setLoopRange(loopingSource->getLoopStart(), suggestion.loopEnd);
+    setCrossfadeSamples(suggestion.crossfadeSamples);
+    setCrossfadeCurve(suggestion.curveX, suggestion.curveY);
+    setCrossfadeEqualPower(suggestion.equalPower);
+}
+
+int EngineLayer::getCrossfadeSamples() const
+{
+    if (sequenceSource != nullptr)
+        return sequenceSource->getCrossfadeSamples();
+    if (loopingSource != nullptr)
+        return loopingSource->getCrossfadeSamples();
+    return 0;
+}
+
+void EngineLayer::setCrossfadeCurve(float curveX, float curveY)
+{
+    if (loopingSource != nullptr)
+        loopingSource->setCrossfadeCurve(curveX, curveY);
+
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::setCrossfadeEqualPower(bool shouldUseEqualPower)
+{
+    equalPower = shouldUseEqualPower;
+
+    if (loopingSource != nullptr)
+        loopingSource->setCrossfadeEqualPower(equalPower);
+
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::setPlaylist(const LoopingAudioSource::Playlist& playlist)
+{
+    if (loopingSource == nullptr)
+        return;
+
+    loopingSource->setPlaylist(playlist);
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::setEventSettings(const OneShotEventSource::Settings& settings)
+{
+    if (eventSource == nullptr)
+        return;
+
+    eventSource->setSettings(settings);
+    engineTransport.parameterChanged();
+}
+
+OneShotEventSource::Settings EngineLayer::getEventSettings() const
+{
+    if (eventSource != nullptr)
+        return eventSource->getSettings();
+    return {};
+}
+
+void EngineLayer::setLinearCrossfades(bool shouldUseLinear)
+{
+    if (loopingSource != nullptr)
+        loopingSource->setLinearCrossfades(shouldUseLinear);
+}
+
+void EngineLayer::setVolume(float newVolume)
+{
+    volume = newVolume;
+    applyGain();
+}
+
+void EngineLayer::setAutoGainEnabled(bool enabled)
+{
+    autoGain = enabled;
+    applyGain();
+}
+
+void EngineLayer::setMeasuredLoudness(double lufs)
+{
+    measuredLoudness = lufs;
+    hasLoudness = true;
+    applyGain();
+}
+
+void EngineLayer::setTargetLoudness(double lufs)
+{
+    targetLoudness = lufs;
+    applyGain();
+}
+
+void EngineLayer::applyGain()
+{
+    float gain = volume;
+
+    // Silent loops measure as gated; leave those alone rather than boost noise
+    if (autoGain && hasLoudness && measuredLoudness > LoudnessAnalyzer::kSilenceLufs)
+    {
+        const auto trimDb = juce::jlimit(-kMaxAutoGainDb, kMaxAutoGainDb,
+                                         static_cast<float>(targetLoudness - measuredLoudness));
+        gain *= juce::Decibels::decibelsToGain(trimDb);
+    }
+
+    transportSource.setGain(gain);
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::setTone(const LayerTone& tone)
+{
+    // Out-of-range presets are clamped once, here
+    toneControl.set({ juce::jlimit(LayerMixer::kMinHighPassHz, LayerMixer::kMaxLowPassHz, tone.highPassHz),
+                      juce::jlimit(LayerMixer::kMinHighPassHz, LayerMixer::kMaxLowPassHz, tone.lowPassHz),
+                      juce::jlimit(-LayerMixer::kMaxTiltDb, LayerMixer::kMaxTiltDb, tone.tiltDb),
+                      juce::jlimit(-LayerMixer::kMaxAzimuthDegrees, LayerMixer::kMaxAzimuthDegrees, tone.azimuthDegrees),
+                      juce::jlimit(1.0f, LayerMixer::kMaxDistanceMetres, tone.distanceMetres),
+                      juce::jlimit(0.0f, 1.0f, tone.width) });
+    engineTransport.parameterChanged();
+}
+
+void EngineLayer::startPlayback()
+{
+    // Joining a running scene snaps to the shared grid so loops stay in phase
+    if (isFileLoaded())
+        engineTransport.startLayer(gate.getLayerId(), engineTransport.isPlaying());
+}
+
+void EngineLayer::stopPlayback()
+{
+    engineTransport.stopLayer(gate.getLayerId());
+}
+
+void EngineLayer::setPosition(double seconds)
+{
+    engineTransport.seekLayer(gate.getLayerId(), seconds);
+}
+
+EngineLayer::PlayState EngineLayer::getPlayState() const
+{
+    PlayState state;
+    state.positionSeconds = transportSource.getCurrentPosition();
+    state.latencySeconds = engineTransport.getOutputLatencySeconds();
+    state.playing = transportSource.isPlaying();
+    return state;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <memory>
+#include "LoopingAudioSource.h"
+#include "StreamingAudioSource.h"
+#include "SequenceAudioSource.h"
+#include "OneShotEventSource.h"
+#include "LayerGate.h"
+#include "LayerMixer.h"
+#include "AnalysisTap.h"
+#include "Preset.h"
+#include "SoundscapeBundle.h"
+#include "LoopPointFinder.h"
+
+// One layer's audio chain without any GUI: the loop, sequence or one-shot
+// source, the transport that resamples it to the device rate, the gate that
+// follows the shared clock, and the layer's gain and tone.  Every setter
+// tells the EngineTransport, so audio rendered ahead is redone with it.
+//
+// Setters are for the message thread.  The getters read atomics or SeqLock
+// snapshots, so a view can poll them as often as it draws.  A layer that
+// isn't in the mixer yet can also be loaded on a worker thread.
+class EngineLayer
+{
+public:
+    // Where the layer's file is playing, for drawing a playhead
+    struct PlayState
+    {
+        double positionSeconds = 0.0;   // as rendered, before any output latency
+        double latencySeconds = 0.0;    // how far behind that the listener is
+        bool playing = false;
+    };
+
+    EngineLayer(juce::AudioFormatManager& formatManager, juce::TimeSliceThread& readAheadThread,
+                EngineTransport& engineTransport);
+    ~EngineLayer();
+
+    // Files the bundle embeds are played out of it rather than from disk.
+    // Set before loading; the layer keeps the bundle open.
+    void setBundle(std::shared_ptr<const SoundscapeBundle> newBundle) { bundle = std::move(newBundle); }
+    const std::shared_ptr<const SoundscapeBundle>& getBundle() const { return bundle; }
+
+    // The embedded copy of getFilePath(), or nullptr if it plays from disk
+    const BundleAudio* getEmbeddedAudio() const;
+
+    // Loads whichever kind of layer the preset describes, with its settings
+    bool load(const PresetLayer& layer);
+    PresetLayer describe() const;
+
+    // Takes on a preset's settings for the files already loaded, leaving the
+    // readers and their caches as they are.  Only settings that differ are
+    // touched, so an unchanged layer plays on undisturbed.
+    void applySettings(const PresetLayer& layer);
+
+    // Whether the audio the layer starts on is already in memory, so it can
+    // be brought in without a cache miss
+    bool isPrimed() const;
+
+    bool loadFile(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                  int crossfadeSamples = 0, float curveX = 0.25f, float curveY = 0.75f);
+    bool loadSequence(const juce::Array<juce::File>& files, int crossfadeSamples = 0);
+    bool loadEvents(const juce::Array<juce::File>& files, const OneShotEventSource::Settings& settings);
+
+    bool isSequence() const { return sequenceSource != nullptr; }
+    bool isEventLayer() const { return eventSource != nullptr; }
+    bool isFileLoaded() const { return streamingSource != nullptr || sequenceSource != nullptr || eventSource != nullptr; }
+
+    void setLoopRange(juce::int64 loopStart, juce::int64 loopEnd);
+    juce::int64 getTotalLength() const;
+
+    void setCrossfadeSamples(int samples);
+    int getCrossfadeSamples() const;
+    void setCrossfadeCurve(float curveX, float curveY);
+    void setCrossfadeEqualPower(bool equalPower);
+    bool isCrossfadeEqualPower() const { return equalPower; }
+    void setPlaylist(const LoopingAudioSource::Playlist& playlist);
+
+    // Moves the loop end and sets the crossfade to what the finder recommends
+    void applyLoopSuggestion(const LoopPointFinder::Suggestion& suggestion);
+    void setEventSettings(const OneShotEventSource::Settings& settings);
+    OneShotEventSource::Settings getEventSettings() const;
+
+    // Quality shedding: plain linear loop crossfades, which are cheaper
+    void setLinearCrossfades(bool shouldUseLinear);
+
+    void setVolume(float newVolume);
+    float getVolume() const { return volume; }
+    void setAutoGainEnabled(bool enabled);
+    bool isAutoGainEnabled() const { return autoGain; }
+    void setMeasuredLoudness(double lufs);
+    void setTargetLoudness(double lufs);
+
+    void setTone(const LayerTone& tone);
+    LayerTone getTone() const { return toneControl.get(); }
+
+    void startPlayback();
+    void stopPlayback();
+
+    // Moves this layer alone, as clicking its waveform does.  It goes through
+    // the transport like any seek, so a rewind plays it again.
+    void setPosition(double seconds);
+    PlayState getPlayState() const;
+
+    // The gate is what goes into the mixer; the transport behind it never stops
+    LayerGate& getGate() { return gate; }
+    const LayerMixer::ToneControl& getToneControl() const { return toneControl; }
+    AnalysisTap& getAnalysisTap() { return analysisTap; }
+    juce::AudioTransportSource& getTransportSource() { return transportSource; }
+    LoopingAudioSource* getLoopingSource() const { return loopingSource.get(); }
+    const juce::File& getFilePath() const { return filePath; }
+    double getFileSampleRate() const { return fileSampleRate; }
+
+    static constexpr float kMaxAutoGainDb = 24.0f;
+
+private:
+    void applyGain();
+    void adoptLoudness(const PresetLayer& layer);
+    void releaseSources();
+    static void clampLoopRange(juce::int64& loopStart, juce::int64& loopEnd, juce::int64 totalSamples);
+
+    juce::AudioFormatManager& formatManager;
+    juce::TimeSliceThread& readAheadThread;
+    EngineTransport& engineTransport;
+    std::shared_ptr<const SoundscapeBundle> bundle;
+
+    // Looping runs downstream of streaming and nothing buffers after it, so
+    // loop edits reach the output on the next rendered block
+    std::unique_ptr<StreamingAudioSource> streamingSource;
+    std::unique_ptr<StreamingAudioSource> headStream;
+    std::unique_ptr<LoopingAudioSource> loopingSource;
+    std::unique_ptr<SequenceAudioSource> sequenceSource;
+    std::unique_ptr<OneShotEventSource> eventSource;
+    juce::AudioTransportSource transportSource;
+    LayerGate gate { transportSource, engineTransport };
+    LayerMixer::ToneControl toneControl;
+    AnalysisTap analysisTap;
+
+    juce::File filePath;
+    double fileSampleRate = 0.0;
+    bool equalPower = false;
+    float volume = 1.0f;
+    bool autoGain = false;
+    double measuredLoudness = 0.0;
+    double targetLoudness = -23.0;
+    bool hasLoudness = false;
+
+    // Loops up to ~3 minutes of 48 kHz stereo stay fully RAM-resident
+    static constexpr size_t kStreamingBudgetBytes = 64 * 1024 * 1024;
+
+    // Crossfades up to this long read their head through the layer's own
+    // reader; longer ones get a second reader with its own small budget, so
+    // the head and tail pages don't crowd each other out of one cache
+    static constexpr double kSharedReaderCrossfadeSeconds = 5.0;
+    static constexpr size_t kHeadStreamBudgetBytes = 4 * 1024 * 1024;
+
+    // How much of the loop's head has to be resident to count as primed
+    static constexpr double kPrimeSeconds = 0.5;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EngineLayer)
+};
@@ -0,0 +1,252 @@
+#include "EngineTransport.h"
+#include <algorithm>
+
+EngineTransport::EngineTransport(juce::AudioSource* inputSource)
+    : input(inputSource)
+{
+}
+
+EngineTransport::~EngineTransport()
+{
+    stopTimer();
+}
+
+void EngineTransport::push(const Command& command)
+{
+    // Anything already waiting goes first, so the order is kept
+    if (backlog.empty() && tryPush(command))
+    {
+        parameterChanged();
+        return;
+    }
+
+    backlog.push_back(command);
+    startTimer(kRetryMs);
+}
+
+bool EngineTransport::tryPush(const Command& command)
+{
+    int start1, size1, start2, size2;
+    commandFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 > 0)
+        commands[static_cast<size_t>(start1)] = command;
+    else if (size2 > 0)
+        commands[static_cast<size_t>(start2)] = command;
+    else
+        return false;
+
+    commandFifo.finishedWrite(size1 + size2);
+    return true;
+}
+
+void EngineTransport::timerCallback()
+{
+    size_t sent = 0;
+    while (sent < backlog.size() && tryPush(backlog[sent]))
+        ++sent;
+
+    if (sent > 0)
+    {
+        backlog.erase(backlog.begin(), backlog.begin() + static_cast<std::ptrdiff_t>(sent));
+        parameterChanged();
+    }
+
+    if (backlog.empty())
+        stopTimer();
+}
+
+void EngineTransport::start()
+{
+    playing.store(true);
+    push({ EventType::Start, kAllLayers, false, 0.0 });
+}
+
+void EngineTransport::stop()
+{
+    playing.store(false);
+    push({ EventType::Stop, kAllLayers, false, 0.0 });
+}
+
+void EngineTransport::seek(double seconds)
+{
+    push({ EventType::Seek, kAllLayers, false, seconds });
+}
+
+void EngineTransport::startLayer(int layerId, bool quantiseToGrid)
+{
+    playing.store(true);
+    push({ EventType::Start, layerId, quantiseToGrid, 0.0 });
+}
+
+void EngineTransport::stopLayer(int layerId)
+{
+    push({ EventType::Stop, layerId, false, 0.0 });
+}
+
+void EngineTransport::seekLayer(int layerId, double seconds)
+{
+    push({ EventType::Seek, layerId, false, seconds });
+}
+
+void EngineTransport::changeScene(int scene)
+{
+    push({ EventType::Scene, kAllLayers, true, 0.0, scene });
+}
+
+void EngineTransport::setFadeTimes(double fadeIn, double fadeOut)
+{
+    fadeInSeconds.store(juce::jmax(0.0, fadeIn));
+    fadeOutSeconds.store(juce::jmax(0.0, fadeOut));
+}
+
+void EngineTransport::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void EngineTransport::releaseResources()
+{
+    input->releaseResources();
+}
+
+juce::int64 EngineTransport::nextGridLine(juce::int64 from) const
+{
+    const auto grid = static_cast<juce::int64>(gridSeconds.load() * currentSampleRate);
+    if (grid <= 0)
+        return from;
+
+    const auto elapsed = from - gridOrigin;
+    if (elapsed <= 0)
+        return gridOrigin;
+
+    return gridOrigin + ((elapsed + grid - 1) / grid) * grid;
+}
+
+void EngineTransport::schedule(const Event& event)
+{
+    if (numScheduled >= kMaxScheduled)
+    {
+        jassertfalse;
+        return;
+    }
+
+    int index = numScheduled;
+    while (index > 0 && scheduled[static_cast<size_t>(index - 1)].sampleTime > event.sampleTime)
+    {
+        scheduled[static_cast<size_t>(index)] = scheduled[static_cast<size_t>(index - 1)];
+        --index;
+    }
+
+    scheduled[static_cast<size_t>(index)] = event;
+    ++numScheduled;
+}
+
+void EngineTransport::drainCommands(int numSamples)
+{
+    // Only take what the schedule has room for; the rest waits a block
+    int start1, size1, start2, size2;
+    commandFifo.prepareToRead(juce::jmin(commandFifo.getNumReady(), kMaxScheduled - numScheduled),
+                              start1, size1, start2, size2);
+
+    auto handle = [this](const Command& command)
+    {
+        Event event;
+        event.type = command.type;
+        event.layerId = command.layerId;
+        event.seekSeconds = command.seekSeconds;
+        event.quantised = command.quantise;
+        event.scene = command.scene;
+        event.sampleTime = command.quantise ? nextGridLine(blockStart) : blockStart;
+
+        // A global start re-anchors the grid that late-joining layers snap to
+        if (command.type == EventType::Start && command.layerId == kAllLayers)
+            gridOrigin = event.sampleTime;
+
+        schedule(event);
+    };
+
+    for (int i = 0; i < size1; ++i)
+        handle(commands[static_cast<size_t>(start1 + i)]);
+    for (int i = 0; i < size2; ++i)
+        handle(commands[static_cast<size_t>(start2 + i)]);
+
+    commandFifo.finishedRead(size1 + size2);
+
+    numBlockEvents = 0;
+    while (numBlockEvents < numScheduled
+           && scheduled[static_cast<size_t>(numBlockEvents)].sampleTime < blockStart + numSamples)
+        ++numBlockEvents;
+}
+
+void EngineTransport::rewindTo(juce::int64 sampleTime)
+{
+    if (sampleTime >= clock)
+        return;
+
+    clock = sampleTime;
+    pendingRewind = true;
+
+    // Events from the redone stretch play again.  A command lands at the new
+    // block start rather than where it first fell, which was up to the whole
+    // render-ahead later than it was asked for; grid starts keep their line.
+    int kept = 0;
+    for (int i = 0; i < numPlayed; ++i)
+    {
+        auto event = played[static_cast<size_t>(i)];
+
+        if (event.sampleTime < sampleTime)
+        {
+            played[static_cast<size_t>(kept++)] = event;
+            continue;
+        }
+
+        if (!event.quantised)
+            event.sampleTime = sampleTime;
+
+        if (event.type == EventType::Start && event.layerId == kAllLayers)
+            gridOrigin = event.sampleTime;
+
+        schedule(event);
+    }
+
+    numPlayed = kept;
+}
+
+void EngineTransport::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    blockStart = clock;
+    ++blockSerial;
+    blockRewound = pendingRewind;
+    pendingRewind = false;
+    fadeInSamples = juce::roundToInt(fadeInSeconds.load() * currentSampleRate);
+    fadeOutSamples = juce::roundToInt(fadeOutSeconds.load() * currentSampleRate);
+    sceneFadeSamples = juce::roundToInt(sceneFadeSeconds.load() * currentSampleRate);
+
+    drainCommands(bufferToFill.numSamples);
+
+    // Every LayerGate reads this block's events while the mixer pulls it
+    input->getNextAudioBlock(bufferToFill);
+
+    // Retire the events that fell inside this block, remembering them in
+    // case the block is redone
+    for (int i = 0; i < numBlockEvents; ++i)
+    {
+        if (numPlayed == kMaxScheduled)
+        {
+            std::move(played.begin() + 1, played.end(), played.begin());
+            --numPlayed;
+        }
+
+        played[static_cast<size_t>(numPlayed++)] = scheduled[static_cast<size_t>(i)];
+    }
+
+    for (int i = numBlockEvents; i < numScheduled; ++i)
+        scheduled[static_cast<size_t>(i - numBlockEvents)] = scheduled[static_cast<size_t>(i)];
+
+    numScheduled -= numBlockEvents;
+    numBlockEvents = 0;
+
+    clock += bufferToFill.numSamples;
+}
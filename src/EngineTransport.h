@@ -0,0 +1,172 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <vector>
+
+// Shared sample clock for every layer.
+//
+// Start/stop/seek requests from the message thread are queued lock-free and
+// turned into timestamped events on the audio thread at the start of a block.
+// Each layer's LayerGate applies the events addressed to it at the exact same
+// sample, so layers never start on different callbacks.  A scene change is a
+// single event, so one scene's layers fade out on the sample the next one's
+// fade in.
+//
+// When the mix is rendered ahead of the device, the clock can be rewound to
+// an earlier block start so that audio not yet heard can be redone with new
+// settings.  Events played since then are scheduled again.
+//
+// A burst of requests larger than the queue is never dropped: what doesn't
+// fit waits on the message thread, in order, and is retried from a timer.
+class EngineTransport : public juce::AudioSource,
+                        private juce::Timer
+{
+public:
+    enum class EventType { Start, Stop, Seek, Scene };
+
+    struct Event
+    {
+        juce::int64 sampleTime = 0;
+        EventType type = EventType::Start;
+        int layerId = kAllLayers;
+        double seekSeconds = 0.0;
+        bool quantised = false;
+        int scene = 0;
+    };
+
+    static constexpr int kAllLayers = -1;
+
+    explicit EngineTransport(juce::AudioSource* input);
+    ~EngineTransport() override;
+
+    // Message thread
+    void start();
+    void stop();
+    void seek(double seconds);
+    void startLayer(int layerId, bool quantiseToGrid);
+    void stopLayer(int layerId);
+    void seekLayer(int layerId, double seconds);
+
+    // Crossfades to the layers whose gates are in the given scene, on the
+    // next grid line; every other running layer fades out
+    void changeScene(int scene);
+
+    bool isPlaying() const { return playing.load(); }
+    int allocateLayerId() { return nextLayerId.fetch_add(1); }
+
+    // Anything that changes what the engine renders calls this, so audio
+    // rendered ahead can be redone.  Transport commands count on their own.
+    void parameterChanged()
+    {
+        lastChangeTicks.store(juce::Time::getHighResolutionTicks());
+        changeCount.fetch_add(1, std::memory_order_release);
+    }
+
+    juce::uint32 getChangeCount() const { return changeCount.load(std::memory_order_acquire); }
+    juce::int64 getLastChangeTicks() const { return lastChangeTicks.load(); }
+
+    void setFadeTimes(double fadeInSeconds, double fadeOutSeconds);
+    double getFadeInSeconds() const { return fadeInSeconds.load(); }
+    double getFadeOutSeconds() const { return fadeOutSeconds.load(); }
+    void setSceneFadeSeconds(double seconds) { sceneFadeSeconds.store(juce::jmax(0.0, seconds)); }
+    double getSceneFadeSeconds() const { return sceneFadeSeconds.load(); }
+
+    // Layers joining a running transport wait for the next line of this grid,
+    // measured from the sample the transport last started on.  0 disables it.
+    void setStartGrid(double seconds) { gridSeconds.store(juce::jmax(0.0, seconds)); }
+    double getStartGrid() const { return gridSeconds.load(); }
+
+    // Delay added after the transport (the master limiter's lookahead), so
+    // playheads can show what is audible rather than what was just rendered
+    void setOutputLatency(double seconds) { outputLatencySeconds.store(seconds); }
+    double getOutputLatencySeconds() const { return outputLatencySeconds.load() + bufferedSeconds.load(); }
+    double getProcessingLatencySeconds() const { return outputLatencySeconds.load(); }
+
+    // Audio rendered but not yet handed to the device
+    void setBufferedLatency(double seconds) { bufferedSeconds.store(seconds); }
+
+    // Rendering thread, between blocks.  Moves the clock back to the start of
+    // an earlier block; each LayerGate returns to the state it recorded there.
+    juce::int64 getClock() const { return clock; }
+    void rewindTo(juce::int64 sampleTime);
+
+    // Audio thread, valid while the input is being pulled
+    juce::int64 getBlockStartSample() const { return blockStart; }
+    juce::uint32 getBlockSerial() const { return blockSerial; }
+    int getNumBlockEvents() const { return numBlockEvents; }
+    const Event& getBlockEvent(int index) const { return scheduled[static_cast<size_t>(index)]; }
+    int getFadeInSamples() const { return fadeInSamples; }
+    int getFadeOutSamples() const { return fadeOutSamples; }
+    int getSceneFadeSamples() const { return sceneFadeSamples; }
+    bool isBlockRewound() const { return blockRewound; }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    struct Command
+    {
+        EventType type = EventType::Start;
+        int layerId = kAllLayers;
+        bool quantise = false;
+        double seekSeconds = 0.0;
+        int scene = 0;
+    };
+
+    void push(const Command& command);
+    bool tryPush(const Command& command);
+    void timerCallback() override;
+    void drainCommands(int numSamples);
+    void schedule(const Event& event);
+    juce::int64 nextGridLine(juce::int64 from) const;
+
+    juce::AudioSource* input;
+
+    static constexpr int kQueueSize = 64;
+    juce::AbstractFifo commandFifo { kQueueSize };
+    std::array<Command, kQueueSize> commands;
+
+    // Message thread: commands the queue had no room for, oldest first
+    std::vector<Command> backlog;
+    static constexpr int kRetryMs = 5;
+
+    // Audio thread only, kept sorted by sampleTime
+    static constexpr int kMaxScheduled = 64;
+    std::array<Event, kMaxScheduled> scheduled;
+    int numScheduled = 0;
+    int numBlockEvents = 0;
+
+    // Events already played, oldest first, kept so a rewind can replay them
+    std::array<Event, kMaxScheduled> played;
+    int numPlayed = 0;
+    bool pendingRewind = false;
+    bool blockRewound = false;
+
+    juce::int64 clock = 0;
+    juce::int64 blockStart = 0;
+    juce::int64 gridOrigin = 0;
+    juce::uint32 blockSerial = 0;    // tells blocks apart when a rewind repeats a start
+
+    std::atomic<bool> playing { false };
+    std::atomic<int> nextLayerId { 0 };
+    std::atomic<juce::uint32> changeCount { 0 };
+    std::atomic<juce::int64> lastChangeTicks { 0 };
+
+    std::atomic<double> fadeInSeconds  { 0.05 };
+    std::atomic<double> fadeOutSeconds { 0.25 };
+    std::atomic<double> sceneFadeSeconds { 2.0 };
+    std::atomic<double> gridSeconds    { 0.0 };
+    std::atomic<double> outputLatencySeconds { 0.0 };
+    std::atomic<double> bufferedSeconds { 0.0 };
+
+    double currentSampleRate = 44100.0;
+    int fadeInSamples = 0;
+    int fadeOutSamples = 0;
+    int sceneFadeSamples = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(EngineTransport)
+};
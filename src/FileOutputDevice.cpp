@@ -0,0 +1,79 @@
+#include "FileOutputDevice.h"
+
+FileOutputDevice::FileOutputDevice(juce::AudioSource& sourceToPlay, double rate, int samplesPerBlock)
+    : juce::Thread("file-output"),
+      source(sourceToPlay),
+      sampleRate(rate),
+      blockSize(samplesPerBlock)
+{
+}
+
+FileOutputDevice::~FileOutputDevice()
+{
+    stop();
+}
+
+bool FileOutputDevice::start(const juce::File& wavFile)
+{
+    stop();
+
+    if (wavFile != juce::File{})
+    {
+        wavFile.deleteFile();
+        auto stream = wavFile.createOutputStream();
+        if (stream == nullptr)
+            return false;
+
+        writer.reset(juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate, kNumChannels,
+                                                            kBitsPerSample, {}, 0));
+        if (writer == nullptr)
+            return false;
+
+        // The writer owns the stream now
+        stream.release();
+    }
+
+    buffer.setSize(kNumChannels, blockSize);
+    source.prepareToPlay(blockSize, sampleRate);
+    prepared = true;
+    samplesRendered.store(0);
+
+    startThread(juce::Thread::Priority::high);
+    return true;
+}
+
+void FileOutputDevice::stop()
+{
+    stopThread(1000);
+
+    if (prepared)
+        source.releaseResources();
+
+    prepared = false;
+    writer.reset();
+}
+
+void FileOutputDevice::run()
+{
+    const double blockMs = 1000.0 * blockSize / sampleRate;
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+    juce::int64 blocks = 0;
+
+    while (!threadShouldExit())
+    {
+        buffer.clear();
+        source.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, blockSize));
+
+        if (writer != nullptr)
+            writer->writeFromAudioSampleBuffer(buffer, 0, blockSize);
+
+        samplesRendered.fetch_add(blockSize);
+
+        // Keep to real time, as a device would, rather than run flat out
+        const double dueMs = startMs + static_cast<double>(++blocks) * blockMs;
+        const auto waitMs = static_cast<int>(dueMs - juce::Time::getMillisecondCounterHiRes());
+
+        if (waitMs > 0)
+            wait(waitMs);
+    }
+}
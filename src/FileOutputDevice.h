@@ -0,0 +1,39 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include <memory>
+
+// Stands in for the audio device on machines without one.  Pulls the source
+// on its own thread at the pace a real device would, so read-ahead and the
+// engine's background threads behave as they do live, and writes what it
+// renders to a WAV file if given one; otherwise the audio is discarded.
+class FileOutputDevice : private juce::Thread
+{
+public:
+    FileOutputDevice(juce::AudioSource& source, double sampleRate = 48000.0, int blockSize = 512);
+    ~FileOutputDevice() override;
+
+    // An empty file gives a null output.  False if the file can't be written.
+    bool start(const juce::File& wavFile);
+    void stop();
+
+    juce::int64 getSamplesRendered() const { return samplesRendered.load(); }
+
+private:
+    void run() override;
+
+    juce::AudioSource& source;
+    const double sampleRate;
+    const int blockSize;
+
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    juce::AudioBuffer<float> buffer;
+    std::atomic<juce::int64> samplesRendered { 0 };
+    bool prepared = false;
+
+    static constexpr int kNumChannels = 2;
+    static constexpr int kBitsPerSample = 24;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(FileOutputDevice)
+};
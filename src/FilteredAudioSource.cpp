@@ -1,4 +1,5 @@
 #include "FilteredAudioSource.h"
+#include <cmath>
 
 FilteredAudioSource::FilteredAudioSource(juce::AudioSource* sourceToFilter)
     : source(sourceToFilter)
@@ -10,35 +11,208 @@ void FilteredAudioSource::prepareToPlay(int samplesPerBlockExpected, double samp
     currentSampleRate = sampleRate;
     source->prepareToPlay(samplesPerBlockExpected, sampleRate);
 
-    juce::dsp::ProcessSpec spec;
-    spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlockExpected);
-    spec.numChannels = 2;
+    for (auto& stage : stages)
+        stage.setting.reset(sampleRate, kSmoothingSeconds);
 
-    filter.prepare(spec);
-    filter.setType(juce::dsp::StateVariableTPTFilterType::highpass);
-    filter.setCutoffFrequency(cutoffHz.load());
+    // Frequencies are smoothed in log2 so sweeps move evenly per octave
+    stages[highPass].setting.setCurrentAndTargetValue(std::log2(highPassHz.load()));
+    stages[lowPass].setting.setCurrentAndTargetValue(std::log2(lowPassHz.load()));
+    stages[lowShelf].setting.setCurrentAndTargetValue(lowShelfDb.load());
+    stages[highShelf].setting.setCurrentAndTargetValue(highShelfDb.load());
+
+    for (int i = 0; i < numStages; ++i)
+        updateCoefficients(i, stages[static_cast<size_t>(i)].setting.getCurrentValue());
+
+    resetState();
+    bypassed = true;
 }
 
 void FilteredAudioSource::releaseResources()
 {
     source->releaseResources();
-    filter.reset();
+    resetState();
 }
 
-void FilteredAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+void FilteredAudioSource::resetState()
 {
-    source->getNextAudioBlock(bufferToFill);
+    for (int s = 0; s < numStages; ++s)
+    {
+        state1[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+        state2[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+    }
+}
 
-    filter.setCutoffFrequency(cutoffHz.load());
+void FilteredAudioSource::updateTargets()
+{
+    stages[highPass].setting.setTargetValue(std::log2(juce::jlimit(kMinHighPassHz, kMaxLowPassHz, highPassHz.load())));
+    stages[lowPass].setting.setTargetValue(std::log2(juce::jlimit(kMinHighPassHz, kMaxLowPassHz, lowPassHz.load())));
+    stages[lowShelf].setting.setTargetValue(juce::jlimit(-24.0f, 24.0f, lowShelfDb.load()));
+    stages[highShelf].setting.setTargetValue(juce::jlimit(-24.0f, 24.0f, highShelfDb.load()));
+}
 
-    juce::dsp::AudioBlock<float> block(*bufferToFill.buffer,
-                                       static_cast<size_t>(bufferToFill.startSample));
-    auto context = juce::dsp::ProcessContextReplacing<float>(block);
-    filter.process(context);
+bool FilteredAudioSource::isFlat(int stageIndex, float setting) const
+{
+    switch (stageIndex)
+    {
+        case highPass:  return std::exp2(setting) <= kMinHighPassHz + 0.5f;
+        case lowPass:   return std::exp2(setting) >= kMaxLowPassHz - 1.0f;
+        case lowShelf:
+        case highShelf: return std::abs(setting) < 0.01f;
+        default:        return true;
+    }
 }
 
-void FilteredAudioSource::setCutoffFrequency(float hz)
+void FilteredAudioSource::updateCoefficients(int stageIndex, float setting)
 {
-    cutoffHz.store(hz);
+    // Cytomic/Simper SVF: every response is a mix of the same three taps
+    constexpr float k = juce::MathConstants<float>::sqrt2; // Q = 1/sqrt(2)
+    const auto nyquistLimit = static_cast<float>(currentSampleRate * 0.49);
+
+    auto prewarp = [this, nyquistLimit](float hz)
+    {
+        hz = juce::jlimit(10.0f, nyquistLimit, hz);
+        return std::tan(juce::MathConstants<float>::pi * hz / static_cast<float>(currentSampleRate));
+    };
+
+    auto& stage = stages[static_cast<size_t>(stageIndex)];
+    auto& c = stage.coeffs;
+    float g = 0.0f;
+
+    switch (stageIndex)
+    {
+        case highPass:
+            g = prewarp(std::exp2(setting));
+            c.m0 = 1.0f; c.m1 = -k; c.m2 = -1.0f;
+            break;
+
+        case lowPass:
+            g = prewarp(std::exp2(setting));
+            c.m0 = 0.0f; c.m1 = 0.0f; c.m2 = 1.0f;
+            break;
+
+        case lowShelf:
+        {
+            const float a = std::pow(10.0f, setting / 40.0f);
+            g = prewarp(kLowShelfHz) / std::sqrt(a);
+            c.m0 = 1.0f; c.m1 = k * (a - 1.0f); c.m2 = a * a - 1.0f;
+            break;
+        }
+
+        case highShelf:
+        {
+            const float a = std::pow(10.0f, setting / 40.0f);
+            g = prewarp(kHighShelfHz) * std::sqrt(a);
+            c.m0 = a * a; c.m1 = k * (1.0f - a) * a; c.m2 = 1.0f - a * a;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    c.a1 = 1.0f / (1.0f + g * (g + k));
+    c.a2 = g * c.a1;
+    c.a3 = g * c.a2;
+    stage.coeffsFor = setting;
+}
+
+void FilteredAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    source->getNextAudioBlock(bufferToFill);
+
+    updateTargets();
+
+    std::array<bool, numStages> active {};
+    bool anyActive = false;
+    bool anySmoothing = false;
+
+    for (int i = 0; i < numStages; ++i)
+    {
+        auto& stage = stages[static_cast<size_t>(i)];
+        const bool smoothing = stage.setting.isSmoothing();
+        active[static_cast<size_t>(i)] = smoothing || !isFlat(i, stage.setting.getTargetValue());
+
+        // A stage that drops out starts from silence next time it's needed
+        if (stage.enabled && !active[static_cast<size_t>(i)])
+        {
+            state1[static_cast<size_t>(i)].fill(Vec::expand(0.0f));
+            state2[static_cast<size_t>(i)].fill(Vec::expand(0.0f));
+        }
+
+        stage.enabled = active[static_cast<size_t>(i)];
+        anyActive = anyActive || stage.enabled;
+        anySmoothing = anySmoothing || smoothing;
+    }
+
+    bypassed = !anyActive;
+    if (bypassed)
+        return;
+
+    juce::ScopedNoDenormals noDenormals;
+
+    constexpr int lanesPerVec = static_cast<int>(Vec::SIMDNumElements);
+    const int numChannels = juce::jmin(bufferToFill.buffer->getNumChannels(), kMaxChannels);
+    const int numGroups = (numChannels + lanesPerVec - 1) / lanesPerVec;
+
+    std::array<float*, kMaxChannels> channels {};
+    for (int ch = 0; ch < numChannels; ++ch)
+        channels[static_cast<size_t>(ch)] = bufferToFill.buffer->getWritePointer(ch, bufferToFill.startSample);
+
+    alignas(Vec::SIMDRegisterSize) float lanes[Vec::SIMDNumElements];
+
+    for (int i = 0; i < bufferToFill.numSamples; ++i)
+    {
+        if (anySmoothing)
+        {
+            for (int s = 0; s < numStages; ++s)
+            {
+                auto& stage = stages[static_cast<size_t>(s)];
+                if (!stage.setting.isSmoothing())
+                    continue;
+
+                const float value = stage.setting.getNextValue();
+                if (value != stage.coeffsFor)
+                    updateCoefficients(s, value);
+            }
+        }
+
+        for (int g = 0; g < numGroups; ++g)
+        {
+            // Interleave one frame of this channel group into the lanes
+            for (int lane = 0; lane < lanesPerVec; ++lane)
+            {
+                const int ch = g * lanesPerVec + lane;
+                lanes[lane] = ch < numChannels ? channels[static_cast<size_t>(ch)][i] : 0.0f;
+            }
+
+            auto x = Vec::fromRawArray(lanes);
+
+            for (int s = 0; s < numStages; ++s)
+            {
+                if (!active[static_cast<size_t>(s)])
+                    continue;
+
+                const auto& c = stages[static_cast<size_t>(s)].coeffs;
+                auto& ic1 = state1[static_cast<size_t>(s)][static_cast<size_t>(g)];
+                auto& ic2 = state2[static_cast<size_t>(s)][static_cast<size_t>(g)];
+
+                const auto v3 = x - ic2;
+                const auto v1 = ic1 * Vec::expand(c.a1) + v3 * Vec::expand(c.a2);
+                const auto v2 = ic2 + ic1 * Vec::expand(c.a2) + v3 * Vec::expand(c.a3);
+                ic1 = v1 * Vec::expand(2.0f) - ic1;
+                ic2 = v2 * Vec::expand(2.0f) - ic2;
+
+                x = x * Vec::expand(c.m0) + v1 * Vec::expand(c.m1) + v2 * Vec::expand(c.m2);
+            }
+
+            x.copyToRawArray(lanes);
+
+            for (int lane = 0; lane < lanesPerVec; ++lane)
+            {
+                const int ch = g * lanesPerVec + lane;
+                if (ch < numChannels)
+                    channels[static_cast<size_t>(ch)][i] = lanes[lane];
+            }
+        }
+    }
 }
@@ -1,7 +1,16 @@
 #pragma once
 
-#include <JuceHeader.h>
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
 
+// Master-bus tone stage: high-pass, low-shelf, high-shelf and low-pass in series.
+//
+// All four are TPT state-variable filters sharing one tick, run with the
+// channels interleaved across SIMDRegister lanes so a whole frame filters in
+// one vector pass.  Settings are smoothed per sample; coefficients are only
+// recomputed while a setting is moving, and the stage bypasses itself
+// entirely when everything is flat.
 class FilteredAudioSource : public juce::AudioSource
 {
 public:
@@ -11,11 +20,59 @@ public:
     void releaseResources() override;
     void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
 
-    void setCutoffFrequency(float hz);
+    void setHighPassFrequency(float hz)   { highPassHz.store(hz); }
+    void setLowPassFrequency(float hz)    { lowPassHz.store(hz); }
+    void setLowShelfGain(float decibels)  { lowShelfDb.store(decibels); }
+    void setHighShelfGain(float decibels) { highShelfDb.store(decibels); }
+
+    static constexpr float kMinHighPassHz = 20.0f;
+    static constexpr float kMaxLowPassHz  = 20000.0f;
 
 private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    enum StageIndex { highPass = 0, lowShelf, highShelf, lowPass, numStages };
+
+    struct Coefficients
+    {
+        float a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        float m0 = 1.0f, m1 = 0.0f, m2 = 0.0f;
+    };
+
+    struct Stage
+    {
+        juce::SmoothedValue<float> setting;
+        Coefficients coeffs;
+        float coeffsFor = 0.0f;
+        bool enabled = false;
+    };
+
+    static constexpr int kMaxChannels = 16;
+    static constexpr int kMaxGroups = (kMaxChannels + static_cast<int>(Vec::SIMDNumElements) - 1)
+                                    / static_cast<int>(Vec::SIMDNumElements);
+
+    void updateTargets();
+    void updateCoefficients(int stageIndex, float setting);
+    bool isFlat(int stageIndex, float setting) const;
+    void resetState();
+
     juce::AudioSource* source;
-    juce::dsp::StateVariableTPTFilter<float> filter;
-    std::atomic<float> cutoffHz { 20.0f };
+
+    std::atomic<float> highPassHz  { kMinHighPassHz };
+    std::atomic<float> lowPassHz   { kMaxLowPassHz };
+    std::atomic<float> lowShelfDb  { 0.0f };
+    std::atomic<float> highShelfDb { 0.0f };
+
+    std::array<Stage, numStages> stages;
+
+    // ic1eq / ic2eq per stage and channel group
+    std::array<std::array<Vec, kMaxGroups>, numStages> state1;
+    std::array<std::array<Vec, kMaxGroups>, numStages> state2;
+
     double currentSampleRate = 44100.0;
+    bool bypassed = true;
+
+    static constexpr float kLowShelfHz  = 250.0f;
+    static constexpr float kHighShelfHz = 4000.0f;
+    static constexpr double kSmoothingSeconds = 0.05;
 };
@@ -0,0 +1,177 @@
+#include <JuceHeader.h>
+#include <iostream>
+#include "SoundscapeEngine.h"
+#include "EngineCommandQueue.h"
+#include "OscControlServer.h"
+#include "FileOutputDevice.h"
+
+// Runs the engine with no window: plays a preset through the default audio
+// device, or through a FileOutputDevice, and takes commands over OSC.
+//
+//   DremSoundscapeDaemon <preset.json|scene.dremscape> [--port=N] [--output=device|null|<file.wav>] [--seconds=N]
+class HeadlessHost
+{
+public:
+    HeadlessHost()
+    {
+        // Nobody is looking at the meters
+        engine.setAnalysisIdle(true);
+    }
+
+    ~HeadlessHost()
+    {
+        server.reset();
+        fileOutput.reset();
+        player.setSource(nullptr);
+        deviceManager.removeAudioCallback(&player);
+    }
+
+    bool initialise(const juce::ArgumentList& args)
+    {
+        if (args.size() == 0 || args[0].isOption())
+        {
+            std::cerr << "Usage: DremSoundscapeDaemon <preset.json|scene.dremscape> [--port=N] "
+                         "[--output=device|null|<file.wav>] [--seconds=N]" << std::endl;
+            return false;
+        }
+
+        if (!loadPreset(args[0].resolveAsFile(), kLoadFadeSeconds))
+            return false;
+
+        const auto output = args.containsOption("--output") ? args.getValueForOption("--output") : juce::String("device");
+
+        if (output == "device")
+        {
+            const auto error = deviceManager.initialiseWithDefaultDevices(0, 2);
+            if (error.isNotEmpty())
+            {
+                juce::Logger::writeToLog("Audio device error: " + error);
+                return false;
+            }
+
+            deviceManager.addAudioCallback(&player);
+            player.setSource(&engine.getOutput());
+
+            if (auto* device = deviceManager.getCurrentAudioDevice())
+                engine.setDeviceLatency((device->getOutputLatencyInSamples() + device->getCurrentBufferSizeSamples())
+                                        / device->getCurrentSampleRate());
+        }
+        else
+        {
+            const auto file = output == "null" ? juce::File{} : juce::File::getCurrentWorkingDirectory().getChildFile(output);
+            fileOutput = std::make_unique<FileOutputDevice>(engine.getOutput());
+
+            if (!fileOutput->start(file))
+            {
+                juce::Logger::writeToLog("Can't write " + file.getFullPathName());
+                return false;
+            }
+        }
+
+        const int port = args.containsOption("--port") ? args.getValueForOption("--port").getIntValue()
+                                                       : OscControlServer::kDefaultPort;
+        server = std::make_unique<OscControlServer>(commands);
+
+        if (!server->start(port))
+        {
+            juce::Logger::writeToLog("Can't listen for OSC on port " + juce::String(port));
+            return false;
+        }
+
+        // Mainly for rendering a fixed length to a file
+        if (args.containsOption("--seconds"))
+        {
+            const auto seconds = args.getValueForOption("--seconds").getDoubleValue();
+            juce::Timer::callAfterDelay(juce::roundToInt(seconds * 1000.0), []
+            {
+                juce::MessageManager::getInstance()->stopDispatchLoop();
+            });
+        }
+
+        engine.start();
+        juce::Logger::writeToLog("Playing " + args[0].text + ", OSC on 127.0.0.1:" + juce::String(port));
+        return true;
+    }
+
+private:
+    // The engine keeps playing while the new layers load, then crossfades
+    bool loadPreset(const juce::File& file, double crossfadeSeconds)
+    {
+        if (file.hasFileExtension(SoundscapeBundle::kFileExtension))
+        {
+            if (engine.loadBundle(file, crossfadeSeconds))
+                return true;
+
+            juce::Logger::writeToLog("Can't read bundle " + file.getFullPathName());
+            return false;
+        }
+
+        Preset preset;
+        if (!Preset::load(file, preset))
+        {
+            juce::Logger::writeToLog("Can't read preset " + file.getFullPathName());
+            return false;
+        }
+
+        engine.loadPreset(preset, crossfadeSeconds);
+        return true;
+    }
+
+    void apply(const EngineCommand& command)
+    {
+        switch (command.type)
+        {
+            case EngineCommand::Type::LoadPreset:
+                loadPreset(juce::File(command.path), kLoadFadeSeconds);
+                break;
+
+            case EngineCommand::Type::CrossfadeToPreset:
+                loadPreset(juce::File(command.path), command.value);
+                break;
+
+            case EngineCommand::Type::SetVolume:
+                engine.setMasterVolume(juce::jlimit(0.0f, 1.5f, command.value));
+                break;
+
+            case EngineCommand::Type::Start:
+                engine.start();
+                break;
+
+            case EngineCommand::Type::Stop:
+                engine.stop();
+                break;
+
+            case EngineCommand::Type::Quit:
+                juce::MessageManager::getInstance()->stopDispatchLoop();
+                break;
+        }
+    }
+
+    SoundscapeEngine engine;
+    juce::AudioDeviceManager deviceManager;
+    juce::AudioSourcePlayer player;
+    std::unique_ptr<FileOutputDevice> fileOutput;
+    EngineCommandQueue commands { [this](const EngineCommand& command) { apply(command); } };
+    std::unique_ptr<OscControlServer> server;
+
+    // A plain load still crossfades, just quickly enough to sound like a cut
+    static constexpr double kLoadFadeSeconds = 0.25;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HeadlessHost)
+};
+
+int main(int argc, char* argv[])
+{
+    // Timers and async callbacks still need a message loop, without any windows
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    {
+        HeadlessHost host;
+        if (!host.initialise(juce::ArgumentList(argc, argv)))
+            return 1;
+
+        juce::MessageManager::getInstance()->runDispatchLoop();
+    }
+
+    return 0;
+}
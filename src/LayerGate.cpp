@@ -0,0 +1,213 @@
+#include "LayerGate.h"
+
+LayerGate::LayerGate(juce::AudioTransportSource& src, EngineTransport& eng)
+    : source(src),
+      engine(eng),
+      layerId(eng.allocateLayerId())
+{
+}
+
+void LayerGate::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    source.prepareToPlay(samplesPerBlockExpected, sampleRate);
+}
+
+void LayerGate::releaseResources()
+{
+    source.releaseResources();
+}
+
+void LayerGate::applyEvent(const EngineTransport::Event& event)
+{
+    switch (event.type)
+    {
+        case EngineTransport::EventType::Start:
+            if (retired.load())
+                break;
+
+            setRampShape(false);
+            running = true;
+            stopping = false;
+            break;
+
+        case EngineTransport::EventType::Stop:
+            if (running)
+            {
+                setRampShape(false);
+                stopping = true;
+            }
+            break;
+
+        case EngineTransport::EventType::Scene:
+            if (event.scene == sceneId.load())
+            {
+                setRampShape(true);
+                running = true;
+                stopping = false;
+            }
+            else if (running)
+            {
+                setRampShape(true);
+                stopping = true;
+            }
+            break;
+
+        case EngineTransport::EventType::Seek:
+            // LoopingAudioSource ramps out of the old position itself
+            source.setPosition(event.seekSeconds);
+            break;
+    }
+
+    open.store(running && !stopping);
+}
+
+void LayerGate::setRampShape(bool equalPower)
+{
+    if (equalPower == sceneFade)
+        return;
+
+    // Carry on from the level heard so far, not from the same progress
+    const auto halfPi = juce::MathConstants<float>::halfPi;
+    gain = equalPower ? std::asin(gain) / halfPi : std::sin(gain * halfPi);
+    sceneFade = equalPower;
+}
+
+float LayerGate::levelFor(float progress) const
+{
+    return sceneFade ? std::sin(progress * juce::MathConstants<float>::halfPi) : progress;
+}
+
+void LayerGate::renderSegment(const juce::AudioSourceChannelInfo& bufferToFill, int from, int to)
+{
+    auto* buffer = bufferToFill.buffer;
+
+    while (from < to)
+    {
+        if (!running)
+        {
+            buffer->clear(bufferToFill.startSample + from, to - from);
+            return;
+        }
+
+        const float target = stopping ? 0.0f : 1.0f;
+        const int rampSamples = sceneFade ? engine.getSceneFadeSamples()
+                              : stopping ? engine.getFadeOutSamples() : engine.getFadeInSamples();
+        int length = to - from;
+
+        if (gain != target && rampSamples > 0)
+        {
+            const float step = 1.0f / static_cast<float>(rampSamples);
+            const int samplesToTarget = juce::jmax(1, static_cast<int>(std::ceil(std::abs(target - gain) / step)));
+            length = juce::jmin(length, samplesToTarget);
+        }
+
+        juce::AudioSourceChannelInfo segment(buffer, bufferToFill.startSample + from, length);
+        source.getNextAudioBlock(segment);
+
+        if (gain != target)
+        {
+            float endGain = target;
+            if (rampSamples > 0)
+            {
+                const float delta = static_cast<float>(length) / static_cast<float>(rampSamples);
+                endGain = target > gain ? juce::jmin(target, gain + delta) : juce::jmax(target, gain - delta);
+            }
+
+            for (int ch = 0; ch < buffer->getNumChannels(); ++ch)
+                buffer->applyGainRamp(ch, segment.startSample, length, levelFor(gain), levelFor(endGain));
+
+            gain = endGain;
+
+            if (stopping && gain <= 0.0f)
+            {
+                running = false;
+                stopping = false;
+            }
+        }
+
+        from += length;
+    }
+}
+
+void LayerGate::remember(juce::int64 sampleTime)
+{
+    // A rewound block already has the snapshot it was put back to
+    if (history[static_cast<size_t>(historyPos)].sampleTime == sampleTime)
+        return;
+
+    historyPos = (historyPos + 1) % kHistory;
+    history[static_cast<size_t>(historyPos)] = { sampleTime, source.getNextReadPosition(), running, stopping, sceneFade, gain };
+
+    if (auto* rewindable = rewindableSource.load())
+        rewindable->saveRewindState(historyPos);
+}
+
+void LayerGate::restore(juce::int64 sampleTime)
+{
+    for (int age = 0; age < kHistory; ++age)
+    {
+        const int index = (historyPos - age + kHistory) % kHistory;
+        const auto& snapshot = history[static_cast<size_t>(index)];
+
+        if (snapshot.sampleTime != sampleTime)
+            continue;
+
+        // LoopingAudioSource ramps out of the abandoned position itself
+        auto* rewindable = rewindableSource.load();
+        const bool canRewind = rewindable == nullptr || rewindable->restoreRewindState(index);
+
+        if (canRewind && source.getNextReadPosition() != snapshot.position)
+            source.setNextReadPosition(snapshot.position);
+
+        running = snapshot.running;
+        stopping = snapshot.stopping;
+        sceneFade = snapshot.sceneFade;
+        gain = snapshot.gain;
+        open.store(running && !stopping);
+
+        // Later blocks are about to be redone
+        historyPos = index;
+        return;
+    }
+}
+
+void LayerGate::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const auto blockStart = engine.getBlockStartSample();
+
+    // State is restored and recorded on the first piece of a block only
+    if (engine.getBlockSerial() != pieceBlock)
+    {
+        pieceBlock = engine.getBlockSerial();
+        pieceOffset = 0;
+
+        if (engine.isBlockRewound())
+            restore(blockStart);
+
+        remember(blockStart);
+    }
+
+    const int pieceStart = pieceOffset;
+    const int pieceEnd = pieceStart + bufferToFill.numSamples;
+    pieceOffset = pieceEnd;
+    int offset = 0;
+
+    // Only the events that fall inside this piece, each applied once
+    for (int i = 0; i < engine.getNumBlockEvents(); ++i)
+    {
+        const auto& event = engine.getBlockEvent(i);
+        if (event.layerId != EngineTransport::kAllLayers && event.layerId != layerId)
+            continue;
+
+        const auto blockOffset = juce::jmax(static_cast<juce::int64>(0), event.sampleTime - blockStart);
+        if (blockOffset < pieceStart || blockOffset >= pieceEnd)
+            continue;
+
+        const int eventOffset = static_cast<int>(blockOffset) - pieceStart;
+        renderSegment(bufferToFill, offset, eventOffset);
+        offset = eventOffset;
+        applyEvent(event);
+    }
+
+    renderSegment(bufferToFill, offset, bufferToFill.numSamples);
+}
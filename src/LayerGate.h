@@ -0,0 +1,87 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include "EngineTransport.h"
+#include "RewindableSource.h"
+
+// Per-layer start/stop gate driven by the shared EngineTransport clock.
+//
+// The layer's AudioTransportSource is left running; the gate decides, sample
+// accurately, when it is pulled and ramps its level in and out.  While the
+// gate is closed the source isn't pulled, so the layer's position holds.
+// Scene changes ramp on an equal-power curve: the two scenes are unrelated
+// material, which a linear crossfade would leave 3 dB down halfway through.
+//
+// The gate records where it stood at the start of each block, so when the
+// transport rewinds it can put the layer back where it was.  A source with
+// more state than a read position saves and restores the rest alongside.
+class LayerGate : public juce::AudioSource
+{
+public:
+    LayerGate(juce::AudioTransportSource& source, EngineTransport& engine);
+
+    int getLayerId() const { return layerId; }
+    bool isOpen() const { return open.load(); }
+
+    // The scene a Scene event has to name for this layer to fade in
+    void setScene(int scene) { sceneId.store(scene); }
+
+    // For a layer on its way out of the mixer: from now on only events that
+    // stop it are heard, so a Start can't bring back a scene being replaced
+    void retire() { retired.store(true); }
+
+    // The source behind the transport, if it has more to rewind than its
+    // position; set when the layer loads, null when it unloads
+    void setRewindableSource(RewindableSource* rewindable) { rewindableSource.store(rewindable); }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    struct Snapshot
+    {
+        juce::int64 sampleTime = -1;
+        juce::int64 position = 0;
+        bool running = false;
+        bool stopping = false;
+        bool sceneFade = false;
+        float gain = 0.0f;
+    };
+
+    void applyEvent(const EngineTransport::Event& event);
+    void setRampShape(bool equalPower);
+    float levelFor(float progress) const;
+    void renderSegment(const juce::AudioSourceChannelInfo& bufferToFill, int from, int to);
+    void remember(juce::int64 sampleTime);
+    void restore(juce::int64 sampleTime);
+
+    juce::AudioTransportSource& source;
+    EngineTransport& engine;
+    const int layerId;
+
+    // Audio thread state
+    bool running = false;
+    bool stopping = false;
+    bool sceneFade = false;
+    float gain = 0.0f;    // ramp progress; the level it gives depends on the curve
+
+    // Covers a few seconds of render-ahead blocks
+    static constexpr int kHistory = RewindableSource::kRewindSlots;
+    std::array<Snapshot, kHistory> history {};
+    int historyPos = 0;
+
+    // The mixer may pull a block in pieces: the block they belong to and how
+    // far into it the next piece starts
+    juce::uint32 pieceBlock = 0;
+    int pieceOffset = 0;
+
+    std::atomic<bool> open { false };
+    std::atomic<int> sceneId { 0 };
+    std::atomic<bool> retired { false };
+    std::atomic<RewindableSource*> rewindableSource { nullptr };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LayerGate)
+};
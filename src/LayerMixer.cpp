@@ -0,0 +1,732 @@
+#include "LayerMixer.h"
+#include <cmath>
+
+void LayerMixer::ToneControl::set(const LayerTone& tone)
+{
+    highPassHz.store(tone.highPassHz);
+    lowPassHz.store(tone.lowPassHz);
+    tiltDb.store(tone.tiltDb);
+    azimuthDegrees.store(tone.azimuthDegrees);
+    distanceMetres.store(tone.distanceMetres);
+    width.store(tone.width);
+}
+
+LayerTone LayerMixer::ToneControl::get() const
+{
+    return { highPassHz.load(), lowPassHz.load(), tiltDb.load(),
+             azimuthDegrees.load(), distanceMetres.load(), width.load() };
+}
+
+LayerMixer::Group::Group()
+{
+    for (auto& c : coeffs)
+    {
+        c.a1 = c.a2 = c.a3 = Vec::expand(0.0f);
+        c.m0 = Vec::expand(1.0f);
+        c.m1 = c.m2 = Vec::expand(0.0f);
+    }
+
+    for (int s = 0; s < numStages; ++s)
+    {
+        state1[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+        state2[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+    }
+
+    // Identity: left to left, right to right, no air absorption
+    matrix.fill(Vec::expand(0.0f));
+    matrix[leftToLeft] = matrix[rightToRight] = Vec::expand(1.0f);
+    matrixTarget = matrix;
+    air = airTarget = Vec::expand(1.0f);
+    airState.fill(Vec::expand(0.0f));
+}
+
+void LayerMixer::Group::clearLane(int lane)
+{
+    for (int s = 0; s < numStages; ++s)
+    {
+        for (int ch = 0; ch < kMaxChannels; ++ch)
+        {
+            state1[static_cast<size_t>(s)][static_cast<size_t>(ch)].set(static_cast<size_t>(lane), 0.0f);
+            state2[static_cast<size_t>(s)][static_cast<size_t>(ch)].set(static_cast<size_t>(lane), 0.0f);
+        }
+    }
+
+    for (auto& state : airState)
+        state.set(static_cast<size_t>(lane), 0.0f);
+}
+
+LayerMixer::~LayerMixer()
+{
+    removeAllInputs();
+}
+
+void LayerMixer::addInputSource(juce::AudioSource* input, const ToneControl* tone, AnalysisTap* tap)
+{
+    jassert(input != nullptr && tone != nullptr);
+
+    bool isPrepared = false;
+    double sampleRate = 0.0;
+    int blockSize = 0;
+
+    {
+        const juce::ScopedLock sl(lock);
+        isPrepared = prepared;
+        sampleRate = currentSampleRate;
+        blockSize = scratchSize;
+    }
+
+    if (isPrepared)
+    {
+        input->prepareToPlay(blockSize, sampleRate);
+
+        if (tap != nullptr)
+            tap->setSampleRate(sampleRate);
+    }
+
+    // Only the message thread changes which slots are in use, so the
+    // bookkeeping below can read them without the lock
+    int slotIndex = -1;
+    for (size_t i = 0; i < slots.size() && slotIndex < 0; ++i)
+        if (slots[i].source == nullptr)
+            slotIndex = static_cast<int>(i);
+
+    if (slotIndex < 0)
+    {
+        // Grow by a whole lane group, allocating before taking the lock
+        slotIndex = static_cast<int>(slots.size());
+
+        std::vector<Slot> grownSlots(slots.size() + static_cast<size_t>(kLanes));
+        std::vector<Group> grownGroups(groups.size() + 1);
+
+        for (size_t i = slots.size(); i < grownSlots.size(); ++i)
+            grownSlots[i].scratch.setSize(kMaxChannels, blockSize);
+
+        const juce::ScopedLock sl(lock);
+
+        for (size_t i = 0; i < slots.size(); ++i)
+            grownSlots[i] = std::move(slots[i]);
+
+        for (size_t i = 0; i < groups.size(); ++i)
+            grownGroups[i] = groups[i];
+
+        slots.swap(grownSlots);
+        groups.swap(grownGroups);
+    }
+
+    const juce::ScopedLock sl(lock);
+
+    auto& slot = slots[static_cast<size_t>(slotIndex)];
+    slot.source = input;
+    slot.tone = tone;
+    slot.tap = tap;
+    initialiseSlot(slotIndex);
+
+    ++groups[static_cast<size_t>(slotIndex / kLanes)].numSources;
+}
+
+void LayerMixer::removeInputSource(juce::AudioSource* input)
+{
+    if (input == nullptr)
+        return;
+
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        if (slots[i].source != input)
+            continue;
+
+        {
+            const juce::ScopedLock sl(lock);
+
+            slots[i].source = nullptr;
+            slots[i].tone = nullptr;
+            slots[i].tap = nullptr;
+
+            auto& group = groups[i / static_cast<size_t>(kLanes)];
+            --group.numSources;
+            group.clearLane(static_cast<int>(i % static_cast<size_t>(kLanes)));
+        }
+
+        input->releaseResources();
+        return;
+    }
+}
+
+void LayerMixer::removeAllInputs()
+{
+    juce::Array<juce::AudioSource*> removed;
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        for (auto& slot : slots)
+        {
+            if (slot.source != nullptr)
+                removed.add(slot.source);
+
+            slot.source = nullptr;
+            slot.tone = nullptr;
+            slot.tap = nullptr;
+        }
+
+        for (auto& group : groups)
+            group = Group();
+    }
+
+    for (auto* input : removed)
+        input->releaseResources();
+}
+
+void LayerMixer::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    const juce::ScopedLock sl(lock);
+
+    currentSampleRate = sampleRate;
+    scratchSize = juce::jmax(1, samplesPerBlockExpected);
+    prepared = true;
+
+    for (auto& group : groups)
+    {
+        const int numSources = group.numSources;
+        group = Group();
+        group.numSources = numSources;
+    }
+
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        auto& slot = slots[i];
+        slot.scratch.setSize(kMaxChannels, scratchSize);
+
+        if (slot.source != nullptr)
+        {
+            slot.source->prepareToPlay(samplesPerBlockExpected, sampleRate);
+            initialiseSlot(static_cast<int>(i));
+
+            if (slot.tap != nullptr)
+                slot.tap->setSampleRate(sampleRate);
+        }
+    }
+}
+
+void LayerMixer::releaseResources()
+{
+    const juce::ScopedLock sl(lock);
+
+    for (auto& slot : slots)
+        if (slot.source != nullptr)
+            slot.source->releaseResources();
+
+    prepared = false;
+}
+
+float LayerMixer::toSetting(int stageIndex, const LayerTone& tone)
+{
+    // Frequencies are smoothed in log2 so sweeps move evenly per octave
+    switch (stageIndex)
+    {
+        case highPass: return std::log2(juce::jlimit(kMinHighPassHz, kMaxLowPassHz, tone.highPassHz));
+        case lowPass:  return std::log2(juce::jlimit(kMinHighPassHz, kMaxLowPassHz, tone.lowPassHz));
+        case tilt:     return juce::jlimit(-kMaxTiltDb, kMaxTiltDb, tone.tiltDb);
+        default:       return 0.0f;
+    }
+}
+
+bool LayerMixer::isFlat(int stageIndex, float setting)
+{
+    switch (stageIndex)
+    {
+        case highPass: return std::exp2(setting) <= kMinHighPassHz + 0.5f;
+        case lowPass:  return std::exp2(setting) >= kMaxLowPassHz - 1.0f;
+        case tilt:     return std::abs(setting) < 0.01f;
+        default:       return true;
+    }
+}
+
+void LayerMixer::initialiseSlot(int slotIndex)
+{
+    auto& slot = slots[static_cast<size_t>(slotIndex)];
+    const auto tone = slot.tone->get();
+
+    for (int s = 0; s < numStages; ++s)
+    {
+        auto& setting = slot.setting[static_cast<size_t>(s)];
+        setting.reset(currentSampleRate > 0.0 ? currentSampleRate : 44100.0, kSmoothingSeconds);
+        setting.setCurrentAndTargetValue(toSetting(s, tone));
+
+        if (currentSampleRate > 0.0)
+            updateLane(slotIndex, s, setting.getCurrentValue());
+    }
+
+    const std::array<float, numSpaceSettings> space { tone.azimuthDegrees, tone.distanceMetres, tone.width };
+    for (int s = 0; s < numSpaceSettings; ++s)
+    {
+        auto& setting = slot.space[static_cast<size_t>(s)];
+        setting.reset(currentSampleRate > 0.0 ? currentSampleRate : 44100.0, kSmoothingSeconds);
+        setting.setCurrentAndTargetValue(space[static_cast<size_t>(s)]);
+    }
+
+    // A new layer starts where it was placed rather than sweeping in
+    auto& group = groups[static_cast<size_t>(slotIndex / kLanes)];
+    const auto lane = static_cast<size_t>(slotIndex % kLanes);
+    std::array<float, numMatrixTerms> matrix {};
+    float air = 1.0f;
+    spaceTargets(space, currentSampleRate, matrix, air);
+
+    for (int t = 0; t < numMatrixTerms; ++t)
+    {
+        group.matrix[static_cast<size_t>(t)].set(lane, matrix[static_cast<size_t>(t)]);
+        group.matrixTarget[static_cast<size_t>(t)].set(lane, matrix[static_cast<size_t>(t)]);
+    }
+
+    group.air.set(lane, air);
+    group.airTarget.set(lane, air);
+    group.clearLane(slotIndex % kLanes);
+}
+
+void LayerMixer::spaceTargets(const std::array<float, numSpaceSettings>& space, double sampleRate,
+                              std::array<float, numMatrixTerms>& matrix, float& air)
+{
+    const float pan = juce::jlimit(-1.0f, 1.0f, space[azimuth] / kMaxAzimuthDegrees);
+    const float spread = juce::jlimit(0.0f, 1.0f, space[width]);
+    const float metres = juce::jlimit(1.0f, kMaxDistanceMetres, space[distance]);
+
+    // Each input channel is a point source, spread either side of the layer's
+    // azimuth by its width and panned equal-power; the inverse distance law
+    // sets the level.  Centre at full width is the identity.
+    auto angle = [](float p) { return (juce::jlimit(-1.0f, 1.0f, p) + 1.0f) * juce::MathConstants<float>::pi * 0.25f; };
+    const float leftAngle = angle(pan - spread);
+    const float rightAngle = angle(pan + spread);
+
+    // Narrowing sums the two channels, which lifts near-mono material by up
+    // to 3 dB; dividing by what the centre gains add up to keeps it level,
+    // so width 0 folds each channel in at 0.5
+    const float fold = 1.0f / (juce::MathConstants<float>::sqrt2
+                               * std::cos(spread * juce::MathConstants<float>::pi * 0.25f));
+    const float gain = fold / metres;
+
+    matrix[leftToLeft] = gain * std::cos(leftAngle);
+    matrix[leftToRight] = gain * std::sin(leftAngle);
+    matrix[rightToLeft] = gain * std::cos(rightAngle);
+    matrix[rightToRight] = gain * std::sin(rightAngle);
+
+    // One-pole coefficient; 1 passes everything and is reached smoothly at 1 m
+    air = 1.0f;
+    if (metres > 1.0f && sampleRate > 0.0)
+    {
+        const double cutoff = kAirHzMetres / (metres - 1.0f);
+        air = static_cast<float>(1.0 - std::exp(-juce::MathConstants<double>::twoPi * cutoff / sampleRate));
+    }
+}
+
+void LayerMixer::updateLane(int slotIndex, int stageIndex, float setting)
+{
+    // Cytomic/Simper SVF, same tick as the master bus
+    constexpr float k = juce::MathConstants<float>::sqrt2;
+    const auto nyquistLimit = static_cast<float>(currentSampleRate * 0.49);
+
+    auto prewarp = [this, nyquistLimit](float hz)
+    {
+        hz = juce::jlimit(10.0f, nyquistLimit, hz);
+        return std::tan(juce::MathConstants<float>::pi * hz / static_cast<float>(currentSampleRate));
+    };
+
+    float g = 0.0f, m0 = 1.0f, m1 = 0.0f, m2 = 0.0f;
+
+    switch (stageIndex)
+    {
+        case highPass:
+            g = prewarp(std::exp2(setting));
+            m0 = 1.0f; m1 = -k; m2 = -1.0f;
+            break;
+
+        case lowPass:
+            g = prewarp(std::exp2(setting));
+            m0 = 0.0f; m1 = 0.0f; m2 = 1.0f;
+            break;
+
+        case tilt:
+        {
+            // High shelf of twice the tilt, pulled down by the tilt: lows go
+            // down by half the amount and highs up by half around the pivot
+            const float a = std::pow(10.0f, setting / 40.0f);
+            g = prewarp(kTiltPivotHz) * std::sqrt(a);
+            m0 = a; m1 = k * (1.0f - a); m2 = (1.0f - a * a) / a;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    // A flat lane in an otherwise active group passes straight through but
+    // keeps its state running, so it can start filtering without a jump
+    if (isFlat(stageIndex, setting))
+    {
+        m0 = 1.0f; m1 = 0.0f; m2 = 0.0f;
+    }
+
+    const float a1 = 1.0f / (1.0f + g * (g + k));
+    const float a2 = g * a1;
+    const float a3 = g * a2;
+
+    auto& c = groups[static_cast<size_t>(slotIndex / kLanes)].coeffs[static_cast<size_t>(stageIndex)];
+    const auto lane = static_cast<size_t>(slotIndex % kLanes);
+
+    c.a1.set(lane, a1);
+    c.a2.set(lane, a2);
+    c.a3.set(lane, a3);
+    c.m0.set(lane, m0);
+    c.m1.set(lane, m1);
+    c.m2.set(lane, m2);
+
+    slots[static_cast<size_t>(slotIndex)].coeffsFor[static_cast<size_t>(stageIndex)] = setting;
+}
+
+void LayerMixer::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const juce::ScopedLock sl(lock);
+
+    bufferToFill.clearActiveBufferRegion();
+
+    if (!prepared || groups.empty())
+        return;
+
+    juce::ScopedNoDenormals noDenormals;
+
+    // Blocks larger than promised are mixed in scratch-sized pieces
+    for (int done = 0; done < bufferToFill.numSamples;)
+    {
+        const int chunk = juce::jmin(bufferToFill.numSamples - done, scratchSize);
+        renderChunk(*bufferToFill.buffer, bufferToFill.startSample + done, chunk);
+        done += chunk;
+    }
+}
+
+void LayerMixer::renderChunk(juce::AudioBuffer<float>& output, int startSample, int numSamples)
+{
+    const int numChannels = juce::jmin(output.getNumChannels(), kMaxChannels);
+    if (numChannels <= 0)
+        return;
+
+    // Pull every layer into its own scratch buffer and pick up new settings
+    for (auto& slot : slots)
+    {
+        if (slot.source == nullptr)
+            continue;
+
+        juce::AudioBuffer<float> view(slot.scratch.getArrayOfWritePointers(), numChannels, numSamples);
+        slot.source->getNextAudioBlock(juce::AudioSourceChannelInfo(&view, 0, numSamples));
+
+        const auto tone = slot.tone->get();
+        for (int s = 0; s < numStages; ++s)
+            slot.setting[static_cast<size_t>(s)].setTargetValue(toSetting(s, tone));
+
+        slot.space[azimuth].setTargetValue(tone.azimuthDegrees);
+        slot.space[distance].setTargetValue(tone.distanceMetres);
+        slot.space[width].setTargetValue(tone.width);
+    }
+
+    const bool filtersEnabled = layerFilters.load();
+    const bool cull = cullQuietLayers.load();
+
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        auto& group = groups[g];
+
+        if (group.numSources > 0)
+            updateSpatial(group, static_cast<int>(g), numSamples, numChannels);
+
+        group.culled = cull;
+
+        for (int lane = 0; lane < kLanes && group.culled; ++lane)
+        {
+            const auto& slot = slots[g * static_cast<size_t>(kLanes) + static_cast<size_t>(lane)];
+            if (slot.source == nullptr)
+                continue;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                if (slot.scratch.getMagnitude(ch, 0, numSamples) >= kCullLevel)
+                    group.culled = false;
+        }
+
+        for (int s = 0; s < numStages; ++s)
+        {
+            bool needed = false;
+
+            for (int lane = 0; lane < kLanes; ++lane)
+            {
+                const auto& slot = slots[g * static_cast<size_t>(kLanes) + static_cast<size_t>(lane)];
+                if (slot.source == nullptr)
+                    continue;
+
+                const auto& setting = slot.setting[static_cast<size_t>(s)];
+                needed = needed || setting.isSmoothing() || !isFlat(s, setting.getTargetValue());
+            }
+
+            needed = needed && filtersEnabled;
+
+            // A stage that drops out starts from silence next time it's needed
+            if (group.active[static_cast<size_t>(s)] && !needed)
+            {
+                group.state1[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+                group.state2[static_cast<size_t>(s)].fill(Vec::expand(0.0f));
+            }
+
+            group.active[static_cast<size_t>(s)] = needed;
+        }
+    }
+
+    // Coefficients follow the smoothed settings in small steps
+    for (int offset = 0; offset < numSamples; offset += kSmoothingStep)
+    {
+        const int step = juce::jmin(kSmoothingStep, numSamples - offset);
+
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            auto& slot = slots[i];
+            if (slot.source == nullptr)
+                continue;
+
+            for (int s = 0; s < numStages; ++s)
+            {
+                auto& setting = slot.setting[static_cast<size_t>(s)];
+                if (!setting.isSmoothing())
+                    continue;
+
+                const float value = setting.skip(step);
+                if (value != slot.coeffsFor[static_cast<size_t>(s)])
+                    updateLane(static_cast<int>(i), s, value);
+            }
+        }
+
+        for (size_t g = 0; g < groups.size(); ++g)
+            if (groups[g].numSources > 0 && !groups[g].culled)
+                filterGroup(groups[g], static_cast<int>(g), output, startSample, offset, step, numChannels);
+    }
+
+    // Panned groups are summed here, once the filters have run over the chunk
+    for (size_t g = 0; g < groups.size(); ++g)
+        if (groups[g].numSources > 0 && groups[g].spatialActive && !groups[g].culled)
+            panGroup(groups[g], static_cast<int>(g), output, startSample, numSamples);
+
+    // Scratch now holds each layer's filtered audio, ready for its meters
+    if (!layerMeters.load())
+        return;
+
+    for (auto& slot : slots)
+        if (slot.source != nullptr && slot.tap != nullptr)
+            slot.tap->push(slot.scratch, 0, numSamples, numChannels);
+}
+
+void LayerMixer::filterGroup(Group& group, int groupIndex, juce::AudioBuffer<float>& output,
+                             int startSample, int offset, int numSamples, int numChannels)
+{
+    const auto firstSlot = static_cast<size_t>(groupIndex * kLanes);
+
+    bool anyActive = false;
+    for (auto active : group.active)
+        anyActive = anyActive || active;
+
+    if (!anyActive)
+    {
+        // Nothing to filter; the panner reads scratch directly
+        if (group.spatialActive)
+            return;
+
+        for (int lane = 0; lane < kLanes; ++lane)
+        {
+            const auto& slot = slots[firstSlot + static_cast<size_t>(lane)];
+            if (slot.source == nullptr)
+                continue;
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                output.addFrom(ch, startSample + offset, slot.scratch, ch, offset, numSamples);
+        }
+
+        return;
+    }
+
+    alignas(Vec::SIMDRegisterSize) float lanes[Vec::SIMDNumElements];
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        std::array<float*, Vec::SIMDNumElements> inputs {};
+        for (int lane = 0; lane < kLanes; ++lane)
+        {
+            auto& slot = slots[firstSlot + static_cast<size_t>(lane)];
+            if (slot.source != nullptr)
+                inputs[static_cast<size_t>(lane)] = slot.scratch.getWritePointer(ch, offset);
+        }
+
+        auto* out = output.getWritePointer(ch, startSample + offset);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            for (int lane = 0; lane < kLanes; ++lane)
+            {
+                const auto* in = inputs[static_cast<size_t>(lane)];
+                lanes[lane] = in != nullptr ? in[i] : 0.0f;
+            }
+
+            auto x = Vec::fromRawArray(lanes);
+
+            for (int s = 0; s < numStages; ++s)
+            {
+                if (!group.active[static_cast<size_t>(s)])
+                    continue;
+
+                const auto& c = group.coeffs[static_cast<size_t>(s)];
+                auto& ic1 = group.state1[static_cast<size_t>(s)][static_cast<size_t>(ch)];
+                auto& ic2 = group.state2[static_cast<size_t>(s)][static_cast<size_t>(ch)];
+
+                const auto v3 = x - ic2;
+                const auto v1 = ic1 * c.a1 + v3 * c.a2;
+                const auto v2 = ic2 + ic1 * c.a2 + v3 * c.a3;
+                ic1 = v1 * Vec::expand(2.0f) - ic1;
+                ic2 = v2 * Vec::expand(2.0f) - ic2;
+
+                x = x * c.m0 + v1 * c.m1 + v2 * c.m2;
+            }
+
+            // Every lane is a different layer, so the mix is the lane sum
+            if (!group.spatialActive)
+                out[i] += x.sum();
+
+            // Filtered layers go back into scratch for their analysis taps
+            x.copyToRawArray(lanes);
+            for (int lane = 0; lane < kLanes; ++lane)
+                if (auto* in = inputs[static_cast<size_t>(lane)])
+                    in[i] = lanes[lane];
+        }
+    }
+}
+
+void LayerMixer::updateSpatial(Group& group, int groupIndex, int numSamples, int numChannels)
+{
+    const auto firstSlot = static_cast<size_t>(groupIndex * kLanes);
+
+    alignas(Vec::SIMDRegisterSize) float targets[numMatrixTerms][Vec::SIMDNumElements] {};
+    alignas(Vec::SIMDRegisterSize) float airs[Vec::SIMDNumElements] {};
+    alignas(Vec::SIMDRegisterSize) float current[Vec::SIMDNumElements] {};
+
+    bool needed = false;
+
+    for (int lane = 0; lane < kLanes; ++lane)
+    {
+        auto& slot = slots[firstSlot + static_cast<size_t>(lane)];
+        std::array<float, numSpaceSettings> space { 0.0f, 1.0f, 1.0f };
+
+        if (slot.source != nullptr)
+        {
+            for (int s = 0; s < numSpaceSettings; ++s)
+            {
+                auto& setting = slot.space[static_cast<size_t>(s)];
+                needed = needed || setting.isSmoothing();
+                space[static_cast<size_t>(s)] = setting.skip(numSamples);
+            }
+        }
+
+        std::array<float, numMatrixTerms> matrix {};
+        spaceTargets(space, currentSampleRate, matrix, airs[lane]);
+
+        for (int t = 0; t < numMatrixTerms; ++t)
+            targets[t][lane] = matrix[static_cast<size_t>(t)];
+    }
+
+    // Needed while any lane is away from the identity or still ramping back
+    auto isIdentity = [](const float* values, float expected)
+    {
+        for (int lane = 0; lane < kLanes; ++lane)
+            if (std::abs(values[lane] - expected) > 1.0e-6f)
+                return false;
+        return true;
+    };
+
+    for (int t = 0; t < numMatrixTerms && !needed; ++t)
+    {
+        const float expected = (t == leftToLeft || t == rightToRight) ? 1.0f : 0.0f;
+        group.matrix[static_cast<size_t>(t)].copyToRawArray(current);
+        needed = !isIdentity(targets[t], expected) || !isIdentity(current, expected);
+    }
+
+    group.air.copyToRawArray(current);
+    needed = needed || !isIdentity(airs, 1.0f) || !isIdentity(current, 1.0f);
+
+    // Stereo only; other layouts keep the plain sum
+    needed = needed && numChannels == 2;
+
+    if (needed && !group.spatialActive)
+        group.airState.fill(Vec::expand(0.0f));
+
+    group.spatialActive = needed;
+
+    for (int t = 0; t < numMatrixTerms; ++t)
+        group.matrixTarget[static_cast<size_t>(t)] = Vec::fromRawArray(targets[t]);
+    group.airTarget = Vec::fromRawArray(airs);
+
+    if (!needed)
+    {
+        group.matrix = group.matrixTarget;
+        group.air = group.airTarget;
+    }
+}
+
+void LayerMixer::panGroup(Group& group, int groupIndex, juce::AudioBuffer<float>& output, int startSample, int numSamples)
+{
+    const auto firstSlot = static_cast<size_t>(groupIndex * kLanes);
+
+    std::array<const float*, Vec::SIMDNumElements> inLeft {};
+    std::array<const float*, Vec::SIMDNumElements> inRight {};
+    for (int lane = 0; lane < kLanes; ++lane)
+    {
+        const auto& slot = slots[firstSlot + static_cast<size_t>(lane)];
+        if (slot.source != nullptr)
+        {
+            inLeft[static_cast<size_t>(lane)] = slot.scratch.getReadPointer(0);
+            inRight[static_cast<size_t>(lane)] = slot.scratch.getReadPointer(1);
+        }
+    }
+
+    // Ramp from last block's matrix to this one's across the chunk
+    const auto perSample = Vec::expand(1.0f / static_cast<float>(numSamples));
+    std::array<Vec, numMatrixTerms> m = group.matrix;
+    std::array<Vec, numMatrixTerms> step;
+    for (int t = 0; t < numMatrixTerms; ++t)
+        step[static_cast<size_t>(t)] = (group.matrixTarget[static_cast<size_t>(t)] - m[static_cast<size_t>(t)]) * perSample;
+
+    auto air = group.air;
+    const auto airStep = (group.airTarget - air) * perSample;
+    auto stateLeft = group.airState[0];
+    auto stateRight = group.airState[1];
+
+    auto* outLeft = output.getWritePointer(0, startSample);
+    auto* outRight = output.getWritePointer(1, startSample);
+
+    alignas(Vec::SIMDRegisterSize) float lanesLeft[Vec::SIMDNumElements];
+    alignas(Vec::SIMDRegisterSize) float lanesRight[Vec::SIMDNumElements];
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        for (int lane = 0; lane < kLanes; ++lane)
+        {
+            const auto* l = inLeft[static_cast<size_t>(lane)];
+            const auto* r = inRight[static_cast<size_t>(lane)];
+            lanesLeft[lane] = l != nullptr ? l[i] : 0.0f;
+            lanesRight[lane] = r != nullptr ? r[i] : 0.0f;
+        }
+
+        for (int t = 0; t < numMatrixTerms; ++t)
+            m[static_cast<size_t>(t)] = m[static_cast<size_t>(t)] + step[static_cast<size_t>(t)];
+        air = air + airStep;
+
+        stateLeft = stateLeft + (Vec::fromRawArray(lanesLeft) - stateLeft) * air;
+        stateRight = stateRight + (Vec::fromRawArray(lanesRight) - stateRight) * air;
+
+        outLeft[i] += (stateLeft * m[leftToLeft] + stateRight * m[rightToLeft]).sum();
+        outRight[i] += (stateLeft * m[leftToRight] + stateRight * m[rightToRight]).sum();
+    }
+
+    group.matrix = group.matrixTarget;
+    group.air = group.airTarget;
+    group.airState[0] = stateLeft;
+    group.airState[1] = stateRight;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include "AnalysisTap.h"
+
+// Per-layer tone and position settings as stored in presets
+struct LayerTone
+{
+    float highPassHz = 20.0f;
+    float lowPassHz = 20000.0f;
+    float tiltDb = 0.0f;
+    float azimuthDegrees = 0.0f;    // -90 hard left .. 90 hard right
+    float distanceMetres = 1.0f;    // 1 m is as recorded
+    float width = 1.0f;             // 0 folds the layer to mono, 1 keeps its image
+};
+
+// Sums the layers and runs each one's HPF / tilt / LPF and panner on the way in.
+//
+// Layers are assigned fixed lanes, and every filter state and coefficient is
+// stored structure-of-arrays by lane group, so one SIMDRegister tick filters
+// 4 or 8 layers at once and the lanes are summed straight into the output.
+// Stages that are flat for every layer in a group are skipped, and a mix
+// with no filtering at all is a plain sum.
+//
+// Position is rendered the same way: once per block each lane's azimuth,
+// width and distance become a 2x2 gain matrix and an air-absorption
+// low-pass, which are ramped across the block and applied to the whole
+// group in one pass.  Groups where every layer sits at the default
+// position skip it.
+class LayerMixer : public juce::AudioSource
+{
+public:
+    // Written by the layer's controls, read by the mixer once per block
+    struct ToneControl
+    {
+        std::atomic<float> highPassHz { 20.0f };
+        std::atomic<float> lowPassHz  { 20000.0f };
+        std::atomic<float> tiltDb     { 0.0f };
+        std::atomic<float> azimuthDegrees { 0.0f };
+        std::atomic<float> distanceMetres { 1.0f };
+        std::atomic<float> width          { 1.0f };
+
+        void set(const LayerTone& tone);
+        LayerTone get() const;
+    };
+
+    LayerMixer() = default;
+    ~LayerMixer() override;
+
+    // The tap, if any, receives the layer's audio after its filters
+    void addInputSource(juce::AudioSource* input, const ToneControl* tone, AnalysisTap* tap = nullptr);
+    void removeInputSource(juce::AudioSource* input);
+    void removeAllInputs();
+
+    // Quality settings the governor steps through, picked up once per block.
+    // Culling leaves out lane groups whose layers are all below kCullLevel;
+    // they are still pulled, so they stay in time.
+    void setLayerMetersEnabled(bool shouldMeter) { layerMeters.store(shouldMeter); }
+    void setLayerFiltersEnabled(bool shouldFilter) { layerFilters.store(shouldFilter); }
+    void setCullQuietLayers(bool shouldCull) { cullQuietLayers.store(shouldCull); }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static constexpr float kMinHighPassHz = 20.0f;
+    static constexpr float kMaxLowPassHz  = 20000.0f;
+    static constexpr float kMaxTiltDb     = 12.0f;
+    static constexpr float kMaxAzimuthDegrees = 90.0f;
+    static constexpr float kMaxDistanceMetres = 100.0f;
+    static constexpr float kCullLevel = 0.001f;    // -60 dBFS
+
+private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    enum StageIndex { highPass = 0, tilt, lowPass, numStages };
+    enum SpaceIndex { azimuth = 0, distance, width, numSpaceSettings };
+    enum MatrixTerm { leftToLeft = 0, rightToLeft, leftToRight, rightToRight, numMatrixTerms };
+
+    static constexpr int kLanes = static_cast<int>(Vec::SIMDNumElements);
+    static constexpr int kMaxChannels = 8;
+
+    struct Coefficients
+    {
+        Vec a1, a2, a3;
+        Vec m0, m1, m2;
+    };
+
+    struct Slot
+    {
+        juce::AudioSource* source = nullptr;
+        const ToneControl* tone = nullptr;
+        AnalysisTap* tap = nullptr;
+        std::array<juce::SmoothedValue<float>, numStages> setting;
+        std::array<float, numStages> coeffsFor {};
+        std::array<juce::SmoothedValue<float>, numSpaceSettings> space;
+        juce::AudioBuffer<float> scratch;
+    };
+
+    struct Group
+    {
+        std::array<Coefficients, numStages> coeffs;
+        std::array<std::array<Vec, kMaxChannels>, numStages> state1;
+        std::array<std::array<Vec, kMaxChannels>, numStages> state2;
+        std::array<bool, numStages> active {};
+
+        // Panner: the matrix and air coefficient reached at the end of the
+        // last block, and the air filter's state per input channel
+        std::array<Vec, numMatrixTerms> matrix, matrixTarget;
+        Vec air, airTarget;
+        std::array<Vec, 2> airState;
+        bool spatialActive = false;
+
+        int numSources = 0;
+        bool culled = false;
+
+        Group();
+        void clearLane(int lane);
+    };
+
+    void initialiseSlot(int slotIndex);
+    void updateLane(int slotIndex, int stageIndex, float setting);
+    static bool isFlat(int stageIndex, float setting);
+    static float toSetting(int stageIndex, const LayerTone& tone);
+    void renderChunk(juce::AudioBuffer<float>& output, int startSample, int numSamples);
+    void filterGroup(Group& group, int groupIndex, juce::AudioBuffer<float>& output,
+                     int startSample, int offset, int numSamples, int numChannels);
+    static void spaceTargets(const std::array<float, numSpaceSettings>& space, double sampleRate,
+                             std::array<float, numMatrixTerms>& matrix, float& air);
+    void updateSpatial(Group& group, int groupIndex, int numSamples, int numChannels);
+    void panGroup(Group& group, int groupIndex, juce::AudioBuffer<float>& output, int startSample, int numSamples);
+
+    juce::CriticalSection lock;
+
+    std::vector<Slot> slots;
+    std::vector<Group> groups;
+
+    double currentSampleRate = 0.0;
+    int scratchSize = 512;
+    bool prepared = false;
+
+    std::atomic<bool> layerMeters { true };
+    std::atomic<bool> layerFilters { true };
+    std::atomic<bool> cullQuietLayers { false };
+
+    static constexpr double kSmoothingSeconds = 0.05;
+    static constexpr int kSmoothingStep = 32;
+    static constexpr float kTiltPivotHz = 1000.0f;
+
+    // Air absorption cutoff is this over the distance beyond 1 m, so it opens
+    // fully at 1 m and reaches about 1 kHz at 100 m
+    static constexpr float kAirHzMetres = 100000.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LayerMixer)
+};
@@ -0,0 +1,66 @@
+#include "LevelMeter.h"
+
+LevelMeter::LevelMeter(const AnalysisTap& analysisTap)
+    : tap(analysisTap)
+{
+    setInterceptsMouseClicks(false, false);
+    startTimerHz(30);
+}
+
+LevelMeter::~LevelMeter()
+{
+    stopTimer();
+}
+
+void LevelMeter::setAnimating(bool shouldAnimate)
+{
+    if (shouldAnimate == isTimerRunning())
+        return;
+
+    if (shouldAnimate)
+        startTimerHz(30);
+    else
+        stopTimer();
+}
+
+float LevelMeter::dbToY(float db, float height) const
+{
+    const float proportion = (juce::jlimit(kMinDb, kMaxDb, db) - kMinDb) / (kMaxDb - kMinDb);
+    return height * (1.0f - proportion);
+}
+
+void LevelMeter::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colour(0xff181825));
+
+    const int numChannels = juce::jmax(1, snapshot.numChannels);
+    const auto bounds = getLocalBounds().toFloat().reduced(1.0f);
+    const float barWidth = bounds.getWidth() / static_cast<float>(numChannels);
+    const float height = bounds.getHeight();
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto c = static_cast<size_t>(ch);
+        const auto bar = juce::Rectangle<float>(bounds.getX() + barWidth * static_cast<float>(ch), bounds.getY(),
+                                                barWidth, height).reduced(1.0f, 0.0f);
+
+        const float rmsY = dbToY(snapshot.rmsDb[c], height);
+        g.setColour(juce::Colour(0xff94e2d5));
+        g.fillRect(bar.withTop(bar.getY() + rmsY));
+
+        const float peakDb = snapshot.peakDb[c];
+        const float peakY = dbToY(peakDb, height);
+        g.setColour(peakDb > 0.0f ? juce::Colour(0xfff38ba8) : juce::Colour(0xfff9e2af));
+        g.fillRect(bar.getX(), bar.getY() + peakY, bar.getWidth(), 2.0f);
+    }
+
+    // 0 dBFS mark
+    g.setColour(juce::Colours::white.withAlpha(0.3f));
+    g.fillRect(bounds.getX(), bounds.getY() + dbToY(0.0f, height), bounds.getWidth(), 1.0f);
+}
+
+void LevelMeter::timerCallback()
+{
+    snapshot = tap.getSnapshot();
+    repaint();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisTap.h"
+
+// Vertical peak / RMS bars for one AnalysisTap, one bar per channel
+class LevelMeter : public juce::Component, private juce::Timer
+{
+public:
+    explicit LevelMeter(const AnalysisTap& tap);
+    ~LevelMeter() override;
+
+    // Stops the refresh timer while nobody can see the display
+    void setAnimating(bool shouldAnimate);
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void timerCallback() override;
+    float dbToY(float db, float height) const;
+
+    const AnalysisTap& tap;
+    AnalysisTap::Snapshot snapshot;
+
+    static constexpr float kMinDb = -60.0f;
+    static constexpr float kMaxDb = 6.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LevelMeter)
+};
@@ -0,0 +1,260 @@
+#include "LoopPointFinder.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+
+LoopPointFinder::LoopPointFinder(juce::AudioFormatManager& fm)
+    : formatManager(fm)
+{
+}
+
+LoopPointFinder::~LoopPointFinder()
+{
+    pool.removeAllJobs(true, 5000);
+}
+
+void LoopPointFinder::findLoopEnd(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                                  std::function<void(const Suggestion&)> onResult)
+{
+    juce::WeakReference<LoopPointFinder> weakThis(this);
+
+    pool.addJob([this, weakThis, file, loopStart, loopEnd, onResult]
+    {
+        Suggestion suggestion;
+        if (!runSearch(file, loopStart, loopEnd, suggestion))
+            return;
+
+        juce::MessageManager::callAsync([weakThis, suggestion, onResult]
+        {
+            if (weakThis.get() != nullptr)
+                onResult(suggestion);
+        });
+    });
+}
+
+std::vector<float> LoopPointFinder::readMono(juce::AudioFormatReader& reader, juce::int64 start, int numSamples)
+{
+    const int numChannels = juce::jmax(1, static_cast<int>(reader.numChannels));
+    juce::AudioBuffer<float> buffer(numChannels, numSamples);
+    reader.read(&buffer, 0, numSamples, start, true, true);
+
+    std::vector<float> mono(static_cast<size_t>(numSamples), 0.0f);
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* src = buffer.getReadPointer(ch);
+        for (int i = 0; i < numSamples; ++i)
+            mono[static_cast<size_t>(i)] += src[i];
+    }
+
+    const float scale = 1.0f / static_cast<float>(numChannels);
+    for (auto& sample : mono)
+        sample *= scale;
+
+    return mono;
+}
+
+std::vector<float> LoopPointFinder::crossCorrelate(const std::vector<float>& region, const float* pattern, int patternLength)
+{
+    // Linear (not circular) correlation needs room for both signals
+    const int regionLength = static_cast<int>(region.size());
+    const int size = juce::nextPowerOfTwo(regionLength + patternLength);
+    const int order = juce::roundToInt(std::log2(static_cast<double>(size)));
+
+    juce::dsp::FFT fft(order);
+    std::vector<std::complex<float>> a(static_cast<size_t>(size)), b(static_cast<size_t>(size));
+
+    std::copy(region.begin(), region.end(), reinterpret_cast<float*>(a.data()));
+    std::copy(pattern, pattern + patternLength, reinterpret_cast<float*>(b.data()));
+
+    fft.performRealOnlyForwardTransform(reinterpret_cast<float*>(a.data()));
+    fft.performRealOnlyForwardTransform(reinterpret_cast<float*>(b.data()));
+
+    for (size_t i = 0; i < a.size(); ++i)
+        a[i] *= std::conj(b[i]);
+
+    fft.performRealOnlyInverseTransform(reinterpret_cast<float*>(a.data()));
+
+    // Raw products at every lag where the pattern fits inside the region
+    const auto* raw = reinterpret_cast<const float*>(a.data());
+    return std::vector<float>(raw, raw + (regionLength - patternLength + 1));
+}
+
+float LoopPointFinder::correlation(const float* a, const float* b, int numSamples)
+{
+    double ab = 0.0, aa = 0.0, bb = 0.0;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        ab += static_cast<double>(a[i]) * b[i];
+        aa += static_cast<double>(a[i]) * a[i];
+        bb += static_cast<double>(b[i]) * b[i];
+    }
+
+    return aa > 0.0 && bb > 0.0 ? static_cast<float>(ab / std::sqrt(aa * bb)) : 0.0f;
+}
+
+float LoopPointFinder::spectralSimilarity(const float* before, const float* after)
+{
+    // One minus the normalised spectral flux from the frame that leads into
+    // the splice to the frame that follows it
+    juce::dsp::FFT fft(kSpectralOrder);
+    juce::dsp::WindowingFunction<float> window(static_cast<size_t>(kSpectralFrame),
+                                               juce::dsp::WindowingFunction<float>::hann, false);
+
+    std::vector<float> x(static_cast<size_t>(2 * kSpectralFrame), 0.0f);
+    std::vector<float> y(static_cast<size_t>(2 * kSpectralFrame), 0.0f);
+
+    std::copy(before, before + kSpectralFrame, x.begin());
+    std::copy(after, after + kSpectralFrame, y.begin());
+    window.multiplyWithWindowingTable(x.data(), static_cast<size_t>(kSpectralFrame));
+    window.multiplyWithWindowingTable(y.data(), static_cast<size_t>(kSpectralFrame));
+    fft.performFrequencyOnlyForwardTransform(x.data());
+    fft.performFrequencyOnlyForwardTransform(y.data());
+
+    double difference = 0.0, total = 0.0;
+    for (int bin = 0; bin <= kSpectralFrame / 2; ++bin)
+    {
+        difference += std::abs(x[static_cast<size_t>(bin)] - y[static_cast<size_t>(bin)]);
+        total += x[static_cast<size_t>(bin)] + y[static_cast<size_t>(bin)];
+    }
+
+    return total > 0.0 ? static_cast<float>(1.0 - difference / total) : 1.0f;
+}
+
+bool LoopPointFinder::runSearch(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd, Suggestion& result)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0)
+        return false;
+
+    const auto length = reader->lengthInSamples;
+    const double sampleRate = reader->sampleRate;
+    const int templateLength = juce::roundToInt(kTemplateSeconds * sampleRate);
+    const int radius = juce::roundToInt(kSearchSeconds * sampleRate);
+    const int maxCrossfade = juce::roundToInt(kMaxCrossfadeSeconds * sampleRate);
+    const int tailLength = juce::jmax(templateLength, maxCrossfade);
+
+    loopEnd = juce::jlimit(static_cast<juce::int64>(1), length, loopEnd < 0 ? length : loopEnd);
+    loopStart = juce::jlimit(static_cast<juce::int64>(0), loopEnd - 1, loopStart);
+
+    // A candidate P is a point where x[P + n] carries on like x[loopStart + n]
+    const auto firstCandidate = juce::jmax(loopEnd - radius,
+                                           loopStart + 2 * static_cast<juce::int64>(templateLength),
+                                           static_cast<juce::int64>(kSpectralFrame));
+    const auto lastCandidate = juce::jmin(loopEnd + radius, length - templateLength);
+    if (lastCandidate <= firstCandidate)
+        return false;
+
+    const auto head = readMono(*reader, loopStart, tailLength);
+
+    // The region starts a spectral frame early so every candidate has the
+    // audio that leads into it, and runs long enough to test every crossfade
+    const auto regionStart = firstCandidate - kSpectralFrame;
+    const int numCandidates = static_cast<int>(lastCandidate - firstCandidate) + 1;
+    const auto region = readMono(*reader, regionStart, kSpectralFrame + numCandidates + tailLength);
+
+    const auto raw = crossCorrelate(region, head.data(), templateLength);
+
+    // Normalise by the energy under the pattern at each lag
+    std::vector<double> energy(region.size() + 1, 0.0);
+    for (size_t i = 0; i < region.size(); ++i)
+        energy[i + 1] = energy[i] + static_cast<double>(region[i]) * region[i];
+
+    double headEnergy = 0.0;
+    for (int i = 0; i < templateLength; ++i)
+        headEnergy += static_cast<double>(head[static_cast<size_t>(i)]) * head[static_cast<size_t>(i)];
+
+    if (headEnergy <= 0.0)
+        return false;
+
+    auto normalised = [&](int offset)
+    {
+        const auto lag = static_cast<size_t>(kSpectralFrame + offset);
+        const double windowEnergy = energy[lag + static_cast<size_t>(templateLength)] - energy[lag];
+        return windowEnergy > 0.0 ? static_cast<float>(raw[lag] / std::sqrt(headEnergy * windowEnergy)) : 0.0f;
+    };
+
+    // Keep the strongest local maxima as candidates
+    std::vector<Candidate> candidates;
+    float previous = normalised(0), current = previous;
+
+    for (int offset = 0; offset < numCandidates; ++offset)
+    {
+        const float next = offset + 1 < numCandidates ? normalised(offset + 1) : -1.0f;
+
+        if (current >= previous && current >= next)
+        {
+            candidates.push_back({ offset, current });
+            std::sort(candidates.begin(), candidates.end(),
+                      [](const Candidate& a, const Candidate& b) { return a.score > b.score; });
+
+            if (static_cast<int>(candidates.size()) > kNumCandidates)
+                candidates.pop_back();
+        }
+
+        previous = current;
+        current = next;
+    }
+
+    if (candidates.empty())
+        return false;
+
+    // Rescore with the exact correlation and the spectral jump at the splice
+    Candidate best;
+    float bestSimilarity = 0.0f;
+    best.score = -2.0f;
+
+    for (const auto& candidate : candidates)
+    {
+        const auto* at = region.data() + kSpectralFrame + candidate.offset;
+        const float rho = correlation(at, head.data(), templateLength);
+        const float similarity = spectralSimilarity(at - kSpectralFrame, head.data());
+        const float score = 0.6f * rho + 0.4f * similarity;
+
+        if (score > best.score)
+        {
+            best = { candidate.offset, score };
+            bestSimilarity = similarity;
+        }
+    }
+
+    const auto splice = firstCandidate + best.offset;
+    const auto* tail = region.data() + kSpectralFrame + best.offset;
+
+    // The crossfade blends [P, P + X) with [loopStart, loopStart + X), so the
+    // shortest X whose two halves still agree is all the join needs
+    const int longestFit = static_cast<int>(juce::jmin(static_cast<juce::int64>(maxCrossfade),
+                                                       splice - loopStart, length - splice));
+    int crossfade = 0;
+    float rho = -1.0f;
+
+    for (const double ms : { 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0, 2000.0 })
+    {
+        const int candidateLength = juce::roundToInt(ms * 0.001 * sampleRate);
+        if (candidateLength > longestFit)
+            break;
+
+        crossfade = candidateLength;
+        rho = correlation(tail, head.data(), candidateLength);
+
+        if (rho >= kGoodMatch)
+            break;
+    }
+
+    // Nothing coherent to line up: blend slowly instead
+    if (rho < kGoodMatch)
+    {
+        const double seconds = rho >= kCorrelatedMatch ? 0.2 : 1.0;
+        crossfade = juce::jmin(longestFit, juce::roundToInt(seconds * sampleRate));
+        rho = crossfade > 0 ? correlation(tail, head.data(), crossfade) : rho;
+    }
+
+    result.loopEnd = splice + crossfade;
+    result.crossfadeSamples = crossfade;
+    result.curveX = 0.5f;
+    result.curveY = 0.5f;
+    result.equalPower = rho < kCorrelatedMatch;
+    result.correlation = rho;
+    result.spectralSimilarity = bestSimilarity;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <functional>
+#include <vector>
+
+// Searches near a loop's end handle for the point where the audio best
+// continues into the loop start, in the background.
+//
+// Only the audio around the two handles is read, so the cost depends on the
+// search window rather than the file length.  Candidates come from an FFT
+// cross-correlation of the head against the search region; the strongest
+// few are rescored with the spectral change across the splice, and the
+// winner's correlation picks the shortest crossfade that hides the join and
+// whether it should be equal gain or equal power.
+class LoopPointFinder
+{
+public:
+    struct Suggestion
+    {
+        juce::int64 loopEnd = 0;
+        int crossfadeSamples = 0;
+        float curveX = 0.5f;
+        float curveY = 0.5f;
+        bool equalPower = false;
+        float correlation = 0.0f;          // waveform match over the crossfade
+        float spectralSimilarity = 0.0f;   // 1 = no spectral jump at the splice
+    };
+
+    explicit LoopPointFinder(juce::AudioFormatManager& formatManager);
+    ~LoopPointFinder();
+
+    // Message thread.  The callback runs on the message thread, and only if
+    // a usable end point was found.
+    void findLoopEnd(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                     std::function<void(const Suggestion&)> onResult);
+
+private:
+    struct Candidate
+    {
+        int offset = 0;
+        float score = 0.0f;
+    };
+
+    bool runSearch(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd, Suggestion& result);
+    static std::vector<float> readMono(juce::AudioFormatReader& reader, juce::int64 start, int numSamples);
+    static std::vector<float> crossCorrelate(const std::vector<float>& region, const float* pattern, int patternLength);
+    static float correlation(const float* a, const float* b, int numSamples);
+    static float spectralSimilarity(const float* before, const float* after);
+
+    juce::AudioFormatManager& formatManager;
+    juce::ThreadPool pool { 1 };
+
+    static constexpr double kTemplateSeconds = 0.1;
+    static constexpr double kSearchSeconds = 1.0;
+    static constexpr double kMaxCrossfadeSeconds = 2.0;
+    static constexpr int kSpectralOrder = 11;
+    static constexpr int kSpectralFrame = 1 << kSpectralOrder;
+    static constexpr int kNumCandidates = 8;
+    static constexpr float kGoodMatch = 0.9f;
+    static constexpr float kCorrelatedMatch = 0.5f;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(LoopPointFinder)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoopPointFinder)
+};
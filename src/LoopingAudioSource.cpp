@@ -1,9 +1,11 @@
 #include "LoopingAudioSource.h"
+#include "StreamingAudioSource.h"
 #include <limits>
 #include <cmath>
 
 LoopingAudioSource::LoopingAudioSource(juce::PositionableAudioSource* src, bool deleteWhenRemoved)
-    : source(src, deleteWhenRemoved)
+    : source(src, deleteWhenRemoved),
+      streamingSource(dynamic_cast<StreamingAudioSource*>(src))
 {
 }
 
@@ -12,8 +14,10 @@ LoopingAudioSource::~LoopingAudioSource() = default;
 void LoopingAudioSource::setLoopRange(juce::int64 startSample, juce::int64 endSample)
 {
     jassert(startSample >= 0 && endSample > startSample);
-    loopStart.store(startSample);
-    loopEnd.store(endSample);
+    params.modify([&](Parameters& p) {
+        p.loopStart = startSample;
+        p.loopEnd = endSample;
+    });
 }
 
 void LoopingAudioSource::setLooping(bool shouldLoop)
@@ -23,13 +27,43 @@ void LoopingAudioSource::setLooping(bool shouldLoop)
 
 void LoopingAudioSource::setCrossfadeSamples(int samples)
 {
-    crossfadeSamples.store(juce::jmax(0, samples));
+    params.modify([&](Parameters& p) { p.crossfadeSamples = juce::jmax(0, samples); });
 }
 
 void LoopingAudioSource::setCrossfadeCurve(float cx, float cy)
 {
-    curveX.store(juce::jlimit(0.05f, 0.95f, cx));
-    curveY.store(juce::jlimit(0.05f, 0.95f, cy));
+    params.modify([&](Parameters& p) {
+        p.curveX = juce::jlimit(0.05f, 0.95f, cx);
+        p.curveY = juce::jlimit(0.05f, 0.95f, cy);
+    });
+}
+
+void LoopingAudioSource::setCrossfadeEqualPower(bool shouldUseEqualPower)
+{
+    params.modify([&](Parameters& p) { p.equalPower = shouldUseEqualPower; });
+}
+
+void LoopingAudioSource::setPlaylist(const Playlist& newPlaylist)
+{
+    // Keep only usable segments, in order
+    Playlist cleaned;
+    cleaned.randomOrder = newPlaylist.randomOrder;
+    cleaned.primaryWeight = juce::jmax(0.0f, newPlaylist.primaryWeight);
+
+    const auto length = source->getTotalLength();
+
+    for (int i = 0; i < juce::jmin(newPlaylist.numSegments, kMaxSegments); ++i)
+    {
+        auto segment = newPlaylist.segments[static_cast<size_t>(i)];
+        segment.end = juce::jmin(segment.end, length);
+        if (segment.start < 0 || segment.end <= segment.start)
+            continue;
+
+        segment.weight = juce::jmax(0.0f, segment.weight);
+        cleaned.segments[static_cast<size_t>(cleaned.numSegments++)] = segment;
+    }
+
+    playlist.write(cleaned);
 }
 
 float LoopingAudioSource::solveBezierT(float cx, float x)
@@ -48,124 +82,287 @@ float LoopingAudioSource::evalBezierY(float cy, float t)
     return 2.0f * (1.0f - t) * t * cy + t * t;
 }
 
-void LoopingAudioSource::rebuildLUT()
+void LoopingAudioSource::rebuildLUT(float cx, float cy, bool equalPower)
 {
-    const float cx = curveX.load();
-    const float cy = curveY.load();
-
     for (int i = 0; i <= kLUTSize; ++i)
     {
         const float x = static_cast<float>(i) / static_cast<float>(kLUTSize);
-        const float t = solveBezierT(cx, x);
-        fadeLUT[i] = evalBezierY(cy, t);
+        const float y = evalBezierY(cy, solveBezierT(cx, x));
+
+        if (equalPower)
+        {
+            fadeInLUT[i] = std::sin(y * juce::MathConstants<float>::halfPi);
+            fadeOutLUT[i] = std::cos(y * juce::MathConstants<float>::halfPi);
+        }
+        else
+        {
+            fadeInLUT[i] = y;
+            fadeOutLUT[i] = 1.0f - y;
+        }
     }
 
     cachedCurveX = cx;
     cachedCurveY = cy;
+    cachedEqualPower = equalPower;
 }
 
 void LoopingAudioSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
 {
     source->prepareToPlay(samplesPerBlockExpected, sampleRate);
-    headCache.setSize(2, samplesPerBlockExpected);
-    headCacheLength = 0;
-    cachedLoopStart = -1;
-    cachedXfade = -1;
+    headScratch.setSize(2, juce::jmax(1, samplesPerBlockExpected));
+
+    declickBuffer.setSize(2, kDeclickSamples);
+    declickRemaining = 0;
+    hasRendered = false;
+    fadingSpan = {};
 }
 
 void LoopingAudioSource::releaseResources()
 {
     source->releaseResources();
-    headCache.setSize(0, 0);
-    headCacheLength = 0;
-    cachedLoopStart = -1;
-    cachedXfade = -1;
+    headScratch.setSize(0, 0);
+
+    declickBuffer.setSize(0, 0);
+    declickRemaining = 0;
 }
 
-void LoopingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+bool LoopingAudioSource::refreshParameters()
 {
-    auto pos = nextPlayPos.load();
+    Parameters latest;
+    std::uint32_t version = 0;
 
-    if (!looping.load())
+    // A writer mid-publish just means we run one more block on the old snapshot
+    if (!params.tryRead(latest, version))
+        return false;
+
+    if (hasActive && version == activeVersion)
+        return false;
+
+    const bool wasActive = hasActive;
+    active = latest;
+    activeVersion = version;
+    hasActive = true;
+    return wasActive;
+}
+
+bool LoopingAudioSource::refreshPlaylist()
+{
+    Playlist latest;
+    std::uint32_t version = 0;
+
+    if (!playlist.tryRead(latest, version))
+        return false;
+
+    if (hasPlaylist && version == playlistVersion)
+        return false;
+
+    const bool wasActive = hasPlaylist;
+    activePlaylist = latest;
+    playlistVersion = version;
+    hasPlaylist = true;
+
+    if (currentSegment >= getNumSegments())
+        currentSegment = 0;
+
+    nextSegment = chooseNextSegment(currentSegment);
+    return wasActive;
+}
+
+LoopingAudioSource::Segment LoopingAudioSource::getSegment(int index) const
+{
+    if (index <= 0)
+        return { active.loopStart, active.loopEnd, activePlaylist.primaryWeight };
+
+    return activePlaylist.segments[static_cast<size_t>(index - 1)];
+}
+
+int LoopingAudioSource::chooseNextSegment(int after)
+{
+    const int total = getNumSegments();
+    if (total <= 1)
+        return 0;
+
+    if (!activePlaylist.randomOrder)
+        return (after + 1) % total;
+
+    // Weighted pick over every other segment; Random never allocates
+    float sum = 0.0f;
+    for (int i = 0; i < total; ++i)
+        if (i != after)
+            sum += getSegment(i).weight;
+
+    if (sum <= 0.0f)
+        return (after + 1) % total;
+
+    float r = random.nextFloat() * sum;
+    int chosen = after;
+
+    for (int i = 0; i < total; ++i)
     {
-        source->setNextReadPosition(pos);
-        source->getNextAudioBlock(bufferToFill);
-        nextPlayPos.store(source->getNextReadPosition());
-        return;
+        if (i == after || getSegment(i).weight <= 0.0f)
+            continue;
+
+        chosen = i;
+        r -= getSegment(i).weight;
+        if (r < 0.0f)
+            break;
     }
 
-    const auto lStart = loopStart.load();
-    const auto lEnd   = loopEnd.load();
+    return chosen;
+}
 
-    if (lEnd <= lStart || lEnd <= 0)
+void LoopingAudioSource::advanceSegment()
+{
+    currentSegment = nextSegment;
+    nextSegment = chooseNextSegment(currentSegment);
+}
+
+void LoopingAudioSource::jumpToSegmentContaining(juce::int64 position)
+{
+    for (int i = 0; i < getNumSegments(); ++i)
     {
-        source->setNextReadPosition(pos);
-        source->getNextAudioBlock(bufferToFill);
-        nextPlayPos.store(source->getNextReadPosition());
+        const auto segment = getSegment(i);
+        if (position >= segment.start && position < segment.end)
+        {
+            if (i != currentSegment)
+            {
+                currentSegment = i;
+                nextSegment = chooseNextSegment(i);
+            }
+
+            return;
+        }
+    }
+}
+
+LoopingAudioSource::Span LoopingAudioSource::getCurrentSpan() const
+{
+    const auto current = getSegment(currentSegment);
+    const auto next = getSegment(nextSegment);
+
+    // The crossfade has to fit in half of both the segment it leaves and the
+    // one it enters.  Loops can be longer than an int, so the clamp happens
+    // in 64 bits before narrowing.
+    const auto limit = juce::jmin(current.end - current.start, next.end - next.start) / 2;
+
+    Span span;
+    span.start = current.start;
+    span.end = current.end;
+    span.nextStart = next.start;
+    span.xfade = static_cast<int>(juce::jmin(static_cast<juce::int64>(active.crossfadeSamples), limit));
+    return span;
+}
+
+void LoopingAudioSource::readHead(StreamingAudioSource* streamedHead, juce::int64 position, int numSamples)
+{
+    if (auto* stream = streamedHead != nullptr ? streamedHead : streamingSource)
+    {
+        stream->read(headScratch, 0, numSamples, position);
         return;
     }
 
+    juce::AudioSourceChannelInfo chunk(&headScratch, 0, numSamples);
+    source->setNextReadPosition(position);
+    source->getNextAudioBlock(chunk);
+}
+
+juce::int64 LoopingAudioSource::wrapIntoLoop(juce::int64 pos, juce::int64 lStart, juce::int64 lEnd, int xfade)
+{
     const auto loopLen = lEnd - lStart;
 
-    // Clamp crossfade to at most half the loop length
-    const int xfade = juce::jmin(crossfadeSamples.load(), static_cast<int>(loopLen / 2));
-    const auto xfadeStart = lEnd - static_cast<juce::int64>(xfade);
+    if (pos >= lStart && pos < lEnd)
+        return pos;
 
-    // Rebuild fade LUT when curve parameters change
-    const float cx = curveX.load();
-    const float cy = curveY.load();
-    if (std::abs(cx - cachedCurveX) > 1e-7f || std::abs(cy - cachedCurveY) > 1e-7f)
-        rebuildLUT();
-
-    // Pre-cache the head region [lStart, lStart+xfade) when parameters change.
-    // This avoids seeking the source back and forth during crossfade.
-    if (xfade > 0 && (cachedLoopStart != lStart || cachedXfade != xfade))
+    // When crossfading, each loop iteration after the first skips the head
+    // region [lStart, lStart+xfade) since it was already blended in during
+    // the previous crossfade.  The effective loop length is loopLen - xfade.
+    if (xfade > 0 && pos >= lEnd)
+    {
+        const auto effectiveLen = loopLen - static_cast<juce::int64>(xfade);
+        const auto offset = (pos - lEnd) % effectiveLen;
+        return lStart + static_cast<juce::int64>(xfade) + offset;
+    }
+
+    const auto wrapped = lStart + ((pos - lStart) % loopLen);
+    return wrapped < lStart ? lStart : wrapped;
+}
+
+void LoopingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    auto pos = hasRendered ? renderPos : nextPlayPos.load();
+    const bool paramsChanged = refreshParameters();
+    const bool playlistChanged = refreshPlaylist();
+
+    // A seek jumps straight to its target and ramps out of where we were
+    const auto seekTarget = pendingSeek.exchange(-1);
+    if (seekTarget >= 0)
     {
-        if (headCache.getNumSamples() < xfade)
-            headCache.setSize(2, xfade, false, false, true);
-        headCache.clear(0, xfade);
+        if (hasRendered && seekTarget != pos)
+            startDeclick(pos);
 
-        juce::AudioSourceChannelInfo cacheChunk(&headCache, 0, xfade);
-        source->setNextReadPosition(lStart);
-        source->getNextAudioBlock(cacheChunk);
+        pos = seekTarget;
+        jumpToSegmentContaining(pos);
+        fadingSpan = {};
+    }
+
+    if (!looping.load())
+    {
+        fadingSpan = {};
+        source->setNextReadPosition(pos);
+        source->getNextAudioBlock(bufferToFill);
+        mixDeclick(bufferToFill);
+        finishBlock(pos + bufferToFill.numSamples);
 
-        headCacheLength = xfade;
-        cachedLoopStart = lStart;
-        cachedXfade = xfade;
+        if (streamingSource != nullptr)
+            streamingSource->setPlaybackHint(renderPos, 0, 0, 0);
+        return;
     }
 
-    // Wrap position into loop range.
-    // When crossfading, each loop iteration after the first skips the head
-    // region [lStart, lStart+xfade) since it was already blended in during
-    // the previous crossfade.  The effective loop length is loopLen - xfade.
-    if (pos < lStart || pos >= lEnd)
+    auto span = getCurrentSpan();
+
+    // Finish a fade under way at the length it started with
+    if (fadingSpan.xfade > 0 && fadingSpan.start == span.start && fadingSpan.end == span.end
+        && fadingSpan.nextStart == span.nextStart && pos >= span.end - fadingSpan.xfade && pos < span.end)
+        span.xfade = fadingSpan.xfade;
+
+    if (span.end <= span.start || span.end <= 0)
     {
-        if (xfade > 0 && pos >= lEnd)
-        {
-            const auto effectiveLen = loopLen - static_cast<juce::int64>(xfade);
-            auto offset = (pos - lEnd) % effectiveLen;
-            pos = lStart + static_cast<juce::int64>(xfade) + offset;
-        }
-        else
-        {
-            pos = lStart + ((pos - lStart) % loopLen);
-            if (pos < lStart)
-                pos = lStart;
-        }
+        source->setNextReadPosition(pos);
+        source->getNextAudioBlock(bufferToFill);
+        mixDeclick(bufferToFill);
+        finishBlock(pos + bufferToFill.numSamples);
+        return;
     }
 
+    // Rebuild fade LUT when curve parameters change
+    if (std::abs(active.curveX - cachedCurveX) > 1e-7f || std::abs(active.curveY - cachedCurveY) > 1e-7f
+        || active.equalPower != cachedEqualPower)
+        rebuildLUT(active.curveX, active.curveY, active.equalPower);
+
+    auto* streamedHead = headStream.load();
+
+    // An edit that moves the loop away from the playhead relocates it; ramp
+    // out of the old read position instead of jumping.  Edits that leave the
+    // playhead inside the new loop keep playing without a discontinuity.
+    const auto wrapped = wrapIntoLoop(pos, span.start, span.end, span.xfade);
+    if ((paramsChanged || playlistChanged) && wrapped != pos && seekTarget < 0)
+        startDeclick(pos);
+    pos = wrapped;
+
     int samplesRemaining = bufferToFill.numSamples;
     int destOffset = bufferToFill.startSample;
     const int numChannels = bufferToFill.buffer->getNumChannels();
 
     while (samplesRemaining > 0)
     {
+        const auto xfade = span.xfade;
+        const auto xfadeStart = span.end - static_cast<juce::int64>(xfade);
+
         if (xfade == 0 || pos < xfadeStart)
         {
             // --- Normal zone: read directly from source ---
-            const auto boundary = (xfade > 0) ? xfadeStart : lEnd;
-            const auto samplesUntilBoundary = static_cast<int>(boundary - pos);
-            const auto samplesToRead = juce::jmin(samplesRemaining, samplesUntilBoundary);
+            const auto boundary = (xfade > 0) ? xfadeStart : span.end;
+            const auto samplesToRead = static_cast<int>(juce::jmin(static_cast<juce::int64>(samplesRemaining), boundary - pos));
 
             juce::AudioSourceChannelInfo chunk(bufferToFill.buffer, destOffset, samplesToRead);
             source->setNextReadPosition(pos);
@@ -175,29 +372,58 @@ void LoopingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& b
             destOffset += samplesToRead;
             samplesRemaining -= samplesToRead;
 
-            // If no crossfade, wrap at lEnd
-            if (xfade == 0 && pos >= lEnd)
-                pos = lStart;
+            // If no crossfade, cut straight to the next segment at its end
+            if (xfade == 0 && pos >= span.end)
+            {
+                pos = span.nextStart;
+                advanceSegment();
+                span = getCurrentSpan();
+            }
         }
         else
         {
-            // --- Crossfade zone: blend tail with cached head ---
-            const auto samplesUntilEnd = static_cast<int>(lEnd - pos);
-            const auto samplesToRead = juce::jmin(samplesRemaining, samplesUntilEnd);
+            // --- Crossfade zone: blend tail with the next segment's head ---
+            auto samplesToRead = static_cast<int>(juce::jmin(static_cast<juce::int64>(samplesRemaining), span.end - pos));
+            const auto posInXfade = static_cast<int>(pos - xfadeStart);
+
+            // Released: there is nowhere to read the head into
+            if (headScratch.getNumSamples() == 0)
+            {
+                bufferToFill.buffer->clear(destOffset, samplesRemaining);
+                break;
+            }
+
+            // The head is read alongside the tail, a scratch-full at a time,
+            // from pages the prefetcher brought in while the segment played.
+            // Nothing bigger than a block is read or allocated here, however
+            // long the crossfade.
+            samplesToRead = juce::jmin(samplesToRead, headScratch.getNumSamples());
+            readHead(streamedHead, span.nextStart + posInXfade, samplesToRead);
 
             // Read tail audio into output buffer
             juce::AudioSourceChannelInfo tailChunk(bufferToFill.buffer, destOffset, samplesToRead);
             source->setNextReadPosition(pos);
             source->getNextAudioBlock(tailChunk);
 
-            // Blend with pre-cached head audio using LUT
-            const auto posInXfade = static_cast<int>(pos - xfadeStart);
+            // Blend with the head audio using LUT
+            const bool linear = linearCrossfades.load();
 
             for (int ch = 0; ch < numChannels; ++ch)
             {
                 auto* dest = bufferToFill.buffer->getWritePointer(ch, destOffset);
-                const int cacheCh = juce::jmin(ch, headCache.getNumChannels() - 1);
-                const auto* head = headCache.getReadPointer(cacheCh, posInXfade);
+                const int headCh = juce::jmin(ch, headScratch.getNumChannels() - 1);
+                const auto* head = headScratch.getReadPointer(headCh);
+
+                if (linear)
+                {
+                    for (int i = 0; i < samplesToRead; ++i)
+                    {
+                        const float fadeIn = static_cast<float>(posInXfade + i) / static_cast<float>(xfade);
+                        dest[i] += (head[i] - dest[i]) * fadeIn;
+                    }
+
+                    continue;
+                }
 
                 for (int i = 0; i < samplesToRead; ++i)
                 {
@@ -205,8 +431,8 @@ void LoopingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& b
                     const float scaledIdx = progress * static_cast<float>(kLUTSize);
                     const int idx = juce::jmin(static_cast<int>(scaledIdx), kLUTSize - 1);
                     const float frac = scaledIdx - static_cast<float>(idx);
-                    const float fadeIn = fadeLUT[idx] + frac * (fadeLUT[idx + 1] - fadeLUT[idx]);
-                    const float fadeOut = 1.0f - fadeIn;
+                    const float fadeIn = fadeInLUT[idx] + frac * (fadeInLUT[idx + 1] - fadeInLUT[idx]);
+                    const float fadeOut = fadeOutLUT[idx] + frac * (fadeOutLUT[idx + 1] - fadeOutLUT[idx]);
                     dest[i] = dest[i] * fadeOut + head[i] * fadeIn;
                 }
             }
@@ -216,17 +442,100 @@ void LoopingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& b
             samplesRemaining -= samplesToRead;
 
             // Wrap: jump past the crossfade head region (already blended in)
-            if (pos >= lEnd)
-                pos = lStart + static_cast<juce::int64>(xfade);
+            if (pos >= span.end)
+            {
+                pos = span.nextStart + static_cast<juce::int64>(xfade);
+                advanceSegment();
+                span = getCurrentSpan();
+            }
+        }
+    }
+
+    mixDeclick(bufferToFill);
+    finishBlock(pos);
+
+    const bool fading = span.xfade > 0 && pos >= span.end - span.xfade && pos < span.end;
+    fadingSpan = fading ? span : Span {};
+
+    // Point the prefetcher at the next segment's head while this one plays
+    if (streamingSource != nullptr)
+        streamingSource->setPlaybackHint(pos, span.start, span.end, span.xfade,
+                                         span.nextStart != span.start ? span.nextStart : -1);
+
+    // The head reader only ever needs the stretch it is about to blend in
+    if (streamedHead != nullptr)
+    {
+        const auto xfadeStart = span.end - static_cast<juce::int64>(span.xfade);
+        const auto headPos = pos >= xfadeStart && pos < span.end ? span.nextStart + (pos - xfadeStart) : span.nextStart;
+        streamedHead->setPlaybackHint(headPos, 0, 0, 0);
+    }
+}
+
+void LoopingAudioSource::finishBlock(juce::int64 pos)
+{
+    renderPos = pos;
+    hasRendered = true;
+
+    // Don't clobber a seek that arrived while this block was rendering
+    if (pendingSeek.load() < 0)
+        nextPlayPos.store(pos);
+}
+
+void LoopingAudioSource::startDeclick(juce::int64 oldPosition)
+{
+    declickPos = oldPosition;
+    declickRemaining = kDeclickSamples;
+}
+
+void LoopingAudioSource::mixDeclick(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    if (declickRemaining <= 0)
+        return;
+
+    const int n = juce::jmin(declickRemaining, bufferToFill.numSamples, declickBuffer.getNumSamples());
+    if (n <= 0)
+    {
+        declickRemaining = 0;
+        return;
+    }
+
+    // Continue the old position for the length of the ramp
+    declickBuffer.clear(0, n);
+    juce::AudioSourceChannelInfo oldChunk(&declickBuffer, 0, n);
+    source->setNextReadPosition(declickPos);
+    source->getNextAudioBlock(oldChunk);
+
+    // Equal-power: the two positions are uncorrelated
+    const int done = kDeclickSamples - declickRemaining;
+    const int numChannels = bufferToFill.buffer->getNumChannels();
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* dest = bufferToFill.buffer->getWritePointer(ch, bufferToFill.startSample);
+        const auto* old = declickBuffer.getReadPointer(juce::jmin(ch, declickBuffer.getNumChannels() - 1));
+
+        for (int i = 0; i < n; ++i)
+        {
+            const float progress = static_cast<float>(done + i + 1) / static_cast<float>(kDeclickSamples);
+            const float angle = progress * juce::MathConstants<float>::halfPi;
+            dest[i] = dest[i] * std::sin(angle) + old[i] * std::cos(angle);
         }
     }
 
-    nextPlayPos.store(pos);
+    declickPos += n;
+    declickRemaining -= n;
 }
 
 void LoopingAudioSource::setNextReadPosition(juce::int64 newPosition)
 {
+    // Report the new position straight away; the audio thread applies it at
+    // the start of its next block.  If the target isn't resident the stream
+    // decodes it synchronously, so the seek is heard within one block either way.
     nextPlayPos.store(newPosition);
+    pendingSeek.store(newPosition);
+
+    if (streamingSource != nullptr)
+        streamingSource->prefetchFrom(newPosition);
 }
 
 juce::int64 LoopingAudioSource::getNextReadPosition() const
@@ -1,26 +1,81 @@
 #pragma once
 
-#include <JuceHeader.h>
+#include "EngineJuceHeader.h"
+#include <array>
 #include <atomic>
+#include "SeqLock.h"
+
+class StreamingAudioSource;
 
 class LoopingAudioSource : public juce::PositionableAudioSource
 {
 public:
+    // Everything the loop engine needs for one block, published as a unit so
+    // the audio thread never sees a half-applied edit.
+    struct Parameters
+    {
+        juce::int64 loopStart = 0;
+        juce::int64 loopEnd   = 0;
+        int crossfadeSamples  = 0;
+        float curveX = 0.25f;
+        float curveY = 0.75f;
+        bool equalPower = false; // sin/cos law instead of fadeOut = 1 - fadeIn
+    };
+
+    // Further loop segments in the same file.  Playback moves from segment to
+    // segment, crossfading from each one's tail into the next one's head; the
+    // loop range above is always the first segment.
+    struct Segment
+    {
+        juce::int64 start = 0;
+        juce::int64 end = 0;
+        float weight = 1.0f;
+    };
+
+    static constexpr int kMaxSegments = 16;
+
+    struct Playlist
+    {
+        std::array<Segment, kMaxSegments> segments {};
+        int numSegments = 0;
+        bool randomOrder = false;   // weighted random, never the same segment twice running
+        float primaryWeight = 1.0f;
+    };
+
     explicit LoopingAudioSource(juce::PositionableAudioSource* source, bool deleteWhenRemoved);
     ~LoopingAudioSource() override;
 
     void setLoopRange(juce::int64 startSample, juce::int64 endSample);
-    juce::int64 getLoopStart() const { return loopStart.load(); }
-    juce::int64 getLoopEnd() const   { return loopEnd.load(); }
+    juce::int64 getLoopStart() const { return params.read().loopStart; }
+    juce::int64 getLoopEnd() const   { return params.read().loopEnd; }
 
     void setLooping(bool shouldLoop) override;
 
     void setCrossfadeSamples(int samples);
-    int getCrossfadeSamples() const { return crossfadeSamples.load(); }
+    int getCrossfadeSamples() const { return params.read().crossfadeSamples; }
 
     void setCrossfadeCurve(float cx, float cy);
-    float getCurveX() const { return curveX.load(); }
-    float getCurveY() const { return curveY.load(); }
+    float getCurveX() const { return params.read().curveX; }
+    float getCurveY() const { return params.read().curveY; }
+
+    // Equal gain suits well-correlated head and tail; equal power keeps
+    // uncorrelated material from dipping in the middle of the fade
+    void setCrossfadeEqualPower(bool shouldUseEqualPower);
+    bool isCrossfadeEqualPower() const { return params.read().equalPower; }
+
+    // Cheaper straight-line fades in place of the curve, for when the engine
+    // is short of time; not saved with the layer
+    void setLinearCrossfades(bool shouldUseLinear) { linearCrossfades.store(shouldUseLinear); }
+
+    Parameters getParameters() const { return params.read(); }
+
+    void setPlaylist(const Playlist& newPlaylist);
+    Playlist getPlaylist() const { return playlist.read(); }
+
+    // Reads the crossfade head through a second, independent reader instead
+    // of the main one, so a long fade doesn't need head and tail resident in
+    // the same page budget.  Once attached the stream must outlive this source.
+    void setHeadStream(StreamingAudioSource* stream) { headStream.store(stream); }
 
     // PositionableAudioSource overrides
     void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
@@ -34,28 +89,79 @@ public:
 
 private:
     juce::OptionalScopedPointer<juce::PositionableAudioSource> source;
+    StreamingAudioSource* streamingSource = nullptr;
 
-    std::atomic<juce::int64> loopStart { 0 };
-    std::atomic<juce::int64> loopEnd   { 0 };
-    std::atomic<bool> looping          { true };
+    SeqLock<Parameters> params;
+    SeqLock<Playlist> playlist;
+    std::atomic<bool> looping { true };
+    std::atomic<bool> linearCrossfades { false };
 
     std::atomic<juce::int64> nextPlayPos { 0 };
-
-    std::atomic<int> crossfadeSamples { 0 };
-    juce::AudioBuffer<float> headCache;
-    int headCacheLength = 0;
-    juce::int64 cachedLoopStart = -1;
-    int cachedXfade = -1;
-
-    std::atomic<float> curveX { 0.25f };
-    std::atomic<float> curveY { 0.75f };
+    std::atomic<juce::int64> pendingSeek { -1 };
+
+    // Where the audio thread actually is; nextPlayPos may already show a seek
+    juce::int64 renderPos = 0;
+    bool hasRendered = false;
+
+    // Audio-thread copy of params, refreshed once per block
+    Parameters active;
+    std::uint32_t activeVersion = 0;
+    bool hasActive = false;
+
+    // Audio-thread playlist state
+    Playlist activePlaylist;
+    std::uint32_t playlistVersion = 0;
+    bool hasPlaylist = false;
+    int currentSegment = 0;
+    int nextSegment = 0;
+    juce::Random random;
+
+    // The segment being played, where playback goes after it, and the
+    // crossfade between the two
+    struct Span
+    {
+        juce::int64 start = 0;
+        juce::int64 end = 0;
+        juce::int64 nextStart = 0;
+        int xfade = 0;
+    };
+
+    // The span of a crossfade the last block ended inside, xfade 0 if none.
+    // A new crossfade length waits until that fade completes, since
+    // changing it midway would jump the gain.
+    Span fadingSpan;
+
+    // The next segment's head for the part of the crossfade being rendered
+    std::atomic<StreamingAudioSource*> headStream { nullptr };
+    juce::AudioBuffer<float> headScratch;
+
+    // Short ramp from the old read position when a seek or edit relocates the playhead
+    static constexpr int kDeclickSamples = 256;
+    juce::AudioBuffer<float> declickBuffer;
+    juce::int64 declickPos = 0;
+    int declickRemaining = 0;
 
     static constexpr int kLUTSize = 256;
-    float fadeLUT[kLUTSize + 1];
+    float fadeInLUT[kLUTSize + 1];
+    float fadeOutLUT[kLUTSize + 1];
     float cachedCurveX = -1.0f;
     float cachedCurveY = -1.0f;
-
-    void rebuildLUT();
+    bool cachedEqualPower = false;
+
+    bool refreshParameters();
+    bool refreshPlaylist();
+    int getNumSegments() const { return 1 + activePlaylist.numSegments; }
+    Segment getSegment(int index) const;
+    int chooseNextSegment(int after);
+    void advanceSegment();
+    void jumpToSegmentContaining(juce::int64 position);
+    Span getCurrentSpan() const;
+    void readHead(StreamingAudioSource* streamedHead, juce::int64 position, int numSamples);
+    static juce::int64 wrapIntoLoop(juce::int64 pos, juce::int64 lStart, juce::int64 lEnd, int xfade);
+    void finishBlock(juce::int64 pos);
+    void startDeclick(juce::int64 oldPosition);
+    void mixDeclick(const juce::AudioSourceChannelInfo& bufferToFill);
+    void rebuildLUT(float cx, float cy, bool equalPower);
     static float solveBezierT(float cx, float x);
     static float evalBezierY(float cy, float t);
 
@@ -0,0 +1,360 @@
+#include "LoudnessAnalyzer.h"
+#include <array>
+#include <cmath>
+#include <limits>
+
+LoudnessAnalyzer::LoudnessAnalyzer(juce::AudioFormatManager& fm)
+    : formatManager(fm),
+      pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1))
+{
+    cacheFile = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                    .getChildFile("DremSoundscape")
+                    .getChildFile("loudness-cache.json");
+    loadCache();
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+    pool.removeAllJobs(true, 5000);
+}
+
+juce::String LoudnessAnalyzer::fileKey(const juce::File& file)
+{
+    return file.getFullPathName() + "|" + juce::String(file.getSize())
+         + "|" + juce::String(file.getLastModificationTime().toMilliseconds());
+}
+
+juce::String LoudnessAnalyzer::resultKey(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd)
+{
+    return fileKey(file) + "|" + juce::String(loopStart) + "|" + juce::String(loopEnd);
+}
+
+void LoudnessAnalyzer::analyse(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                               std::function<void(double)> onResult)
+{
+    const auto key = resultKey(file, loopStart, loopEnd);
+
+    const auto cached = results.find(key);
+    if (cached != results.end())
+    {
+        onResult(cached->second);
+        return;
+    }
+
+    juce::WeakReference<LoudnessAnalyzer> weakThis(this);
+
+    pool.addJob([this, weakThis, file, loopStart, loopEnd, key, onResult]
+    {
+        const double lufs = runAnalysis(file, loopStart, loopEnd);
+        if (std::isnan(lufs))
+            return;
+
+        juce::MessageManager::callAsync([weakThis, key, lufs, onResult]
+        {
+            if (auto* self = weakThis.get())
+            {
+                self->results[key] = lufs;
+                self->saveCache();
+                onResult(lufs);
+            }
+        });
+    });
+}
+
+std::shared_ptr<LoudnessAnalyzer::FileSegments> LoudnessAnalyzer::getSegments(const juce::File& file)
+{
+    const juce::ScopedLock sl(filesLock);
+
+    auto& entry = files[fileKey(file)];
+    if (entry == nullptr)
+        entry = std::make_shared<FileSegments>();
+
+    return entry;
+}
+
+double LoudnessAnalyzer::runAnalysis(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd)
+{
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0)
+        return std::numeric_limits<double>::quiet_NaN();
+
+    auto segments = getSegments(file);
+    const auto length = reader->lengthInSamples;
+
+    loopEnd = juce::jlimit(static_cast<juce::int64>(1), length, loopEnd < 0 ? length : loopEnd);
+    loopStart = juce::jlimit(static_cast<juce::int64>(0), loopEnd - 1, loopStart);
+
+    std::vector<juce::int64> missing;
+    juce::int64 first = 0, last = 0;
+
+    {
+        const juce::ScopedLock sl(segments->lock);
+
+        if (segments->segmentLength == 0)
+        {
+            segments->segmentLength = juce::jmax(1, juce::roundToInt(kSegmentSeconds * reader->sampleRate));
+            const auto count = (length + segments->segmentLength - 1) / segments->segmentLength;
+            segments->energy.assign(static_cast<size_t>(count), std::numeric_limits<float>::quiet_NaN());
+        }
+
+        // Segments lying wholly inside the loop; a loop shorter than one
+        // segment is measured by the segment it starts in
+        const auto segLen = static_cast<juce::int64>(segments->segmentLength);
+        first = (loopStart + segLen - 1) / segLen;
+        last = loopEnd / segLen - 1;
+
+        if (last < first)
+            first = last = loopStart / segLen;
+
+        last = juce::jmin(last, static_cast<juce::int64>(segments->energy.size()) - 1);
+
+        for (auto s = first; s <= last; ++s)
+            if (std::isnan(segments->energy[static_cast<size_t>(s)]))
+                missing.push_back(s);
+    }
+
+    // Only what this loop range hasn't already measured
+    if (!missing.empty())
+        measureSegments(*reader, *segments, missing);
+
+    std::vector<float> region;
+
+    {
+        const juce::ScopedLock sl(segments->lock);
+        region.assign(segments->energy.begin() + static_cast<std::ptrdiff_t>(first),
+                      segments->energy.begin() + static_cast<std::ptrdiff_t>(last + 1));
+    }
+
+    return integrate(region);
+}
+
+void LoudnessAnalyzer::makeKWeighting(double sampleRate, Biquad& shelf, Biquad& highPass)
+{
+    // BS.1770 stage 1 (high shelf) and stage 2 (RLB high-pass), derived from
+    // their analogue prototypes so any sample rate gets the 48 kHz response
+    {
+        const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+
+        shelf.b0 = static_cast<float>((vh + vb * k / q + k * k) / a0);
+        shelf.b1 = static_cast<float>(2.0 * (k * k - vh) / a0);
+        shelf.b2 = static_cast<float>((vh - vb * k / q + k * k) / a0);
+        shelf.a1 = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        shelf.a2 = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+
+    {
+        const double f0 = 38.13547087602444, q = 0.5003270373238773;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+
+        highPass.b0 = 1.0f;
+        highPass.b1 = -2.0f;
+        highPass.b2 = 1.0f;
+        highPass.a1 = static_cast<float>(2.0 * (k * k - 1.0) / a0);
+        highPass.a2 = static_cast<float>((1.0 - k / q + k * k) / a0);
+    }
+}
+
+void LoudnessAnalyzer::measureSegments(juce::AudioFormatReader& reader, FileSegments& segments,
+                                       const std::vector<juce::int64>& missing)
+{
+    constexpr int numLanes = static_cast<int>(Vec::SIMDNumElements);
+
+    struct Chunk
+    {
+        juce::int64 firstSegment;
+        int numSegments;
+    };
+
+    // Split the missing segments into runs that each lane can filter on its own
+    std::vector<Chunk> chunks;
+    for (auto s : missing)
+    {
+        if (!chunks.empty()
+            && chunks.back().firstSegment + chunks.back().numSegments == s
+            && chunks.back().numSegments < kSegmentsPerLane)
+            ++chunks.back().numSegments;
+        else
+            chunks.push_back({ s, 1 });
+    }
+
+    int segLen = 0;
+    {
+        const juce::ScopedLock sl(segments.lock);
+        segLen = segments.segmentLength;
+    }
+
+    const int numChannels = juce::jlimit(1, 8, static_cast<int>(reader.numChannels));
+    const int warmup = kWarmupSegments * segLen;
+
+    Biquad shelf, highPass;
+    makeKWeighting(reader.sampleRate, shelf, highPass);
+
+    std::vector<juce::AudioBuffer<float>> laneAudio(static_cast<size_t>(numLanes));
+    for (auto& buffer : laneAudio)
+        buffer.setSize(numChannels, warmup + kSegmentsPerLane * segLen);
+
+    alignas(Vec::SIMDRegisterSize) float lanes[Vec::SIMDNumElements];
+    std::array<std::array<double, kSegmentsPerLane>, Vec::SIMDNumElements> sums;
+
+    for (size_t c = 0; c < chunks.size(); c += static_cast<size_t>(numLanes))
+    {
+        const int used = static_cast<int>(juce::jmin(static_cast<size_t>(numLanes), chunks.size() - c));
+        std::array<int, Vec::SIMDNumElements> laneLength {};
+        int longest = 0;
+
+        // Each lane starts a little early so its filters have settled by the
+        // first segment it measures; reads before the file start are silence
+        for (int lane = 0; lane < used; ++lane)
+        {
+            const auto& chunk = chunks[c + static_cast<size_t>(lane)];
+            const int numSamples = warmup + chunk.numSegments * segLen;
+
+            reader.read(&laneAudio[static_cast<size_t>(lane)], 0, numSamples,
+                        chunk.firstSegment * segLen - warmup, true, true);
+
+            laneLength[static_cast<size_t>(lane)] = numSamples;
+            longest = juce::jmax(longest, numSamples);
+        }
+
+        for (auto& laneSums : sums)
+            laneSums.fill(0.0);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto s1 = Vec::expand(0.0f), s2 = Vec::expand(0.0f);
+            auto t1 = Vec::expand(0.0f), t2 = Vec::expand(0.0f);
+
+            std::array<const float*, Vec::SIMDNumElements> inputs {};
+            for (int lane = 0; lane < used; ++lane)
+                inputs[static_cast<size_t>(lane)] = laneAudio[static_cast<size_t>(lane)].getReadPointer(ch);
+
+            for (int i = 0; i < longest; ++i)
+            {
+                for (int lane = 0; lane < numLanes; ++lane)
+                    lanes[lane] = i < laneLength[static_cast<size_t>(lane)] ? inputs[static_cast<size_t>(lane)][i] : 0.0f;
+
+                const auto x = Vec::fromRawArray(lanes);
+
+                // Transposed direct form II, both stages
+                const auto y = x * Vec::expand(shelf.b0) + s1;
+                s1 = x * Vec::expand(shelf.b1) - y * Vec::expand(shelf.a1) + s2;
+                s2 = x * Vec::expand(shelf.b2) - y * Vec::expand(shelf.a2);
+
+                const auto z = y * Vec::expand(highPass.b0) + t1;
+                t1 = y * Vec::expand(highPass.b1) - z * Vec::expand(highPass.a1) + t2;
+                t2 = y * Vec::expand(highPass.b2) - z * Vec::expand(highPass.a2);
+
+                (z * z).copyToRawArray(lanes);
+
+                if (i < warmup)
+                    continue;
+
+                const int segment = (i - warmup) / segLen;
+                for (int lane = 0; lane < used; ++lane)
+                    if (i < laneLength[static_cast<size_t>(lane)])
+                        sums[static_cast<size_t>(lane)][static_cast<size_t>(segment)] += lanes[lane];
+            }
+        }
+
+        const juce::ScopedLock sl(segments.lock);
+
+        for (int lane = 0; lane < used; ++lane)
+        {
+            const auto& chunk = chunks[c + static_cast<size_t>(lane)];
+            for (int s = 0; s < chunk.numSegments; ++s)
+                segments.energy[static_cast<size_t>(chunk.firstSegment + s)]
+                    = static_cast<float>(sums[static_cast<size_t>(lane)][static_cast<size_t>(s)] / segLen);
+        }
+    }
+}
+
+double LoudnessAnalyzer::integrate(const std::vector<float>& segmentEnergy)
+{
+    if (segmentEnergy.empty())
+        return kSilenceLufs;
+
+    // 400 ms blocks on a 100 ms hop; a shorter region is one block
+    std::vector<double> blocks;
+    if (static_cast<int>(segmentEnergy.size()) < kSegmentsPerBlock)
+    {
+        double sum = 0.0;
+        for (auto e : segmentEnergy)
+            sum += e;
+        blocks.push_back(sum / static_cast<double>(segmentEnergy.size()));
+    }
+    else
+    {
+        for (size_t j = 0; j + kSegmentsPerBlock <= segmentEnergy.size(); ++j)
+        {
+            double sum = 0.0;
+            for (int s = 0; s < kSegmentsPerBlock; ++s)
+                sum += segmentEnergy[j + static_cast<size_t>(s)];
+            blocks.push_back(sum / kSegmentsPerBlock);
+        }
+    }
+
+    auto toLufs = [](double energy) { return -0.691 + 10.0 * std::log10(energy); };
+
+    auto gatedMean = [&blocks, &toLufs](double gateLufs)
+    {
+        double sum = 0.0;
+        int count = 0;
+        for (auto z : blocks)
+        {
+            if (z > 0.0 && toLufs(z) > gateLufs)
+            {
+                sum += z;
+                ++count;
+            }
+        }
+        return count > 0 ? sum / count : 0.0;
+    };
+
+    const double absoluteGated = gatedMean(kSilenceLufs);
+    if (absoluteGated <= 0.0)
+        return kSilenceLufs;
+
+    const double relativeGated = gatedMean(juce::jmax(kSilenceLufs, toLufs(absoluteGated) - 10.0));
+    return relativeGated > 0.0 ? toLufs(relativeGated) : kSilenceLufs;
+}
+
+void LoudnessAnalyzer::loadCache()
+{
+    if (!cacheFile.existsAsFile())
+        return;
+
+    const auto parsed = juce::JSON::parse(cacheFile.loadFileAsString());
+    auto* entries = parsed.getArray();
+    if (entries == nullptr)
+        return;
+
+    for (const auto& entry : *entries)
+    {
+        auto* obj = entry.getDynamicObject();
+        if (obj == nullptr || !obj->hasProperty("key") || !obj->hasProperty("lufs"))
+            continue;
+
+        results[obj->getProperty("key").toString()] = static_cast<double>(obj->getProperty("lufs"));
+    }
+}
+
+void LoudnessAnalyzer::saveCache()
+{
+    juce::Array<juce::var> entries;
+
+    for (const auto& [key, lufs] : results)
+    {
+        auto* obj = new juce::DynamicObject();
+        obj->setProperty("key", key);
+        obj->setProperty("lufs", lufs);
+        entries.add(juce::var(obj));
+    }
+
+    cacheFile.getParentDirectory().createDirectory();
+    cacheFile.replaceWithText(juce::JSON::toString(juce::var(entries)));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+// Integrated loudness (EBU R128 / ITU-R BS.1770) of a loop region, measured
+// in the background.
+//
+// Requests run in parallel on a worker pool.  Each file's K-weighted energy
+// is kept in 100 ms segments aligned to the file, so a loop edit only has to
+// measure segments it hasn't seen; the K-weighting runs several independent
+// stretches of the file side by side in SIMDRegister lanes.  Finished
+// results are cached per file and loop range in the app-data folder.
+class LoudnessAnalyzer
+{
+public:
+    explicit LoudnessAnalyzer(juce::AudioFormatManager& formatManager);
+    ~LoudnessAnalyzer();
+
+    // Message thread.  The callback runs on the message thread with the
+    // region's integrated loudness in LUFS (kSilenceLufs if it's all gated).
+    void analyse(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
+                 std::function<void(double)> onResult);
+
+    static constexpr double kSilenceLufs = -70.0;
+
+private:
+    using Vec = juce::dsp::SIMDRegister<float>;
+
+    // Segment energies for one file, shared by every request against it
+    struct FileSegments
+    {
+        juce::CriticalSection lock;
+        std::vector<float> energy; // NaN until measured
+        int segmentLength = 0;
+    };
+
+    struct Biquad
+    {
+        float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+    };
+
+    static juce::String fileKey(const juce::File& file);
+    static juce::String resultKey(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd);
+    static void makeKWeighting(double sampleRate, Biquad& shelf, Biquad& highPass);
+    static double integrate(const std::vector<float>& segmentEnergy);
+
+    std::shared_ptr<FileSegments> getSegments(const juce::File& file);
+    double runAnalysis(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd);
+    void measureSegments(juce::AudioFormatReader& reader, FileSegments& segments,
+                         const std::vector<juce::int64>& missing);
+
+    void loadCache();
+    void saveCache();
+
+    juce::AudioFormatManager& formatManager;
+    juce::ThreadPool pool;
+
+    juce::CriticalSection filesLock;
+    std::map<juce::String, std::shared_ptr<FileSegments>> files;
+
+    // Message thread only
+    std::map<juce::String, double> results;
+    juce::File cacheFile;
+
+    static constexpr double kSegmentSeconds = 0.1;
+    static constexpr int kSegmentsPerBlock = 4;   // 400 ms gating blocks, 75% overlap
+    static constexpr int kWarmupSegments = 2;     // filter pre-roll for each lane
+    static constexpr int kSegmentsPerLane = 50;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(LoudnessAnalyzer)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessAnalyzer)
+};
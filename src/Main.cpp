@@ -22,7 +22,16 @@ public:
         juce::JUCEApplication::getInstance()->systemRequestedQuit();
     }
 
+    void minimisationStateChanged(bool) override   { updateContentState(); }
+    void activeWindowStatusChanged() override      { updateContentState(); }
+
 private:
+    void updateContentState()
+    {
+        if (auto* content = dynamic_cast<MainComponent*>(getContentComponent()))
+            content->setWindowState(isMinimised(), isActiveWindow());
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainWindow)
 };
 
@@ -2,56 +2,79 @@
 
 MainComponent::MainComponent()
 {
-    formatManager.registerBasicFormats();
-    readAheadThread.startThread(juce::Thread::Priority::normal);
-
     auto result = deviceManager.initialiseWithDefaultDevices(0, 2);
     if (result.isNotEmpty())
         juce::Logger::writeToLog("Audio device error: " + result);
 
     deviceManager.addAudioCallback(&audioSourcePlayer);
-    audioSourcePlayer.setSource(&filteredOutput);
+    audioSourcePlayer.setSource(&engine.getOutput());
+    updateDeviceLatency();
 
     // Toolbar buttons
     addFileButton.onClick    = [this] { addFiles(); };
+    addSequenceButton.onClick = [this] { addSequence(); };
+    addEventsButton.onClick   = [this] { addEvents(); };
     savePresetButton.onClick = [this] { savePreset(); };
     loadPresetButton.onClick = [this] { loadPreset(); };
     playButton.onClick       = [this] { startPlayback(); };
     stopButton.onClick       = [this] { stopPlayback(); };
 
-    masterVolumeKnob.setSliderStyle(juce::Slider::RotaryVerticalDrag);
-    masterVolumeKnob.setRange(0.0, 1.5, 0.01);
-    masterVolumeKnob.setValue(1.0, juce::dontSendNotification);
-    masterVolumeKnob.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
-    masterVolumeKnob.setDoubleClickReturnValue(true, 1.0);
-    masterVolumeKnob.onValueChange = [this] {
-        audioSourcePlayer.setGain(static_cast<float>(masterVolumeKnob.getValue()));
-    };
+    setupKnob(masterVolumeKnob, masterVolumeLabel, 0.0, 1.5, 0.01, 1.0, [this](double v) {
+        engine.setMasterVolume(static_cast<float>(v));
+    });
 
-    hpfCutoffKnob.setSliderStyle(juce::Slider::RotaryVerticalDrag);
-    hpfCutoffKnob.setRange(20.0, 2000.0, 1.0);
-    hpfCutoffKnob.setValue(20.0, juce::dontSendNotification);
+    setupKnob(hpfCutoffKnob, hpfCutoffLabel, 20.0, 2000.0, 1.0, 20.0, [this](double v) {
+        engine.setMasterHighPass(static_cast<float>(v));
+    });
     hpfCutoffKnob.setSkewFactorFromMidPoint(200.0);
-    hpfCutoffKnob.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
-    hpfCutoffKnob.setDoubleClickReturnValue(true, 20.0);
-    hpfCutoffKnob.onValueChange = [this] {
-        filteredOutput.setCutoffFrequency(static_cast<float>(hpfCutoffKnob.getValue()));
-    };
 
-    hpfCutoffLabel.setJustificationType(juce::Justification::centred);
-    masterVolumeLabel.setJustificationType(juce::Justification::centred);
+    setupKnob(lowShelfKnob, lowShelfLabel, -12.0, 12.0, 0.1, 0.0, [this](double v) {
+        engine.setMasterLowShelf(static_cast<float>(v));
+    });
+
+    setupKnob(highShelfKnob, highShelfLabel, -12.0, 12.0, 0.1, 0.0, [this](double v) {
+        engine.setMasterHighShelf(static_cast<float>(v));
+    });
+
+    setupKnob(lpfCutoffKnob, lpfCutoffLabel, 200.0, 20000.0, 1.0, 20000.0, [this](double v) {
+        engine.setMasterLowPass(static_cast<float>(v));
+    });
+    lpfCutoffKnob.setSkewFactorFromMidPoint(2000.0);
+
+    setupKnob(targetLoudnessKnob, targetLoudnessLabel, -36.0, -6.0, 0.5, -23.0, [this](double v) {
+        engine.setTargetLoudness(v);
+    });
+
+    setupKnob(roomWetKnob, roomWetLabel, 0.0, 1.0, 0.01, 0.3, [this](double v) {
+        engine.setRoomWet(static_cast<float>(v));
+    });
+
+    roomButton.onClick = [this] { showRoomMenu(); };
+    engine.onRoomChanged = [this] { updateRoomButton(); };
+    engine.onSceneChanged = [this] { showScene(); };
+
+    renderAheadButton.setTooltip("Render the mix ahead of the audio device, so a slow block can't drop out");
+    renderAheadButton.setToggleState(engine.isRenderAheadEnabled(), juce::dontSendNotification);
+    renderAheadButton.onClick = [this] { setRenderAhead(renderAheadButton.getToggleState()); };
+
+    lowPowerButton.setTooltip("Use the device's largest buffer and render in bursts, and stop drawing while the window is in the background");
+    lowPowerButton.onClick = [this] { setLowPower(lowPowerButton.getToggleState()); };
 
     addAndMakeVisible(addFileButton);
+    addAndMakeVisible(addSequenceButton);
+    addAndMakeVisible(addEventsButton);
     addAndMakeVisible(savePresetButton);
     addAndMakeVisible(loadPresetButton);
     addAndMakeVisible(playButton);
     addAndMakeVisible(stopButton);
-    addAndMakeVisible(hpfCutoffKnob);
-    addAndMakeVisible(hpfCutoffLabel);
-    addAndMakeVisible(masterVolumeKnob);
-    addAndMakeVisible(masterVolumeLabel);
+    addAndMakeVisible(renderAheadButton);
+    addAndMakeVisible(lowPowerButton);
+    addAndMakeVisible(roomButton);
+    addAndMakeVisible(spectrumDisplay);
+    addAndMakeVisible(masterMeter);
 
     viewport.setViewedComponent(&layerContainer, false);
+    viewport.onVisibleAreaChanged = [this]() { updateVisibleLayers(); };
     addAndMakeVisible(viewport);
 
     playButton.setEnabled(false);
@@ -59,24 +82,35 @@ MainComponent::MainComponent()
     savePresetButton.setEnabled(false);
 
     setWantsKeyboardFocus(true);
-    setSize(800, 600);
+    setSize(1210, 690);
 }
 
 MainComponent::~MainComponent()
 {
-    // Stop all transports and remove from mixer
-    for (auto* layer : layers)
-    {
-        layer->stopPlayback();
-        mixer.removeInputSource(&layer->getTransportSource());
-    }
-
-    layers.clear();
+    // The views go before the engine layers they show
+    viewport.onVisibleAreaChanged = nullptr;
+    layerViews.clear();
+    engine.onRoomChanged = nullptr;
+    engine.onSceneChanged = nullptr;
 
     audioSourcePlayer.setSource(nullptr);
     deviceManager.removeAudioCallback(&audioSourcePlayer);
-    mixer.removeAllInputs();
-    readAheadThread.stopThread(500);
+}
+
+void MainComponent::setupKnob(juce::Slider& knob, juce::Label& label, double min, double max,
+                              double interval, double defaultValue, std::function<void(double)> onChange)
+{
+    knob.setSliderStyle(juce::Slider::RotaryVerticalDrag);
+    knob.setRange(min, max, interval);
+    knob.setValue(defaultValue, juce::dontSendNotification);
+    knob.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    knob.setDoubleClickReturnValue(true, defaultValue);
+    knob.onValueChange = [&knob, onChange] { onChange(knob.getValue()); };
+
+    label.setJustificationType(juce::Justification::centred);
+
+    addAndMakeVisible(knob);
+    addAndMakeVisible(label);
 }
 
 void MainComponent::resized()
@@ -86,21 +120,29 @@ void MainComponent::resized()
     // Toolbar row
     auto toolbar = area.removeFromTop(80);
 
-    // Master volume knob — far right
-    auto masterKnobArea = toolbar.removeFromRight(70);
-    masterVolumeKnob.setBounds(masterKnobArea);
-    auto masterLabelArea = toolbar.removeFromRight(50);
-    masterVolumeLabel.setBounds(masterLabelArea.withHeight(20).withY(masterKnobArea.getCentreY() - 10));
+    // Knobs — right side, master outermost, tone stages in signal order
+    auto placeKnob = [&toolbar](juce::Slider& knob, juce::Label& label)
+    {
+        auto cell = toolbar.removeFromRight(64);
+        label.setBounds(cell.removeFromBottom(20));
+        knob.setBounds(cell);
+    };
 
-    // HPF cutoff knob — left of master volume
-    auto hpfKnobArea = toolbar.removeFromRight(70);
-    hpfCutoffKnob.setBounds(hpfKnobArea);
-    auto hpfLabelArea = toolbar.removeFromRight(50);
-    hpfCutoffLabel.setBounds(hpfLabelArea.withHeight(20).withY(hpfKnobArea.getCentreY() - 10));
+    placeKnob(masterVolumeKnob, masterVolumeLabel);
+    placeKnob(targetLoudnessKnob, targetLoudnessLabel);
+    toolbar.removeFromRight(8);
+    placeKnob(lpfCutoffKnob, lpfCutoffLabel);
+    placeKnob(highShelfKnob, highShelfLabel);
+    placeKnob(lowShelfKnob, lowShelfLabel);
+    placeKnob(hpfCutoffKnob, hpfCutoffLabel);
 
     // Buttons — left side
     addFileButton.setBounds(toolbar.removeFromLeft(100).withHeight(36));
     toolbar.removeFromLeft(8);
+    addSequenceButton.setBounds(toolbar.removeFromLeft(110).withHeight(36));
+    toolbar.removeFromLeft(8);
+    addEventsButton.setBounds(toolbar.removeFromLeft(100).withHeight(36));
+    toolbar.removeFromLeft(8);
     savePresetButton.setBounds(toolbar.removeFromLeft(100).withHeight(36));
     toolbar.removeFromLeft(8);
     loadPresetButton.setBounds(toolbar.removeFromLeft(100).withHeight(36));
@@ -111,6 +153,23 @@ void MainComponent::resized()
 
     area.removeFromTop(10);
 
+    // Master analysis row, with the room reverb ahead of the meter
+    auto analysisRow = area.removeFromTop(80);
+    masterMeter.setBounds(analysisRow.removeFromRight(24));
+    analysisRow.removeFromRight(4);
+
+    auto roomCell = analysisRow.removeFromRight(64);
+    roomWetLabel.setBounds(roomCell.removeFromBottom(20));
+    roomWetKnob.setBounds(roomCell);
+    auto roomButtons = analysisRow.removeFromRight(120).reduced(0, 8);
+    roomButton.setBounds(roomButtons.removeFromTop(24));
+    lowPowerButton.setBounds(roomButtons.removeFromBottom(20));
+    renderAheadButton.setBounds(roomButtons.removeFromBottom(20));
+    analysisRow.removeFromRight(8);
+    spectrumDisplay.setBounds(analysisRow);
+
+    area.removeFromTop(10);
+
     // Viewport fills the rest
     viewport.setBounds(area);
     layoutLayers();
@@ -121,7 +180,7 @@ void MainComponent::addFiles()
     fileChooser = std::make_unique<juce::FileChooser>(
         "Select audio file(s)...",
         juce::File{},
-        formatManager.getWildcardForAllFormats());
+        engine.getFormatManager().getWildcardForAllFormats());
 
     auto chooserFlags = juce::FileBrowserComponent::openMode
                       | juce::FileBrowserComponent::canSelectFiles
@@ -133,39 +192,286 @@ void MainComponent::addFiles()
         for (const auto& file : results)
         {
             if (file.existsAsFile())
-                addLayer(file, 0, -1);
+            {
+                PresetLayer settings;
+                settings.files.add(file);
+                addLayer(settings);
+            }
         }
     });
 }
 
-void MainComponent::addLayer(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
-                             int crossfadeSamples, float curveX, float curveY,
-                             float volume)
+void MainComponent::addSequence()
 {
-    auto* layer = new SoundLayer(formatManager, readAheadThread);
+    fileChooser = std::make_unique<juce::FileChooser>(
+        "Select the files to play in sequence...",
+        juce::File{},
+        engine.getFormatManager().getWildcardForAllFormats());
 
-    // Add to mixer first so the transport is prepared (matching the original
-    // code path where audioSourcePlayer prepared the transport before setSource).
-    mixer.addInputSource(&layer->getTransportSource(), false);
+    auto chooserFlags = juce::FileBrowserComponent::openMode
+                      | juce::FileBrowserComponent::canSelectFiles
+                      | juce::FileBrowserComponent::canSelectMultipleItems;
 
-    if (!layer->loadFile(file, loopStart, loopEnd, crossfadeSamples, curveX, curveY))
+    fileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& chooser)
     {
-        mixer.removeInputSource(&layer->getTransportSource());
-        delete layer;
+        juce::Array<juce::File> files;
+        for (const auto& file : chooser.getResults())
+            if (file.existsAsFile())
+                files.add(file);
+
+        // Chunked recordings are numbered, so name order is play order
+        files.sort();
+
+        if (files.isEmpty())
+            return;
+
+        PresetLayer settings;
+        settings.kind = PresetLayer::Kind::Sequence;
+        settings.files = files;
+        addLayer(settings);
+    });
+}
+
+void MainComponent::addEvents()
+{
+    fileChooser = std::make_unique<juce::FileChooser>(
+        "Select one-shot samples...",
+        juce::File{},
+        engine.getFormatManager().getWildcardForAllFormats());
+
+    auto chooserFlags = juce::FileBrowserComponent::openMode
+                      | juce::FileBrowserComponent::canSelectFiles
+                      | juce::FileBrowserComponent::canSelectMultipleItems;
+
+    fileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& chooser)
+    {
+        juce::Array<juce::File> files;
+        for (const auto& file : chooser.getResults())
+            if (file.existsAsFile())
+                files.add(file);
+
+        if (files.isEmpty())
+            return;
+
+        // A fresh seed per layer so two event layers don't fire in lockstep
+        PresetLayer settings;
+        settings.kind = PresetLayer::Kind::Events;
+        settings.files = files;
+        settings.eventSettings.seed = juce::Random::getSystemRandom().nextInt64();
+        addLayer(settings);
+    });
+}
+
+void MainComponent::addLayer(const PresetLayer& settings)
+{
+    if (engine.addLayer(settings) == nullptr)
         return;
-    }
 
-    layer->setVolume(volume);
+    layoutLayers();
+    enableTransport(true);
+}
+
+SoundLayer* MainComponent::createView(EngineLayer& engineLayer)
+{
+    auto* layer = new SoundLayer(engineLayer, engine.getFormatManager(), thumbnailCache);
     layer->onRemove = [this](SoundLayer* l) { removeLayer(l); };
+    layer->onLoopEdited = [this](SoundLayer* l) { engine.requestLoudness(l->getEngineLayer()); };
+    layer->onFindLoopPoint = [this](SoundLayer* l) { findLoopPoint(l); };
 
     layerContainer.addAndMakeVisible(layer);
-    layers.add(layer);
+    layerViews.add(layer);
+
+    // New views stay still if the window is out of sight
+    layer->setAnimating(animating);
+    return layer;
+}
+
+SoundLayer* MainComponent::findView(const EngineLayer* engineLayer) const
+{
+    for (auto* view : layerViews)
+        if (&view->getEngineLayer() == engineLayer)
+            return view;
+
+    return nullptr;
+}
+
+void MainComponent::enableTransport(bool hasLayers)
+{
+    playButton.setEnabled(hasLayers);
+    stopButton.setEnabled(hasLayers);
+    savePresetButton.setEnabled(hasLayers);
+}
 
+void MainComponent::showScene()
+{
+    // Every view belongs to the scene that was just replaced
+    layerViews.clear();
     layoutLayers();
+    enableTransport(engine.getNumLayers() > 0);
+
+    if (!pendingMissingLayers.empty() && missingFileChooser == nullptr)
+        juce::MessageManager::callAsync([this]() { processNextMissingLayer(); });
+}
+
+void MainComponent::findLoopPoint(SoundLayer* layer)
+{
+    auto* looping = layer->getEngineLayer().getLoopingSource();
+    if (looping == nullptr)
+        return;
+
+    const auto loopStart = looping->getLoopStart();
+    const auto loopEnd = looping->getLoopEnd();
+    auto* engineLayer = &layer->getEngineLayer();
+    auto safeThis = juce::Component::SafePointer<MainComponent>(this);
+
+    // The view may be scrolled away before the answer comes, so hold on to
+    // the engine layer and look the view up again then
+    engine.getLoopPointFinder().findLoopEnd(engineLayer->getFilePath(), loopStart, loopEnd,
+                                            [safeThis, engineLayer, loopStart, loopEnd](const LoopPointFinder::Suggestion& suggestion)
+    {
+        if (safeThis == nullptr || safeThis->engine.indexOfLayer(engineLayer) < 0)
+            return;
+
+        // Don't overrule handles the user moved while the search ran
+        auto* targetLoop = engineLayer->getLoopingSource();
+        if (targetLoop == nullptr || targetLoop->getLoopStart() != loopStart || targetLoop->getLoopEnd() != loopEnd)
+            return;
+
+        if (auto* view = safeThis->findView(engineLayer))
+        {
+            view->applyLoopSuggestion(suggestion);
+            return;
+        }
+
+        engineLayer->applyLoopSuggestion(suggestion);
+        safeThis->engine.requestLoudness(*engineLayer);
+    });
+}
+
+void MainComponent::showRoomMenu()
+{
+    const bool hasRoom = engine.getRoomImpulse() != juce::File{};
+
+    juce::PopupMenu menu;
+    menu.addItem(1, "Load impulse response...");
+    menu.addItem(2, "No room", hasRoom);
+
+    auto safeThis = juce::Component::SafePointer<MainComponent>(this);
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&roomButton),
+                       [safeThis](int result) {
+        auto* self = safeThis.getComponent();
+        if (self == nullptr)
+            return;
+
+        if (result == 2)
+        {
+            self->engine.clearRoomImpulse();
+            return;
+        }
+
+        if (result != 1)
+            return;
+
+        self->fileChooser = std::make_unique<juce::FileChooser>(
+            "Select an impulse response...",
+            juce::File{},
+            self->engine.getFormatManager().getWildcardForAllFormats());
+
+        auto chooserFlags = juce::FileBrowserComponent::openMode
+                          | juce::FileBrowserComponent::canSelectFiles;
+
+        self->fileChooser->launchAsync(chooserFlags, [safeThis](const juce::FileChooser& chooser)
+        {
+            auto file = chooser.getResult();
+            if (safeThis != nullptr && file.existsAsFile())
+                safeThis->engine.loadRoomImpulse(file);
+        });
+    });
+}
 
-    playButton.setEnabled(true);
-    stopButton.setEnabled(true);
-    savePresetButton.setEnabled(true);
+void MainComponent::setRenderAhead(bool shouldRenderAhead)
+{
+    // Re-preparing the chain is the only time no thread is pulling it, so
+    // the switch can't race the engine thread
+    audioSourcePlayer.setSource(nullptr);
+    engine.setRenderAheadEnabled(shouldRenderAhead);
+    audioSourcePlayer.setSource(&engine.getOutput());
+}
+
+void MainComponent::setLowPower(bool shouldSavePower)
+{
+    lowPower = shouldSavePower;
+    engine.setLowPower(lowPower);
+
+    // The largest buffer the device offers cuts callbacks, and everything
+    // they wake, by the same factor
+    if (auto* device = deviceManager.getCurrentAudioDevice())
+    {
+        auto setup = deviceManager.getAudioDeviceSetup();
+
+        if (lowPower)
+        {
+            normalBufferSize = setup.bufferSize;
+            for (auto size : device->getAvailableBufferSizes())
+                setup.bufferSize = juce::jmax(setup.bufferSize, size);
+        }
+        else if (normalBufferSize > 0)
+        {
+            setup.bufferSize = normalBufferSize;
+        }
+
+        const auto error = deviceManager.setAudioDeviceSetup(setup, true);
+        if (error.isNotEmpty())
+            juce::Logger::writeToLog("Audio device error: " + error);
+
+        updateDeviceLatency();
+
+        if (auto* current = deviceManager.getCurrentAudioDevice())
+            juce::Logger::writeToLog("Low power " + juce::String(lowPower ? "on" : "off") + ": "
+                                     + juce::String(current->getCurrentBufferSizeSamples()) + " sample buffer, "
+                                     + juce::String(current->getCurrentSampleRate() / current->getCurrentBufferSizeSamples(), 1)
+                                     + " callbacks/s");
+    }
+
+    updateAnimation();
+}
+
+void MainComponent::updateDeviceLatency()
+{
+    if (auto* device = deviceManager.getCurrentAudioDevice())
+        engine.setDeviceLatency((device->getOutputLatencyInSamples() + device->getCurrentBufferSizeSamples())
+                                / device->getCurrentSampleRate());
+}
+
+void MainComponent::setWindowState(bool isMinimised, bool isActive)
+{
+    windowMinimised = isMinimised;
+    windowActive = isActive;
+    updateAnimation();
+}
+
+void MainComponent::updateAnimation()
+{
+    // JUCE has no screen-lock notification, but locking takes the window out
+    // of the foreground, so low power treats any inactive window as unseen
+    const bool shouldAnimate = !windowMinimised && (windowActive || !lowPower);
+    if (shouldAnimate == animating)
+        return;
+
+    animating = shouldAnimate;
+    spectrumDisplay.setAnimating(animating);
+    masterMeter.setAnimating(animating);
+
+    for (auto* layer : layerViews)
+        layer->setAnimating(animating);
+
+    engine.setAnalysisIdle(!animating);
+}
+
+void MainComponent::updateRoomButton()
+{
+    const auto file = engine.getRoomImpulse();
+    roomButton.setButtonText(file == juce::File{} ? "Room..." : file.getFileNameWithoutExtension());
 }
 
 void MainComponent::removeLayer(SoundLayer* layer)
@@ -173,48 +479,70 @@ void MainComponent::removeLayer(SoundLayer* layer)
     if (layer == nullptr)
         return;
 
-    layer->stopPlayback();
-    mixer.removeInputSource(&layer->getTransportSource());
+    auto* engineLayer = &layer->getEngineLayer();
     layerContainer.removeChildComponent(layer);
-    layers.removeObject(layer, true);
+    layerViews.removeObject(layer, true);
+    engine.removeLayer(engineLayer);
 
     layoutLayers();
 
-    if (layers.isEmpty())
-    {
-        playButton.setEnabled(false);
-        stopButton.setEnabled(false);
-        savePresetButton.setEnabled(false);
-    }
+    if (engine.getNumLayers() == 0)
+        enableTransport(false);
 }
 
 void MainComponent::layoutLayers()
 {
-    int totalHeight = layers.size() * layerHeight;
+    int totalHeight = engine.getNumLayers() * layerHeight;
     int width = viewport.getMaximumVisibleWidth();
     if (width <= 0)
         width = viewport.getWidth();
 
     layerContainer.setSize(width, juce::jmax(1, totalHeight));
 
-    for (int i = 0; i < layers.size(); ++i)
-        layers[i]->setBounds(0, i * layerHeight, width, layerHeight);
+    // Resizing usually scrolls too, but not when nothing has moved
+    updateVisibleLayers();
 }
 
-bool MainComponent::isPlaying() const
+void MainComponent::updateVisibleLayers()
 {
-    for (auto* layer : layers)
-        if (layer->getTransportSource().isPlaying())
-            return true;
+    const auto area = viewport.getViewArea();
+    const int numLayers = engine.getNumLayers();
+    const int first = juce::jmax(0, area.getY() / layerHeight - kOverscanRows);
+    const int last = juce::jmin(numLayers - 1, (area.getBottom() - 1) / layerHeight + kOverscanRows);
 
-    return false;
+    // Drop the views that have left the window, and those whose layer has gone
+    for (int i = layerViews.size(); --i >= 0;)
+    {
+        const int row = engine.indexOfLayer(&layerViews[i]->getEngineLayer());
+        if (row < first || row > last)
+        {
+            layerContainer.removeChildComponent(layerViews[i]);
+            layerViews.remove(i);
+        }
+    }
+
+    for (int row = first; row <= last; ++row)
+    {
+        auto* engineLayer = engine.getLayer(row);
+        auto* view = findView(engineLayer);
+
+        if (view == nullptr)
+            view = createView(*engineLayer);
+
+        view->setBounds(0, row * layerHeight, layerContainer.getWidth(), layerHeight);
+    }
+}
+
+bool MainComponent::isPlaying() const
+{
+    return engine.getStatus().playing;
 }
 
 bool MainComponent::keyPressed(const juce::KeyPress& key)
 {
     if (key == juce::KeyPress::spaceKey)
     {
-        if (layers.isEmpty())
+        if (engine.getNumLayers() == 0)
             return true;
 
         if (isPlaying())
@@ -225,30 +553,35 @@ bool MainComponent::keyPressed(const juce::KeyPress& key)
         return true;
     }
 
+    if (key == juce::KeyPress::homeKey)
+    {
+        // Back to the top of every loop, on the same sample for all layers
+        engine.seek(0.0);
+        return true;
+    }
+
     return false;
 }
 
 void MainComponent::startPlayback()
 {
-    for (auto* layer : layers)
-        layer->startPlayback();
+    engine.start();
 }
 
 void MainComponent::stopPlayback()
 {
-    for (auto* layer : layers)
-        layer->stopPlayback();
+    engine.stop();
 }
 
 void MainComponent::savePreset()
 {
-    if (layers.isEmpty())
+    if (engine.getNumLayers() == 0)
         return;
 
     fileChooser = std::make_unique<juce::FileChooser>(
         "Save Preset...",
         juce::File{},
-        "*.json");
+        "*.json;*.dremscape");
 
     auto chooserFlags = juce::FileBrowserComponent::saveMode
                       | juce::FileBrowserComponent::canSelectFiles;
@@ -259,44 +592,50 @@ void MainComponent::savePreset()
         if (file == juce::File{})
             return;
 
-        juce::Array<juce::var> layersArray;
-
-        for (auto* layer : layers)
+        Preset preset;
+        preset.masterVolume = static_cast<float>(masterVolumeKnob.getValue());
+        preset.hpfCutoff = static_cast<float>(hpfCutoffKnob.getValue());
+        preset.lowShelfGain = static_cast<float>(lowShelfKnob.getValue());
+        preset.highShelfGain = static_cast<float>(highShelfKnob.getValue());
+        preset.lpfCutoff = static_cast<float>(lpfCutoffKnob.getValue());
+        preset.targetLoudness = targetLoudnessKnob.getValue();
+        preset.reverbImpulse = engine.getRoomImpulse();
+        preset.reverbWet = static_cast<float>(roomWetKnob.getValue());
+        preset.fadeInSeconds = engine.getTransport().getFadeInSeconds();
+        preset.fadeOutSeconds = engine.getTransport().getFadeOutSeconds();
+        preset.startGridSeconds = engine.getTransport().getStartGrid();
+
+        for (int i = 0; i < engine.getNumLayers(); ++i)
+            preset.layers.push_back(engine.getLayer(i)->describe());
+
+        // A bundle takes the audio along, for opening on another machine
+        if (file.hasFileExtension(SoundscapeBundle::kFileExtension))
         {
-            auto* layerObj = new juce::DynamicObject();
-            layerObj->setProperty("filePath", layer->getFilePath().getFullPathName());
-
-            if (auto* loop = layer->getLoopingSource())
+            engine.saveBundle(file, preset, [this, file](bool saved)
             {
-                layerObj->setProperty("loopStart", loop->getLoopStart());
-                layerObj->setProperty("loopEnd", loop->getLoopEnd());
-                layerObj->setProperty("crossfadeSamples", loop->getCrossfadeSamples());
-            }
-
-            layerObj->setProperty("crossfadeCurveX", static_cast<double>(layer->getCrossfadeCurveX()));
-            layerObj->setProperty("crossfadeCurveY", static_cast<double>(layer->getCrossfadeCurveY()));
-            layerObj->setProperty("volume", static_cast<double>(layer->getVolume()));
-
-            layersArray.add(juce::var(layerObj));
+                if (!saved)
+                    showSaveFailed(file);
+            });
+        }
+        else if (!preset.save(file))
+        {
+            showSaveFailed(file);
         }
-
-        auto* preset = new juce::DynamicObject();
-        preset->setProperty("version", 1);
-        preset->setProperty("masterVolume", masterVolumeKnob.getValue());
-        preset->setProperty("hpfCutoff", hpfCutoffKnob.getValue());
-        preset->setProperty("layers", juce::var(layersArray));
-
-        auto jsonString = juce::JSON::toString(juce::var(preset));
-        file.replaceWithText(jsonString);
     });
 }
 
+void MainComponent::showSaveFailed(const juce::File& file)
+{
+    juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Save Preset",
+                                           "Couldn't write " + file.getFullPathName());
+}
+
 void MainComponent::loadPreset()
 {
     fileChooser = std::make_unique<juce::FileChooser>(
         "Load Preset...",
         juce::File{},
-        "*.json");
+        "*.json;*.dremscape");
 
     auto chooserFlags = juce::FileBrowserComponent::openMode
                       | juce::FileBrowserComponent::canSelectFiles;
@@ -307,84 +646,56 @@ void MainComponent::loadPreset()
         if (!file.existsAsFile())
             return;
 
-        auto jsonText = file.loadFileAsString();
-        auto parsed = juce::JSON::parse(jsonText);
+        Preset preset;
+        std::shared_ptr<const SoundscapeBundle> bundle;
 
-        if (!parsed.isObject())
-            return;
-
-        auto* obj = parsed.getDynamicObject();
-        if (obj == nullptr)
-            return;
-
-        if (obj->hasProperty("masterVolume"))
+        if (file.hasFileExtension(SoundscapeBundle::kFileExtension))
         {
-            auto mv = static_cast<float>(static_cast<double>(obj->getProperty("masterVolume")));
-            masterVolumeKnob.setValue(static_cast<double>(mv), juce::dontSendNotification);
-            audioSourcePlayer.setGain(mv);
-        }
+            bundle = std::make_shared<const SoundscapeBundle>(file);
+            if (!bundle->isValid())
+                return;
 
-        {
-            auto cutoff = obj->hasProperty("hpfCutoff")
-                ? static_cast<float>(static_cast<double>(obj->getProperty("hpfCutoff")))
-                : 20.0f;
-            hpfCutoffKnob.setValue(static_cast<double>(cutoff), juce::dontSendNotification);
-            filteredOutput.setCutoffFrequency(cutoff);
+            preset = bundle->getPreset();
         }
-
-        auto layersVar = obj->getProperty("layers");
-        auto* layersArray = layersVar.getArray();
-        if (layersArray == nullptr || layersArray->isEmpty())
+        else if (!Preset::load(file, preset))
+        {
             return;
+        }
 
-        // Clear existing layers
-        for (auto* layer : layers)
+        // The engine gets what the knobs accept, so out-of-range presets are
+        // clamped once
+        auto restoreKnob = [](juce::Slider& knob, double value)
         {
-            layer->stopPlayback();
-            mixer.removeInputSource(&layer->getTransportSource());
-            layerContainer.removeChildComponent(layer);
+            knob.setValue(value, juce::dontSendNotification);
+            return knob.getValue();
+        };
+
+        preset.masterVolume = static_cast<float>(restoreKnob(masterVolumeKnob, preset.masterVolume));
+        preset.hpfCutoff = static_cast<float>(restoreKnob(hpfCutoffKnob, preset.hpfCutoff));
+        preset.lowShelfGain = static_cast<float>(restoreKnob(lowShelfKnob, preset.lowShelfGain));
+        preset.highShelfGain = static_cast<float>(restoreKnob(highShelfKnob, preset.highShelfGain));
+        preset.lpfCutoff = static_cast<float>(restoreKnob(lpfCutoffKnob, preset.lpfCutoff));
+        preset.targetLoudness = restoreKnob(targetLoudnessKnob, preset.targetLoudness);
+        preset.reverbWet = static_cast<float>(restoreKnob(roomWetKnob, preset.reverbWet));
+
+        if (preset.layers.empty())
+        {
+            engine.applyMasterSettings(preset);
+            return;
         }
-        layers.clear();
 
-        // Load each layer from preset
+        // The engine skips loops whose file has moved; those are asked about
+        // one at a time once the rest are playing
         pendingMissingLayers.clear();
         pendingLayerIndex = 0;
 
-        for (const auto& layerVar : *layersArray)
-        {
-            auto* layerObj = layerVar.getDynamicObject();
-            if (layerObj == nullptr)
-                continue;
-
-            auto filePath = layerObj->getProperty("filePath").toString();
-            auto loopStart = static_cast<juce::int64>(layerObj->getProperty("loopStart"));
-            auto loopEnd = static_cast<juce::int64>(layerObj->getProperty("loopEnd"));
-            auto crossfadeSamples = static_cast<int>(layerObj->getProperty("crossfadeSamples"));
-
-            auto curveX = layerObj->hasProperty("crossfadeCurveX")
-                ? static_cast<float>(static_cast<double>(layerObj->getProperty("crossfadeCurveX")))
-                : 0.25f;
-            auto curveY = layerObj->hasProperty("crossfadeCurveY")
-                ? static_cast<float>(static_cast<double>(layerObj->getProperty("crossfadeCurveY")))
-                : 0.75f;
-
-            auto volume = layerObj->hasProperty("volume")
-                ? static_cast<float>(static_cast<double>(layerObj->getProperty("volume")))
-                : 1.0f;
-
-            juce::File audioFile(filePath);
-            if (audioFile.existsAsFile())
-            {
-                addLayer(audioFile, loopStart, loopEnd, crossfadeSamples, curveX, curveY, volume);
-            }
-            else
-            {
-                pendingMissingLayers.push_back({ filePath, loopStart, loopEnd,
-                                                  crossfadeSamples, curveX, curveY, volume });
-            }
-        }
+        for (const auto& layer : preset.layers)
+            if (layer.kind == PresetLayer::Kind::Loop && !layer.files.getFirst().existsAsFile()
+                && (bundle == nullptr || bundle->findAudio(layer.files.getFirst()) == nullptr))
+                pendingMissingLayers.push_back(layer);
 
-        juce::MessageManager::callAsync([this]() { processNextMissingLayer(); });
+        // The current scene, and its views, stay until showScene()
+        engine.loadPreset(preset, SoundscapeEngine::kDefaultSceneFadeSeconds, bundle);
     });
 }
 
@@ -400,14 +711,15 @@ void MainComponent::processNextMissingLayer()
 
     const auto& pending = pendingMissingLayers[static_cast<size_t>(pendingLayerIndex)];
 
-    juce::File startDir = juce::File(pending.originalPath).getParentDirectory();
+    const auto original = pending.files.getFirst();
+    juce::File startDir = original.getParentDirectory();
     if (!startDir.isDirectory())
         startDir = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory);
 
     missingFileChooser = std::make_unique<juce::FileChooser>(
-        "Missing: " + juce::File(pending.originalPath).getFileName() + " — Locate or Cancel to skip",
+        "Missing: " + original.getFileName() + " — Locate or Cancel to skip",
         startDir,
-        formatManager.getWildcardForAllFormats());
+        engine.getFormatManager().getWildcardForAllFormats());
 
     auto chooserFlags = juce::FileBrowserComponent::openMode
                       | juce::FileBrowserComponent::canSelectFiles;
@@ -417,9 +729,9 @@ void MainComponent::processNextMissingLayer()
         auto chosen = chooser.getResult();
         if (chosen.existsAsFile())
         {
-            const auto& layer = pendingMissingLayers[static_cast<size_t>(pendingLayerIndex)];
-            addLayer(chosen, layer.loopStart, layer.loopEnd,
-                     layer.crossfadeSamples, layer.curveX, layer.curveY, layer.volume);
+            auto located = pendingMissingLayers[static_cast<size_t>(pendingLayerIndex)];
+            located.files = { chosen };
+            addLayer(located);
         }
 
         ++pendingLayerIndex;
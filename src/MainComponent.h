@@ -1,8 +1,10 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "SoundscapeEngine.h"
 #include "SoundLayer.h"
-#include "FilteredAudioSource.h"
+#include "LevelMeter.h"
+#include "SpectrumDisplay.h"
 
 class MainComponent : public juce::Component
 {
@@ -13,34 +15,53 @@ public:
     void resized() override;
     bool keyPressed(const juce::KeyPress& key) override;
 
+    // Called by the window so nothing redraws while it can't be seen
+    void setWindowState(bool isMinimised, bool isActive);
+
 private:
     bool isPlaying() const;
     void addFiles();
-    void addLayer(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
-                  int crossfadeSamples = 0, float curveX = 0.25f, float curveY = 0.75f,
-                  float volume = 1.0f);
+    void addSequence();
+    void addEvents();
+    void addLayer(const PresetLayer& settings);
+    void showScene();
     void removeLayer(SoundLayer* layer);
+    void findLoopPoint(SoundLayer* layer);
+    SoundLayer* createView(EngineLayer& engineLayer);
+    SoundLayer* findView(const EngineLayer* engineLayer) const;
+    void showRoomMenu();
+    void updateRoomButton();
+    void setRenderAhead(bool shouldRenderAhead);
+    void setLowPower(bool shouldSavePower);
+    void updateDeviceLatency();
+    void updateAnimation();
     void layoutLayers();
+    void updateVisibleLayers();
+    void enableTransport(bool hasLayers);
     void startPlayback();
     void stopPlayback();
     void savePreset();
+    void showSaveFailed(const juce::File& file);
     void loadPreset();
+    void setupKnob(juce::Slider& knob, juce::Label& label, double min, double max,
+                   double interval, double defaultValue, std::function<void(double)> onChange);
 
-    // Audio infrastructure
+    // The engine makes all the sound; this component plays it and shows it
+    SoundscapeEngine engine;
     juce::AudioDeviceManager deviceManager;
-    juce::AudioFormatManager formatManager;
-    juce::TimeSliceThread readAheadThread { "audio-read-ahead" };
-
-    // Mixer, filter, and player
-    juce::MixerAudioSource mixer;
-    FilteredAudioSource filteredOutput { &mixer };
     juce::AudioSourcePlayer audioSourcePlayer;
 
-    // Layers
-    juce::OwnedArray<SoundLayer> layers;
+    // Views only for the engine layers scrolled into sight, in no order; a
+    // row's view is made when it comes into the viewport and deleted when it
+    // leaves, so a scene of hundreds of layers costs a screenful of
+    // components.  The cache keeps their waveforms between visits.
+    juce::OwnedArray<SoundLayer> layerViews;
+    juce::AudioThumbnailCache thumbnailCache { kThumbnailCacheSize };
 
     // GUI
     juce::TextButton addFileButton    { "Add File" };
+    juce::TextButton addSequenceButton { "Add Sequence" };
+    juce::TextButton addEventsButton  { "Add Events" };
     juce::TextButton savePresetButton { "Save Preset" };
     juce::TextButton loadPresetButton { "Load Preset" };
     juce::TextButton playButton       { "Play" };
@@ -49,32 +70,64 @@ private:
     juce::Slider hpfCutoffKnob;
     juce::Label hpfCutoffLabel { {}, "HPF" };
 
+    juce::Slider lowShelfKnob;
+    juce::Label lowShelfLabel { {}, "Low" };
+
+    juce::Slider highShelfKnob;
+    juce::Label highShelfLabel { {}, "High" };
+
+    juce::Slider lpfCutoffKnob;
+    juce::Label lpfCutoffLabel { {}, "LPF" };
+
+    juce::Slider targetLoudnessKnob;
+    juce::Label targetLoudnessLabel { {}, "LUFS" };
+
     juce::Slider masterVolumeKnob;
     juce::Label masterVolumeLabel { {}, "Master" };
 
-    juce::Viewport viewport;
-    juce::Component layerContainer;
+    juce::ToggleButton renderAheadButton { "Render ahead" };
+    juce::ToggleButton lowPowerButton { "Low power" };
+    juce::TextButton roomButton { "Room..." };
+    juce::Slider roomWetKnob;
+    juce::Label roomWetLabel { {}, "Room" };
 
-    std::unique_ptr<juce::FileChooser> fileChooser;
-    std::unique_ptr<juce::FileChooser> missingFileChooser;
+    SpectrumDisplay spectrumDisplay { engine.getMasterTap() };
+    LevelMeter masterMeter { engine.getMasterTap() };
+
+    // Low power: the buffer size to go back to, and what the window is doing
+    bool lowPower = false;
+    int normalBufferSize = 0;
+    bool windowMinimised = false;
+    bool windowActive = true;
+    bool animating = true;
 
-    struct PendingLayer
+    // Tells us on every scroll, not just when the scrollbars move
+    struct LayerViewport : public juce::Viewport
     {
-        juce::String originalPath;
-        juce::int64 loopStart;
-        juce::int64 loopEnd;
-        int crossfadeSamples;
-        float curveX;
-        float curveY;
-        float volume;
+        void visibleAreaChanged(const juce::Rectangle<int>&) override
+        {
+            if (onVisibleAreaChanged != nullptr)
+                onVisibleAreaChanged();
+        }
+
+        std::function<void()> onVisibleAreaChanged;
     };
 
-    std::vector<PendingLayer> pendingMissingLayers;
+    LayerViewport viewport;
+    juce::Component layerContainer;
+
+    std::unique_ptr<juce::FileChooser> fileChooser;
+    std::unique_ptr<juce::FileChooser> missingFileChooser;
+
+    // Loop layers whose file has moved, asked about one at a time
+    std::vector<PresetLayer> pendingMissingLayers;
     int pendingLayerIndex = 0;
 
     void processNextMissingLayer();
 
     static constexpr int layerHeight = 188;
+    static constexpr int kOverscanRows = 1;
+    static constexpr int kThumbnailCacheSize = 64;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MainComponent)
 };
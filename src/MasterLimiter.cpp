@@ -0,0 +1,201 @@
+#include "MasterLimiter.h"
+#include <cmath>
+
+MasterLimiter::MasterLimiter(juce::AudioSource* inputSource, EngineTransport& engineTransport)
+    : input(inputSource),
+      transport(engineTransport)
+{
+    buildInterpolator();
+}
+
+void MasterLimiter::buildInterpolator()
+{
+    // Hann-windowed sinc for the points a quarter, half and three quarters of
+    // the way from the detector's centre sample to the next one
+    constexpr int centre = kDetectorDelay - 1;
+    constexpr double halfSpan = kTaps / 2.0;
+
+    for (int k = 1; k < kOversampling; ++k)
+    {
+        auto& phase = phases[static_cast<size_t>(k - 1)];
+        const double frac = static_cast<double>(k) / kOversampling;
+        double sum = 0.0;
+
+        for (int m = 0; m < kTaps; ++m)
+        {
+            const double d = static_cast<double>(m - centre) - frac;
+            const double sinc = std::abs(d) < 1.0e-9 ? 1.0
+                                                     : std::sin(juce::MathConstants<double>::pi * d)
+                                                         / (juce::MathConstants<double>::pi * d);
+            const double window = std::abs(d) < halfSpan
+                                ? 0.5 * (1.0 + std::cos(juce::MathConstants<double>::pi * d / halfSpan))
+                                : 0.0;
+
+            phase[static_cast<size_t>(m)] = static_cast<float>(sinc * window);
+            sum += sinc * window;
+        }
+
+        for (auto& tap : phase)
+            tap = static_cast<float>(tap / sum);
+    }
+}
+
+void MasterLimiter::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    currentSampleRate = sampleRate;
+    input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+
+    lookaheadSamples = juce::jmax(1, juce::roundToInt(kLookaheadSeconds * sampleRate));
+    latencySamples = lookaheadSamples + kDetectorDelay;
+    releaseCoeff = static_cast<float>(std::exp(-1.0 / (kReleaseSeconds * sampleRate)));
+
+    delayLine.setSize(kMaxChannels, latencySamples);
+    delayLine.clear();
+    delayPos = 0;
+
+    for (auto& channel : history)
+        channel.fill(0.0f);
+    historyPos = 0;
+
+    // Holds every peak for lookahead + 1 samples, plus room for the newest
+    const int capacity = juce::nextPowerOfTwo(lookaheadSamples + 2);
+    windowTimes.assign(static_cast<size_t>(capacity), 0);
+    windowPeaks.assign(static_cast<size_t>(capacity), 0.0f);
+    windowMask = capacity - 1;
+    windowFront = 0;
+    windowSize = 0;
+    sampleClock = 0;
+
+    boxRing.assign(static_cast<size_t>(lookaheadSamples), 1.0f);
+    boxSum = static_cast<double>(lookaheadSamples);
+    boxPos = 0;
+    envelope = 1.0f;
+
+    smoothedGain.reset(sampleRate, 0.02);
+    smoothedGain.setCurrentAndTargetValue(masterGain.load());
+
+    transport.setOutputLatency(static_cast<double>(latencySamples) / sampleRate);
+
+    if (auto* tap = outputTap.load())
+        tap->setSampleRate(sampleRate);
+}
+
+void MasterLimiter::releaseResources()
+{
+    input->releaseResources();
+}
+
+float MasterLimiter::detectTruePeak(int channel, float sample)
+{
+    auto& h = history[static_cast<size_t>(channel)];
+    h[static_cast<size_t>(historyPos)] = sample;
+
+    // Oldest-first tap m lives at historyPos + 1 + m in the ring
+    auto tap = [&h, this](int m) { return h[static_cast<size_t>((historyPos + 1 + m) % kTaps)]; };
+
+    float peak = std::abs(tap(kDetectorDelay - 1));
+
+    for (const auto& phase : phases)
+    {
+        float y = 0.0f;
+        for (int m = 0; m < kTaps; ++m)
+            y += phase[static_cast<size_t>(m)] * tap(m);
+
+        peak = juce::jmax(peak, std::abs(y));
+    }
+
+    return peak;
+}
+
+void MasterLimiter::pushWindowPeak(float peak)
+{
+    // Quieter entries behind a new peak can never be the maximum again
+    while (windowSize > 0
+           && windowPeaks[static_cast<size_t>((windowFront + windowSize - 1) & windowMask)] <= peak)
+        --windowSize;
+
+    const auto back = static_cast<size_t>((windowFront + windowSize) & windowMask);
+    windowTimes[back] = sampleClock;
+    windowPeaks[back] = peak;
+    ++windowSize;
+
+    // Expire the front once it has been held for lookahead + 1 samples
+    const auto oldest = sampleClock - lookaheadSamples;
+    while (windowTimes[static_cast<size_t>(windowFront)] < oldest)
+    {
+        windowFront = (windowFront + 1) & windowMask;
+        --windowSize;
+    }
+}
+
+void MasterLimiter::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    input->getNextAudioBlock(bufferToFill);
+
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+
+    const int numChannels = juce::jmin(bufferToFill.buffer->getNumChannels(), kMaxChannels);
+    const float ceiling = juce::Decibels::decibelsToGain(ceilingDb.load());
+    float minGain = 1.0f;
+
+    smoothedGain.setTargetValue(masterGain.load());
+
+    std::array<float*, kMaxChannels> channels {};
+    for (int ch = 0; ch < numChannels; ++ch)
+        channels[static_cast<size_t>(ch)] = bufferToFill.buffer->getWritePointer(ch, bufferToFill.startSample);
+
+    for (int i = 0; i < bufferToFill.numSamples; ++i)
+    {
+        const float inputGain = smoothedGain.getNextValue();
+        float peak = 0.0f;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto& sample = channels[static_cast<size_t>(ch)][i];
+            sample *= inputGain;
+            peak = juce::jmax(peak, detectTruePeak(ch, sample));
+        }
+
+        historyPos = (historyPos + 1) % kTaps;
+
+        pushWindowPeak(peak);
+        const float held = windowPeaks[static_cast<size_t>(windowFront)];
+        const float target = held > ceiling ? ceiling / held : 1.0f;
+
+        // Instant attack into the smoother, exponential recovery out of it
+        envelope = target < envelope ? target : target + (envelope - target) * releaseCoeff;
+
+        boxSum += static_cast<double>(envelope - boxRing[static_cast<size_t>(boxPos)]);
+        boxRing[static_cast<size_t>(boxPos)] = envelope;
+        boxPos = (boxPos + 1) % lookaheadSamples;
+
+        const float gain = static_cast<float>(boxSum / lookaheadSamples);
+        minGain = juce::jmin(minGain, gain);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            auto* line = delayLine.getWritePointer(ch);
+            auto& sample = channels[static_cast<size_t>(ch)][i];
+
+            const float delayed = line[delayPos];
+            line[delayPos] = sample;
+            sample = delayed * gain;
+        }
+
+        delayPos = (delayPos + 1) % latencySamples;
+        ++sampleClock;
+    }
+
+    reductionDb.store(juce::Decibels::gainToDecibels(minGain));
+
+    if (auto* tap = outputTap.load())
+        tap->push(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, numChannels);
+
+    if (bufferToFill.numSamples > 0)
+    {
+        const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const double budget = bufferToFill.numSamples / currentSampleRate;
+        const auto load = static_cast<float>(elapsed / budget);
+        cpuLoad.store(cpuLoad.load() + 0.05f * (load - cpuLoad.load()));
+    }
+}
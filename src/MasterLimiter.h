@@ -0,0 +1,96 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include "EngineTransport.h"
+#include "AnalysisTap.h"
+
+// Lookahead true-peak limiter for the master output.
+//
+// Peaks are estimated between samples with a 4x polyphase interpolator, and
+// the loudest one inside the lookahead window is tracked with a monotonic
+// deque, so the window maximum costs O(1) per sample whatever its length.
+// Gain drops instantly to the level the window needs, recovers
+// exponentially, and is box-smoothed over the lookahead so the attack is a
+// ramp that lands exactly on the peak.  The lookahead is reported to the
+// EngineTransport so playheads can show what is audible.
+class MasterLimiter : public juce::AudioSource
+{
+public:
+    MasterLimiter(juce::AudioSource* input, EngineTransport& transport);
+
+    // Master volume is applied ahead of the detector so it can't push past the ceiling
+    void setMasterGain(float gain) { masterGain.store(gain); }
+
+    void setCeilingDecibels(float decibels) { ceilingDb.store(decibels); }
+    float getCeilingDecibels() const { return ceilingDb.load(); }
+
+    int getLatencySamples() const { return latencySamples; }
+    float getGainReductionDecibels() const { return reductionDb.load(); }
+
+    // Fraction of the block's real-time budget spent in the limiter, smoothed
+    float getCpuLoad() const { return cpuLoad.load(); }
+
+    // Receives the limited output for metering; may be null
+    void setOutputTap(AnalysisTap* tap) { outputTap.store(tap); }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+private:
+    static constexpr int kMaxChannels = 8;
+    static constexpr int kOversampling = 4;
+    static constexpr int kTaps = 8;
+    static constexpr int kDetectorDelay = kTaps / 2;
+
+    void buildInterpolator();
+    float detectTruePeak(int channel, float input);
+    void pushWindowPeak(float peak);
+
+    juce::AudioSource* input;
+    EngineTransport& transport;
+
+    // Interpolation filters for the three in-between phases
+    std::array<std::array<float, kTaps>, kOversampling - 1> phases {};
+
+    // Per-channel detector history and output delay line
+    std::array<std::array<float, kTaps>, kMaxChannels> history {};
+    int historyPos = 0;
+    juce::AudioBuffer<float> delayLine;
+    int delayPos = 0;
+
+    // Monotonic deque over (time, peak), oldest and loudest at the front
+    std::vector<juce::int64> windowTimes;
+    std::vector<float> windowPeaks;
+    int windowFront = 0;
+    int windowSize = 0;
+    int windowMask = 0;
+    juce::int64 sampleClock = 0;
+
+    // Box smoother over the lookahead
+    std::vector<float> boxRing;
+    double boxSum = 0.0;
+    int boxPos = 0;
+
+    double currentSampleRate = 44100.0;
+    int lookaheadSamples = 1;
+    int latencySamples = 0;
+    float releaseCoeff = 0.0f;
+    float envelope = 1.0f;
+    juce::SmoothedValue<float> smoothedGain;
+
+    std::atomic<float> masterGain { 1.0f };
+    std::atomic<float> ceilingDb { -1.0f };
+    std::atomic<float> reductionDb { 0.0f };
+    std::atomic<float> cpuLoad { 0.0f };
+    std::atomic<AnalysisTap*> outputTap { nullptr };
+
+    static constexpr double kLookaheadSeconds = 0.0015;
+    static constexpr double kReleaseSeconds = 0.1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MasterLimiter)
+};
@@ -0,0 +1,260 @@
+#include "OneShotEventSource.h"
+#include "SoundscapeBundle.h"
+
+OneShotEventSource::OneShotEventSource(juce::AudioFormatManager& formatManager, const juce::Array<juce::File>& fileList,
+                                       const SoundscapeBundle* bundle)
+    : files(fileList),
+      rewindStates(static_cast<size_t>(kRewindSlots))
+{
+    samples.reserve(static_cast<size_t>(files.size()));
+
+    for (const auto& file : files)
+    {
+        if (auto* embedded = bundle != nullptr ? bundle->findAudio(file) : nullptr)
+        {
+            const auto length = static_cast<int>(juce::jmin(embedded->totalLength,
+                                                            static_cast<juce::int64>(kMaxSampleSeconds * embedded->sampleRate)));
+            if (length <= 0)
+                continue;
+
+            Sample sample;
+            sample.sampleRate = embedded->sampleRate;
+            sample.data.setSize(juce::jlimit(1, 2, embedded->numChannels), length);
+            embedded->read(sample.data, 0, length, 0);
+            samples.push_back(std::move(sample));
+            continue;
+        }
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+        if (reader == nullptr || reader->lengthInSamples <= 0 || reader->sampleRate <= 0.0)
+            continue;
+
+        const auto length = static_cast<int>(juce::jmin(reader->lengthInSamples,
+                                                        static_cast<juce::int64>(kMaxSampleSeconds * reader->sampleRate)));
+        const int numChannels = juce::jlimit(1, 2, static_cast<int>(reader->numChannels));
+
+        Sample sample;
+        sample.sampleRate = reader->sampleRate;
+        sample.data.setSize(numChannels, length);
+        reader->read(&sample.data, 0, length, 0, true, numChannels > 1);
+        samples.push_back(std::move(sample));
+    }
+}
+
+void OneShotEventSource::prepareToPlay(int, double sampleRate)
+{
+    deviceRate = sampleRate;
+}
+
+void OneShotEventSource::setNextReadPosition(juce::int64 newPosition)
+{
+    position.store(newPosition);
+
+    // Back to the top replays the scene; anywhere else just carries on
+    if (newPosition == 0)
+        resetPending.store(true);
+}
+
+void OneShotEventSource::saveRewindState(int slot)
+{
+    rewindStates[static_cast<size_t>(slot)] = { active, activeVersion, hasActive, random, voices,
+                                                samplesUntilNext, deferredTrigger, lastSample, voiceClock };
+}
+
+bool OneShotEventSource::restoreRewindState(int slot)
+{
+    const auto& saved = rewindStates[static_cast<size_t>(slot)];
+    active = saved.active;
+    activeVersion = saved.activeVersion;
+    hasActive = saved.hasActive;
+    random = saved.random;
+    voices = saved.voices;
+    samplesUntilNext = saved.samplesUntilNext;
+    deferredTrigger = saved.deferredTrigger;
+    lastSample = saved.lastSample;
+    voiceClock = saved.voiceClock;
+    return true;
+}
+
+bool OneShotEventSource::refreshSettings()
+{
+    Settings latest;
+    std::uint32_t version = 0;
+
+    if (!settings.tryRead(latest, version))
+        return false;
+
+    if (hasActive && version == activeVersion)
+        return false;
+
+    // A new seed restarts the sequence; other edits keep it going
+    if (!hasActive || latest.seed != active.seed)
+        random.setSeed(latest.seed);
+
+    active = latest;
+    activeVersion = version;
+    hasActive = true;
+    return true;
+}
+
+juce::int64 OneShotEventSource::drawInterval()
+{
+    if (active.eventsPerMinute <= 0.0f)
+        return std::numeric_limits<juce::int64>::max();
+
+    // Exponential gaps make a Poisson process: no audible pulse at any rate
+    const double meanSeconds = 60.0 / static_cast<double>(active.eventsPerMinute);
+    const double seconds = juce::jmax(kMinGapSeconds, -std::log(1.0 - random.nextDouble()) * meanSeconds);
+    return juce::jmax(static_cast<juce::int64>(1), static_cast<juce::int64>(seconds * deviceRate));
+}
+
+void OneShotEventSource::trigger()
+{
+    Voice* target = nullptr;
+    Voice* oldest = nullptr;
+    bool releasing = false;
+
+    for (auto& voice : voices)
+    {
+        if (voice.sample == nullptr)
+        {
+            target = &voice;
+            break;
+        }
+
+        if (voice.releaseRemaining >= 0)
+            releasing = true;
+        else if (oldest == nullptr || static_cast<std::int32_t>(voice.startedAt - oldest->startedAt) < 0)
+            oldest = &voice;
+    }
+
+    if (target == nullptr)
+    {
+        // Fade the oldest out rather than cut it, and start once a voice
+        // frees.  One already fading will do, so retries don't steal more.
+        if (oldest != nullptr && !releasing)
+            oldest->releaseRemaining = kReleaseSamples;
+
+        deferredTrigger = true;
+        return;
+    }
+
+    deferredTrigger = false;
+
+    // Avoid playing the same sample twice running when there is a choice
+    const int numSamples = static_cast<int>(samples.size());
+    int index = random.nextInt(numSamples);
+    if (numSamples > 1 && index == lastSample)
+        index = (index + 1 + random.nextInt(numSamples - 1)) % numSamples;
+    lastSample = index;
+
+    const float gain = juce::Decibels::decibelsToGain(-random.nextFloat() * juce::jmax(0.0f, active.gainJitterDb));
+    const float pan = (random.nextFloat() * 2.0f - 1.0f) * juce::jlimit(0.0f, 1.0f, active.panSpread);
+    const float angle = (pan + 1.0f) * juce::MathConstants<float>::pi * 0.25f;
+
+    const auto& sample = samples[static_cast<size_t>(index)];
+    target->sample = &sample;
+    target->readPos = 0.0;
+    target->increment = sample.sampleRate / deviceRate;
+    target->gainLeft = gain * std::cos(angle) * juce::MathConstants<float>::sqrt2;
+    target->gainRight = gain * std::sin(angle) * juce::MathConstants<float>::sqrt2;
+    target->releaseRemaining = -1;
+    target->startedAt = voiceClock++;
+
+    triggers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void OneShotEventSource::renderVoices(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    auto* left = buffer.getWritePointer(0, startSample);
+    auto* right = buffer.getNumChannels() > 1 ? buffer.getWritePointer(1, startSample) : nullptr;
+
+    for (auto& voice : voices)
+    {
+        if (voice.sample == nullptr)
+            continue;
+
+        const auto& data = voice.sample->data;
+        const auto* srcLeft = data.getReadPointer(0);
+        const auto* srcRight = data.getReadPointer(data.getNumChannels() - 1);
+        const double lastIndex = static_cast<double>(data.getNumSamples() - 1);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            if (voice.readPos >= lastIndex || voice.releaseRemaining == 0)
+            {
+                voice.sample = nullptr;
+                break;
+            }
+
+            float envelope = 1.0f;
+            if (voice.releaseRemaining > 0)
+                envelope = static_cast<float>(voice.releaseRemaining--) / static_cast<float>(kReleaseSamples);
+
+            const auto index = static_cast<int>(voice.readPos);
+            const auto frac = static_cast<float>(voice.readPos - index);
+            const float l = srcLeft[index] + frac * (srcLeft[index + 1] - srcLeft[index]);
+            const float r = srcRight[index] + frac * (srcRight[index + 1] - srcRight[index]);
+
+            if (right != nullptr)
+            {
+                left[i] += l * voice.gainLeft * envelope;
+                right[i] += r * voice.gainRight * envelope;
+            }
+            else
+            {
+                left[i] += 0.5f * (l * voice.gainLeft + r * voice.gainRight) * envelope;
+            }
+
+            voice.readPos += voice.increment;
+        }
+    }
+}
+
+void OneShotEventSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    bufferToFill.clearActiveBufferRegion();
+
+    if (samples.empty() || bufferToFill.buffer->getNumChannels() == 0)
+        return;
+
+    if (resetPending.exchange(false))
+    {
+        refreshSettings();
+        random.setSeed(active.seed);
+        samplesUntilNext = drawInterval();
+    }
+    else if (refreshSettings())
+    {
+        // The pending gap was drawn at the old rate
+        samplesUntilNext = drawInterval();
+    }
+
+    int done = 0;
+    while (done < bufferToFill.numSamples)
+    {
+        const auto segment = static_cast<int>(juce::jmin(static_cast<juce::int64>(bufferToFill.numSamples - done),
+                                                         samplesUntilNext));
+        renderVoices(*bufferToFill.buffer, bufferToFill.startSample + done, segment);
+
+        done += segment;
+        samplesUntilNext -= segment;
+
+        if (deferredTrigger)
+            trigger();
+
+        if (samplesUntilNext <= 0)
+        {
+            trigger();
+            samplesUntilNext = drawInterval();
+        }
+    }
+
+    int playing = 0;
+    for (const auto& voice : voices)
+        if (voice.sample != nullptr)
+            ++playing;
+
+    activeVoices.store(playing, std::memory_order_relaxed);
+    position.fetch_add(bufferToFill.numSamples, std::memory_order_relaxed);
+}
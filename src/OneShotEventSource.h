@@ -0,0 +1,129 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <vector>
+#include "RewindableSource.h"
+#include "SeqLock.h"
+
+class SoundscapeBundle;
+
+// Fires preloaded one-shot samples at random intervals.
+//
+// Samples are decoded into memory when the layer is created, or copied out
+// of a bundle that embeds them, and played by a fixed pool of voices.
+// Timing, gain and pan come from a seeded generator evaluated on the audio
+// thread, which never allocates or locks: settings
+// arrive through a SeqLock, and a trigger either takes a free voice or
+// releases the oldest one and starts as soon as it has faded.
+//
+// Seeking back resets the generator, so a scene replays the same events.
+// A rewind puts back the voices and the generator as they were, so the
+// blocks rendered again play the same one-shots as before.
+class OneShotEventSource : public juce::PositionableAudioSource,
+                           public RewindableSource
+{
+public:
+    struct Settings
+    {
+        float eventsPerMinute = 6.0f;   // mean rate; intervals are exponential
+        float gainJitterDb = 6.0f;      // each event is cut by up to this much
+        float panSpread = 0.5f;         // 0 keeps events centred, 1 uses the whole field
+        juce::int64 seed = 1;
+    };
+
+    OneShotEventSource(juce::AudioFormatManager& formatManager, const juce::Array<juce::File>& files,
+                       const SoundscapeBundle* bundle = nullptr);
+
+    bool isValid() const { return !samples.empty(); }
+    const juce::Array<juce::File>& getFiles() const { return files; }
+
+    void setSettings(const Settings& newSettings) { settings.write(newSettings); }
+    Settings getSettings() const { return settings.read(); }
+
+    int getActiveVoiceCount() const { return activeVoices.load(); }
+    int getTriggerCount() const { return triggers.load(); }
+
+    // PositionableAudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override {}
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override { return position.load(); }
+    juce::int64 getTotalLength() const override { return std::numeric_limits<juce::int64>::max(); }
+    bool isLooping() const override { return true; }
+
+    // RewindableSource overrides
+    void saveRewindState(int slot) override;
+    bool restoreRewindState(int slot) override;
+
+    static constexpr int kMaxVoices = 32;
+    static constexpr double kMaxSampleSeconds = 30.0;
+
+private:
+    struct Sample
+    {
+        juce::AudioBuffer<float> data;
+        double sampleRate = 44100.0;
+    };
+
+    struct Voice
+    {
+        const Sample* sample = nullptr;
+        double readPos = 0.0;
+        double increment = 1.0;
+        float gainLeft = 0.0f;
+        float gainRight = 0.0f;
+        int releaseRemaining = -1;   // counting down once stolen
+        juce::uint32 startedAt = 0;
+    };
+
+    // Everything below that the audio thread changes as it plays
+    struct RewindState
+    {
+        Settings active;
+        std::uint32_t activeVersion = 0;
+        bool hasActive = false;
+        juce::Random random;
+        std::array<Voice, kMaxVoices> voices {};
+        juce::int64 samplesUntilNext = 0;
+        bool deferredTrigger = false;
+        int lastSample = -1;
+        juce::uint32 voiceClock = 0;
+    };
+
+    bool refreshSettings();
+    juce::int64 drawInterval();
+    void trigger();
+    void renderVoices(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
+
+    const juce::Array<juce::File> files;
+    std::vector<Sample> samples;   // filled by the constructor, never resized after
+
+    SeqLock<Settings> settings;
+    std::atomic<bool> resetPending { true };
+    std::atomic<juce::int64> position { 0 };
+    std::atomic<int> activeVoices { 0 };
+    std::atomic<int> triggers { 0 };
+
+    // Audio thread
+    Settings active;
+    std::uint32_t activeVersion = 0;
+    bool hasActive = false;
+    juce::Random random;
+    std::array<Voice, kMaxVoices> voices {};
+    juce::int64 samplesUntilNext = 0;
+    bool deferredTrigger = false;
+    int lastSample = -1;
+    juce::uint32 voiceClock = 0;
+    double deviceRate = 44100.0;
+
+    std::vector<RewindState> rewindStates;   // one per slot, sized by the constructor
+
+    static constexpr double kMinGapSeconds = 0.02;
+    static constexpr int kReleaseSamples = 128;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OneShotEventSource)
+};
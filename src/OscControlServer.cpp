@@ -0,0 +1,85 @@
+#include "OscControlServer.h"
+
+OscControlServer::OscControlServer(EngineCommandQueue& commandQueue)
+    : queue(commandQueue)
+{
+    receiver.addListener(this);
+}
+
+OscControlServer::~OscControlServer()
+{
+    // Stops the receiver thread before the queue can go away
+    receiver.disconnect();
+    receiver.removeListener(this);
+}
+
+bool OscControlServer::start(int port)
+{
+    // Loopback only: anything on the machine may drive the engine, nothing else
+    if (!socket.bindToPort(port, "127.0.0.1"))
+        return false;
+
+    return receiver.connectToSocket(socket);
+}
+
+bool OscControlServer::getNumber(const juce::OSCMessage& message, int index, float& value)
+{
+    if (index >= message.size())
+        return false;
+
+    const auto& argument = message[index];
+
+    if (argument.isFloat32())
+        value = argument.getFloat32();
+    else if (argument.isInt32())
+        value = static_cast<float>(argument.getInt32());
+    else
+        return false;
+
+    return true;
+}
+
+void OscControlServer::oscMessageReceived(const juce::OSCMessage& message)
+{
+    const auto address = message.getAddressPattern().toString();
+    const bool hasPath = message.size() > 0 && message[0].isString();
+
+    EngineCommand command;
+
+    if (address == "/drem/preset/load" && hasPath)
+    {
+        command.type = EngineCommand::Type::LoadPreset;
+        command.path = message[0].getString();
+    }
+    else if (address == "/drem/preset/crossfade" && hasPath)
+    {
+        command.type = EngineCommand::Type::CrossfadeToPreset;
+        command.path = message[0].getString();
+        command.value = kDefaultCrossfadeSeconds;
+        getNumber(message, 1, command.value);
+    }
+    else if (address == "/drem/volume" && getNumber(message, 0, command.value))
+    {
+        command.type = EngineCommand::Type::SetVolume;
+    }
+    else if (address == "/drem/start")
+    {
+        command.type = EngineCommand::Type::Start;
+    }
+    else if (address == "/drem/stop")
+    {
+        command.type = EngineCommand::Type::Stop;
+    }
+    else if (address == "/drem/quit")
+    {
+        command.type = EngineCommand::Type::Quit;
+    }
+    else
+    {
+        juce::Logger::writeToLog("Unknown OSC command: " + address);
+        return;
+    }
+
+    if (!queue.push(command))
+        juce::Logger::writeToLog("Command queue full, dropped " + address);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "EngineCommandQueue.h"
+
+// Takes OSC commands over UDP on the loopback interface and queues them for
+// the engine.  Messages are parsed on the receiver's own thread:
+//
+//   /drem/preset/load       s:path
+//   /drem/preset/crossfade  s:path f:seconds
+//   /drem/volume            f:gain
+//   /drem/start
+//   /drem/stop
+//   /drem/quit
+class OscControlServer : private juce::OSCReceiver::Listener<juce::OSCReceiver::RealtimeCallback>
+{
+public:
+    explicit OscControlServer(EngineCommandQueue& queue);
+    ~OscControlServer() override;
+
+    bool start(int port);
+
+    static constexpr int kDefaultPort = 9031;
+    static constexpr float kDefaultCrossfadeSeconds = 4.0f;
+
+private:
+    void oscMessageReceived(const juce::OSCMessage& message) override;
+    static bool getNumber(const juce::OSCMessage& message, int index, float& value);
+
+    EngineCommandQueue& queue;
+    juce::DatagramSocket socket;
+    juce::OSCReceiver receiver { "osc-control" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OscControlServer)
+};
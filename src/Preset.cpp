@@ -0,0 +1,234 @@
+#include "Preset.h"
+
+float Preset::getFloat(const juce::DynamicObject& obj, const juce::Identifier& key, float fallback)
+{
+    return obj.hasProperty(key) ? static_cast<float>(static_cast<double>(obj.getProperty(key))) : fallback;
+}
+
+double Preset::getDouble(const juce::DynamicObject& obj, const juce::Identifier& key, double fallback)
+{
+    return obj.hasProperty(key) ? static_cast<double>(obj.getProperty(key)) : fallback;
+}
+
+juce::Array<juce::File> Preset::existingFiles(const juce::var& paths, const juce::String& what)
+{
+    juce::Array<juce::File> files;
+
+    if (auto* array = paths.getArray())
+    {
+        for (const auto& pathVar : *array)
+        {
+            juce::File file(pathVar.toString());
+            if (file.existsAsFile())
+                files.add(file);
+            else
+                juce::Logger::writeToLog(what + " missing: " + pathVar.toString());
+        }
+    }
+
+    return files;
+}
+
+juce::var Preset::pathArray(const juce::Array<juce::File>& files)
+{
+    juce::Array<juce::var> paths;
+    for (const auto& file : files)
+        paths.add(file.getFullPathName());
+    return paths;
+}
+
+bool Preset::fromJson(const juce::var& json, Preset& preset)
+{
+    auto* obj = json.getDynamicObject();
+    if (obj == nullptr)
+        return false;
+
+    preset = {};
+    preset.masterVolume = getFloat(*obj, "masterVolume", preset.masterVolume);
+    preset.hpfCutoff = getFloat(*obj, "hpfCutoff", preset.hpfCutoff);
+    preset.lowShelfGain = getFloat(*obj, "lowShelfGain", preset.lowShelfGain);
+    preset.highShelfGain = getFloat(*obj, "highShelfGain", preset.highShelfGain);
+    preset.lpfCutoff = getFloat(*obj, "lpfCutoff", preset.lpfCutoff);
+    preset.targetLoudness = getDouble(*obj, "targetLoudness", preset.targetLoudness);
+    preset.reverbWet = getFloat(*obj, "reverbWet", preset.reverbWet);
+    preset.fadeInSeconds = getDouble(*obj, "fadeInSeconds", preset.fadeInSeconds);
+    preset.fadeOutSeconds = getDouble(*obj, "fadeOutSeconds", preset.fadeOutSeconds);
+    preset.startGridSeconds = getDouble(*obj, "startGridSeconds", preset.startGridSeconds);
+
+    const auto impulsePath = obj->getProperty("reverbImpulse").toString();
+    if (impulsePath.isNotEmpty())
+        preset.reverbImpulse = juce::File(impulsePath);
+
+    auto* layersArray = obj->getProperty("layers").getArray();
+    if (layersArray == nullptr)
+        return true;
+
+    for (const auto& layerVar : *layersArray)
+    {
+        auto* layerObj = layerVar.getDynamicObject();
+        if (layerObj == nullptr)
+            continue;
+
+        PresetLayer layer;
+        layer.loopStart = static_cast<juce::int64>(layerObj->getProperty("loopStart"));
+        layer.loopEnd = layerObj->hasProperty("loopEnd") ? static_cast<juce::int64>(layerObj->getProperty("loopEnd")) : -1;
+        layer.crossfadeSamples = static_cast<int>(layerObj->getProperty("crossfadeSamples"));
+        layer.curveX = getFloat(*layerObj, "crossfadeCurveX", layer.curveX);
+        layer.curveY = getFloat(*layerObj, "crossfadeCurveY", layer.curveY);
+        layer.volume = getFloat(*layerObj, "volume", layer.volume);
+        layer.autoGain = layerObj->hasProperty("autoGain") && static_cast<bool>(layerObj->getProperty("autoGain"));
+        layer.equalPower = layerObj->hasProperty("crossfadeEqualPower")
+            && static_cast<bool>(layerObj->getProperty("crossfadeEqualPower"));
+
+        // Layers from older presets load unfiltered and centred, as recorded
+        layer.tone.highPassHz = getFloat(*layerObj, "highPassHz", layer.tone.highPassHz);
+        layer.tone.lowPassHz = getFloat(*layerObj, "lowPassHz", layer.tone.lowPassHz);
+        layer.tone.tiltDb = getFloat(*layerObj, "tiltDb", layer.tone.tiltDb);
+        layer.tone.azimuthDegrees = getFloat(*layerObj, "azimuthDegrees", layer.tone.azimuthDegrees);
+        layer.tone.distanceMetres = getFloat(*layerObj, "distanceMetres", layer.tone.distanceMetres);
+        layer.tone.width = getFloat(*layerObj, "width", layer.tone.width);
+
+        if (layerObj->getProperty("sequence").isArray())
+        {
+            layer.kind = PresetLayer::Kind::Sequence;
+            layer.files = existingFiles(layerObj->getProperty("sequence"), "Sequence file");
+        }
+        else if (layerObj->getProperty("events").isArray())
+        {
+            layer.kind = PresetLayer::Kind::Events;
+            layer.files = existingFiles(layerObj->getProperty("events"), "Event sample");
+
+            auto& settings = layer.eventSettings;
+            settings.eventsPerMinute = getFloat(*layerObj, "eventsPerMinute", settings.eventsPerMinute);
+            settings.gainJitterDb = getFloat(*layerObj, "eventGainJitterDb", settings.gainJitterDb);
+            settings.panSpread = getFloat(*layerObj, "eventPanSpread", settings.panSpread);
+            if (layerObj->hasProperty("eventSeed"))
+                settings.seed = static_cast<juce::int64>(layerObj->getProperty("eventSeed"));
+        }
+        else
+        {
+            layer.files.add(juce::File(layerObj->getProperty("filePath").toString()));
+
+            if (auto* segmentsArray = layerObj->getProperty("segments").getArray())
+            {
+                auto& playlist = layer.playlist;
+
+                for (const auto& segmentVar : *segmentsArray)
+                {
+                    auto* segmentObj = segmentVar.getDynamicObject();
+                    if (segmentObj == nullptr || playlist.numSegments >= LoopingAudioSource::kMaxSegments)
+                        continue;
+
+                    auto& segment = playlist.segments[static_cast<size_t>(playlist.numSegments++)];
+                    segment.start = static_cast<juce::int64>(segmentObj->getProperty("start"));
+                    segment.end = static_cast<juce::int64>(segmentObj->getProperty("end"));
+                    segment.weight = getFloat(*segmentObj, "weight", 1.0f);
+                }
+
+                playlist.randomOrder = layerObj->getProperty("segmentOrder").toString() == "random";
+                playlist.primaryWeight = getFloat(*layerObj, "primaryWeight", playlist.primaryWeight);
+            }
+        }
+
+        preset.layers.push_back(layer);
+    }
+
+    return true;
+}
+
+bool Preset::load(const juce::File& file, Preset& preset)
+{
+    if (!file.existsAsFile())
+        return false;
+
+    return fromJson(juce::JSON::parse(file.loadFileAsString()), preset);
+}
+
+juce::var Preset::toJson() const
+{
+    juce::Array<juce::var> layersArray;
+
+    for (const auto& layer : layers)
+    {
+        auto* layerObj = new juce::DynamicObject();
+        layerObj->setProperty("filePath", layer.files.getFirst().getFullPathName());
+
+        if (layer.kind == PresetLayer::Kind::Sequence)
+        {
+            layerObj->setProperty("sequence", pathArray(layer.files));
+            layerObj->setProperty("crossfadeSamples", layer.crossfadeSamples);
+        }
+        else if (layer.kind == PresetLayer::Kind::Events)
+        {
+            const auto& settings = layer.eventSettings;
+            layerObj->setProperty("events", pathArray(layer.files));
+            layerObj->setProperty("eventsPerMinute", static_cast<double>(settings.eventsPerMinute));
+            layerObj->setProperty("eventGainJitterDb", static_cast<double>(settings.gainJitterDb));
+            layerObj->setProperty("eventPanSpread", static_cast<double>(settings.panSpread));
+            layerObj->setProperty("eventSeed", settings.seed);
+        }
+        else
+        {
+            layerObj->setProperty("loopStart", layer.loopStart);
+            layerObj->setProperty("loopEnd", layer.loopEnd);
+            layerObj->setProperty("crossfadeSamples", layer.crossfadeSamples);
+        }
+
+        layerObj->setProperty("crossfadeCurveX", static_cast<double>(layer.curveX));
+        layerObj->setProperty("crossfadeCurveY", static_cast<double>(layer.curveY));
+        layerObj->setProperty("crossfadeEqualPower", layer.equalPower);
+        layerObj->setProperty("volume", static_cast<double>(layer.volume));
+
+        layerObj->setProperty("highPassHz", static_cast<double>(layer.tone.highPassHz));
+        layerObj->setProperty("lowPassHz", static_cast<double>(layer.tone.lowPassHz));
+        layerObj->setProperty("tiltDb", static_cast<double>(layer.tone.tiltDb));
+        layerObj->setProperty("azimuthDegrees", static_cast<double>(layer.tone.azimuthDegrees));
+        layerObj->setProperty("distanceMetres", static_cast<double>(layer.tone.distanceMetres));
+        layerObj->setProperty("width", static_cast<double>(layer.tone.width));
+        layerObj->setProperty("autoGain", layer.autoGain);
+
+        const auto& playlist = layer.playlist;
+        if (playlist.numSegments > 0)
+        {
+            juce::Array<juce::var> segmentsArray;
+
+            for (int i = 0; i < playlist.numSegments; ++i)
+            {
+                const auto& segment = playlist.segments[static_cast<size_t>(i)];
+                auto* segmentObj = new juce::DynamicObject();
+                segmentObj->setProperty("start", segment.start);
+                segmentObj->setProperty("end", segment.end);
+                segmentObj->setProperty("weight", static_cast<double>(segment.weight));
+                segmentsArray.add(juce::var(segmentObj));
+            }
+
+            layerObj->setProperty("segments", segmentsArray);
+            layerObj->setProperty("segmentOrder", playlist.randomOrder ? "random" : "sequential");
+            layerObj->setProperty("primaryWeight", static_cast<double>(playlist.primaryWeight));
+        }
+
+        layersArray.add(juce::var(layerObj));
+    }
+
+    auto* preset = new juce::DynamicObject();
+    preset->setProperty("version", 1);
+    preset->setProperty("masterVolume", static_cast<double>(masterVolume));
+    preset->setProperty("hpfCutoff", static_cast<double>(hpfCutoff));
+    preset->setProperty("lowShelfGain", static_cast<double>(lowShelfGain));
+    preset->setProperty("highShelfGain", static_cast<double>(highShelfGain));
+    preset->setProperty("lpfCutoff", static_cast<double>(lpfCutoff));
+    preset->setProperty("targetLoudness", targetLoudness);
+    preset->setProperty("reverbImpulse", reverbImpulse.getFullPathName());
+    preset->setProperty("reverbWet", static_cast<double>(reverbWet));
+    preset->setProperty("fadeInSeconds", fadeInSeconds);
+    preset->setProperty("fadeOutSeconds", fadeOutSeconds);
+    preset->setProperty("startGridSeconds", startGridSeconds);
+    preset->setProperty("layers", juce::var(layersArray));
+
+    return juce::var(preset);
+}
+
+bool Preset::save(const juce::File& file) const
+{
+    return file.replaceWithText(juce::JSON::toString(toJson()));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <limits>
+#include <vector>
+#include "LayerMixer.h"
+#include "LoopingAudioSource.h"
+#include "OneShotEventSource.h"
+
+// One layer as stored in a preset
+struct PresetLayer
+{
+    enum class Kind { Loop, Sequence, Events };
+
+    Kind kind = Kind::Loop;
+    juce::Array<juce::File> files;     // a loop's one file, or a sequence's or event layer's samples
+    juce::int64 loopStart = 0;
+    juce::int64 loopEnd = -1;          // -1 plays to the end of the file
+    int crossfadeSamples = 0;
+    float curveX = 0.25f;
+    float curveY = 0.75f;
+    bool equalPower = false;
+    float volume = 1.0f;
+    bool autoGain = false;
+    double measuredLoudness = std::numeric_limits<double>::quiet_NaN();   // LUFS; only bundles keep it
+    LayerTone tone;
+    LoopingAudioSource::Playlist playlist;
+    OneShotEventSource::Settings eventSettings;
+};
+
+// A whole scene: master bus settings and every layer, read from and written
+// to the JSON preset files.  Settings missing from older presets keep the
+// defaults below, and sequence or event samples that no longer exist are
+// dropped with a log line; a loop whose file is missing is kept, so the
+// caller can ask where it went.
+struct Preset
+{
+    float masterVolume = 1.0f;
+    float hpfCutoff = 20.0f;
+    float lowShelfGain = 0.0f;
+    float highShelfGain = 0.0f;
+    float lpfCutoff = 20000.0f;
+    double targetLoudness = -23.0;
+    juce::File reverbImpulse;
+    float reverbWet = 0.3f;
+    double fadeInSeconds = 0.05;
+    double fadeOutSeconds = 0.25;
+    double startGridSeconds = 0.0;
+    std::vector<PresetLayer> layers;
+
+    static bool fromJson(const juce::var& json, Preset& preset);
+    static bool load(const juce::File& file, Preset& preset);
+
+    juce::var toJson() const;
+    bool save(const juce::File& file) const;
+
+private:
+    static float getFloat(const juce::DynamicObject& obj, const juce::Identifier& key, float fallback);
+    static double getDouble(const juce::DynamicObject& obj, const juce::Identifier& key, double fallback);
+    static juce::Array<juce::File> existingFiles(const juce::var& paths, const juce::String& what);
+    static juce::var pathArray(const juce::Array<juce::File>& files);
+};
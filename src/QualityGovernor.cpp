@@ -0,0 +1,63 @@
+#include "QualityGovernor.h"
+
+QualityGovernor::QualityGovernor(std::function<float()> loadSource)
+    : measureLoad(std::move(loadSource))
+{
+    startTimer(kIntervalMs);
+}
+
+QualityGovernor::~QualityGovernor()
+{
+    stopTimer();
+}
+
+juce::String QualityGovernor::getLevelName(Level levelToName)
+{
+    switch (levelToName)
+    {
+        case Level::Full:             return "full quality";
+        case Level::NoLayerMeters:    return "layer meters paused";
+        case Level::LinearCrossfades: return "linear crossfades";
+        case Level::NoLayerFilters:   return "layer filters bypassed";
+        case Level::CullQuietLayers:  return "quiet layers culled";
+        case Level::NoRoom:           return "room reverb off";
+    }
+
+    return {};
+}
+
+void QualityGovernor::timerCallback()
+{
+    const float load = measureLoad();
+
+    // The load is smoothed, so give it time to show the last step
+    if (settleTicks > 0)
+    {
+        --settleTicks;
+        return;
+    }
+
+    ticksOver = load > kStepDownLoad ? ticksOver + 1 : 0;
+    ticksUnder = load < kStepUpLoad ? ticksUnder + 1 : 0;
+
+    const auto index = static_cast<int>(level);
+
+    if (ticksOver >= kTicksToStepDown && index < kNumLevels - 1)
+        stepTo(static_cast<Level>(index + 1), load);
+    else if (ticksUnder >= kTicksToStepUp && index > 0)
+        stepTo(static_cast<Level>(index - 1), load);
+}
+
+void QualityGovernor::stepTo(Level newLevel, float load)
+{
+    juce::Logger::writeToLog("Quality governor: load " + juce::String(juce::roundToInt(load * 100.0f))
+                             + "%, " + getLevelName(level) + " -> " + getLevelName(newLevel));
+
+    level = newLevel;
+    ticksOver = 0;
+    ticksUnder = 0;
+    settleTicks = kSettleTicks;
+
+    if (onLevelChanged != nullptr)
+        onLevelChanged(level);
+}
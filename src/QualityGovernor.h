@@ -0,0 +1,50 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <functional>
+
+// Trades processing quality for headroom when the engine runs short of time.
+//
+// A few times a second the governor samples a smoothed render load (time
+// spent over real time).  Sustained load above kStepDownLoad drops one
+// level, load below kStepUpLoad for several seconds climbs one back, and
+// after every step it waits for the smoothed load to catch up before
+// deciding again.  Levels are ordered so the least audible saving goes
+// first; what each one switches off is up to the owner.  Every step is
+// written to the log with the load that caused it.
+class QualityGovernor : private juce::Timer
+{
+public:
+    enum class Level { Full = 0, NoLayerMeters, LinearCrossfades, NoLayerFilters, CullQuietLayers, NoRoom };
+
+    static constexpr int kNumLevels = 6;
+
+    // Message thread; measureLoad is called from the governor's timer
+    explicit QualityGovernor(std::function<float()> measureLoad);
+    ~QualityGovernor() override;
+
+    Level getLevel() const { return level; }
+    static juce::String getLevelName(Level levelToName);
+
+    std::function<void(Level)> onLevelChanged;
+
+    static constexpr float kStepDownLoad = 0.7f;
+    static constexpr float kStepUpLoad = 0.4f;
+
+private:
+    void timerCallback() override;
+    void stepTo(Level newLevel, float load);
+
+    std::function<float()> measureLoad;
+    Level level = Level::Full;
+    int ticksOver = 0;
+    int ticksUnder = 0;
+    int settleTicks = 0;
+
+    static constexpr int kIntervalMs = 250;
+    static constexpr int kTicksToStepDown = 2;
+    static constexpr int kTicksToStepUp = 16;
+    static constexpr int kSettleTicks = 8;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(QualityGovernor)
+};
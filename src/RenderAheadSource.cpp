@@ -0,0 +1,255 @@
+#include "RenderAheadSource.h"
+
+RenderAheadSource::RenderAheadSource(juce::AudioSource* inputSource, EngineTransport& engineTransport)
+    : juce::Thread("render-ahead"),
+      input(inputSource),
+      transport(engineTransport)
+{
+}
+
+RenderAheadSource::~RenderAheadSource()
+{
+    stopThread(1000);
+}
+
+void RenderAheadSource::prepareToPlay(int samplesPerBlockExpected, double sampleRate)
+{
+    stopThread(1000);
+
+    currentSampleRate = sampleRate;
+    active = enabled.load();
+    transport.setBufferedLatency(0.0);
+    seenChanges = transport.getChangeCount();
+    editTicks.store(0);
+
+    if (!active)
+    {
+        input->prepareToPlay(samplesPerBlockExpected, sampleRate);
+        return;
+    }
+
+    // Everything upstream now sees fixed blocks, whatever the device asks for
+    input->prepareToPlay(kRenderBlock, sampleRate);
+
+    auto roundUp = [](int samples) { return (samples + kRenderBlock - 1) / kRenderBlock * kRenderBlock; };
+    aheadSamples = roundUp(static_cast<int>(kAheadSeconds * sampleRate));
+    guardSamples = roundUp(juce::jmax(static_cast<int>(kGuardSeconds * sampleRate), 2 * samplesPerBlockExpected));
+    aheadSamples = juce::jmax(aheadSamples, guardSamples + 2 * kRenderBlock);
+
+    ringSize = aheadSamples + 2 * kRenderBlock;
+    ring.setSize(kNumChannels, ringSize);
+    ring.clear();
+    renderScratch.setSize(kNumChannels, kRenderBlock);
+
+    writePos.store(0);
+    readPos.store(0);
+    primed = false;
+    stalled = false;
+    spliceRemaining = 0;
+    bursting = true;
+
+    startThread(juce::Thread::Priority::high);
+}
+
+void RenderAheadSource::releaseResources()
+{
+    stopThread(1000);
+    transport.setBufferedLatency(0.0);
+    input->releaseResources();
+}
+
+void RenderAheadSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    if (!active)
+    {
+        // Pulled straight from here, a change is in the block about to play
+        const auto changes = transport.getChangeCount();
+        if (changes != seenChanges)
+        {
+            seenChanges = changes;
+            recordEditLatency(transport.getLastChangeTicks(), 0);
+        }
+
+        pullInput(bufferToFill);
+        return;
+    }
+
+    auto& buffer = *bufferToFill.buffer;
+    const auto read = readPos.load(std::memory_order_relaxed);
+    const auto written = writePos.load(std::memory_order_acquire);
+    const auto count = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0),
+                                                     static_cast<juce::int64>(bufferToFill.numSamples),
+                                                     written - read));
+
+    const int start = static_cast<int>(read % ringSize);
+    const int first = juce::jmin(count, ringSize - start);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        if (ch >= kNumChannels)
+        {
+            buffer.clear(ch, bufferToFill.startSample, bufferToFill.numSamples);
+            continue;
+        }
+
+        if (first > 0)
+            buffer.copyFrom(ch, bufferToFill.startSample, ring, ch, start, first);
+        if (count > first)
+            buffer.copyFrom(ch, bufferToFill.startSample + first, ring, ch, 0, count - first);
+        if (count < bufferToFill.numSamples)
+            buffer.clear(ch, bufferToFill.startSample + count, bufferToFill.numSamples - count);
+    }
+
+    readPos.store(read + count, std::memory_order_release);
+    measureEdit(read, count);
+
+    // The engine thread needs a moment to fill up after a restart; only a
+    // shortfall once it has is a real underrun
+    primed = primed || written - read >= guardSamples;
+    const bool shortfall = count < bufferToFill.numSamples;
+
+    if (primed && shortfall && !stalled)
+        underruns.fetch_add(1);
+
+    stalled = primed && shortfall;
+    transport.setBufferedLatency(static_cast<double>(juce::jmax(static_cast<juce::int64>(0), written - read - count))
+                                 / currentSampleRate);
+}
+
+void RenderAheadSource::run()
+{
+    while (!threadShouldExit())
+    {
+        const auto changes = transport.getChangeCount();
+        if (changes != seenChanges)
+        {
+            seenChanges = changes;
+            rewind();
+
+            // Whatever is rendered from here on has the change in it
+            editFrom.store(writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            editTicks.store(transport.getLastChangeTicks(), std::memory_order_release);
+        }
+
+        const bool saveWakeups = lowPower.load();
+        const auto backlog = writePos.load(std::memory_order_relaxed) - readPos.load(std::memory_order_acquire);
+        const auto halfFull = aheadSamples / 2;
+
+        if (backlog + kRenderBlock <= aheadSamples && (bursting || !saveWakeups || backlog <= halfFull))
+        {
+            bursting = true;
+            renderBlock();
+            continue;
+        }
+
+        bursting = false;
+
+        if (!saveWakeups)
+        {
+            wait(kPollMs);
+            wakeups.fetch_add(1);
+            continue;
+        }
+
+        wait(juce::jmax(kPollMs, static_cast<int>(static_cast<double>(backlog - halfFull) * 1000.0 / currentSampleRate)));
+        wakeups.fetch_add(1);
+    }
+}
+
+void RenderAheadSource::rewind()
+{
+    const auto written = writePos.load(std::memory_order_relaxed);
+    const auto read = readPos.load(std::memory_order_acquire);
+
+    // Keep the guard the device may be reading from and cut on a block line,
+    // which is where the transport and gates can return to
+    const auto discard = (written - (read + guardSamples)) / kRenderBlock * kRenderBlock;
+    if (discard <= 0)
+        return;
+
+    transport.rewindTo(transport.getClock() - discard);
+    writePos.store(written - discard, std::memory_order_release);
+    spliceRemaining = kSpliceSamples;
+    rewinds.fetch_add(1);
+}
+
+void RenderAheadSource::measureEdit(juce::int64 read, int count)
+{
+    auto changeTicks = editTicks.load(std::memory_order_acquire);
+    if (changeTicks == 0)
+        return;
+
+    const auto from = editFrom.load(std::memory_order_relaxed);
+    if (from >= read + count || !editTicks.compare_exchange_strong(changeTicks, 0))
+        return;
+
+    recordEditLatency(changeTicks, juce::jmax(static_cast<juce::int64>(0), from - read));
+}
+
+void RenderAheadSource::recordEditLatency(juce::int64 changeTicks, juce::int64 samplesUntilHeard)
+{
+    if (changeTicks <= 0)
+        return;
+
+    const double waited = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - changeTicks);
+    const double seconds = waited + static_cast<double>(samplesUntilHeard) / currentSampleRate
+                         + transport.getProcessingLatencySeconds() + deviceLatencySeconds.load();
+
+    editLatencyMs.store(seconds * 1000.0);
+    editsMeasured.fetch_add(1);
+}
+
+void RenderAheadSource::pullInput(const juce::AudioSourceChannelInfo& info)
+{
+    const auto startTicks = juce::Time::getHighResolutionTicks();
+    input->getNextAudioBlock(info);
+
+    if (info.numSamples > 0)
+    {
+        const double elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+        const double budget = info.numSamples / currentSampleRate;
+        const auto load = static_cast<float>(elapsed / budget);
+        cpuLoad.store(cpuLoad.load() + 0.05f * (load - cpuLoad.load()));
+    }
+}
+
+void RenderAheadSource::renderBlock()
+{
+    pullInput(juce::AudioSourceChannelInfo(&renderScratch, 0, kRenderBlock));
+
+    const auto written = writePos.load(std::memory_order_relaxed);
+    const int start = static_cast<int>(written % ringSize);
+    const int first = juce::jmin(kRenderBlock, ringSize - start);
+
+    // After a rewind the old render is still in the ring; fade from it into
+    // the new one rather than cut
+    if (spliceRemaining > 0)
+    {
+        const int count = juce::jmin(spliceRemaining, kRenderBlock);
+        const int done = kSpliceSamples - spliceRemaining;
+
+        for (int ch = 0; ch < kNumChannels; ++ch)
+        {
+            auto* fresh = renderScratch.getWritePointer(ch);
+            const auto* old = ring.getReadPointer(ch);
+
+            for (int i = 0; i < count; ++i)
+            {
+                const float t = static_cast<float>(done + i + 1) / static_cast<float>(kSpliceSamples);
+                const float previous = old[(start + i) % ringSize];
+                fresh[i] = previous + (fresh[i] - previous) * t;
+            }
+        }
+
+        spliceRemaining -= count;
+    }
+
+    for (int ch = 0; ch < kNumChannels; ++ch)
+    {
+        ring.copyFrom(ch, start, renderScratch, ch, 0, first);
+        if (first < kRenderBlock)
+            ring.copyFrom(ch, 0, renderScratch, ch, first, kRenderBlock - first);
+    }
+
+    writePos.store(written + kRenderBlock, std::memory_order_release);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include "EngineTransport.h"
+
+// Renders the whole mix on its own thread, ahead of the device.
+//
+// The engine thread keeps up to kAheadSeconds of finished output in a ring
+// and the device callback only copies out of it, so one slow block is
+// absorbed by the backlog instead of being heard.  Whenever the transport's
+// change count moves, everything past a short guard is thrown away and
+// rendered again: the transport and the layer gates rewind to the first
+// discarded block, and the redone audio is blended in over what was there,
+// which hides the filter and reverb state carried over from the old render.
+// Settings therefore take effect within about kGuardSeconds.
+//
+// With render-ahead off the input is pulled straight from the callback.
+class RenderAheadSource : public juce::AudioSource,
+                          private juce::Thread
+{
+public:
+    RenderAheadSource(juce::AudioSource* input, EngineTransport& transport);
+    ~RenderAheadSource() override;
+
+    // Takes effect the next time the source is prepared
+    void setEnabled(bool shouldRenderAhead) { enabled.store(shouldRenderAhead); }
+    bool isEnabled() const { return enabled.load(); }
+
+    // Refill in bursts: once the ring is full the engine thread sleeps until
+    // half of it has played instead of topping it up every kPollMs.  Settings
+    // then take up to kAheadSeconds / 2 to be heard.
+    void setLowPower(bool shouldSaveWakeups) { lowPower.store(shouldSaveWakeups); }
+
+    // Callbacks the engine thread hadn't rendered for; should stay at zero
+    int getUnderrunCount() const { return underruns.load(); }
+    int getRewindCount() const { return rewinds.load(); }
+
+    // Times the engine thread has woken from a sleep, for comparing modes
+    int getWakeupCount() const { return wakeups.load(); }
+
+    // How long the device takes to play a block once it has it: its own
+    // output latency plus one buffer.  Only used for getEditLatencyMs().
+    void setDeviceLatency(double seconds) { deviceLatencySeconds.store(seconds); }
+
+    // Measured time from the latest parameter change to the first sample
+    // carrying it leaving the speaker: waiting for a rewind, the guard and
+    // backlog ahead of the redone audio, the limiter's lookahead and the
+    // device.  getEditCount() counts the changes measured so far.
+    double getEditLatencyMs() const { return editLatencyMs.load(); }
+    int getEditCount() const { return editsMeasured.load(); }
+
+    // Time spent rendering the whole mix as a fraction of the audio it
+    // produced, smoothed; above 1 the engine can't keep up
+    float getCpuLoad() const { return cpuLoad.load(); }
+
+    // AudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    static constexpr double kAheadSeconds = 0.4;
+    static constexpr double kGuardSeconds = 0.025;
+    static constexpr int kRenderBlock = 512;
+
+private:
+    void run() override;
+    void renderBlock();
+    void rewind();
+    void pullInput(const juce::AudioSourceChannelInfo& info);
+    void measureEdit(juce::int64 read, int count);
+    void recordEditLatency(juce::int64 changeTicks, juce::int64 samplesUntilHeard);
+
+    juce::AudioSource* input;
+    EngineTransport& transport;
+
+    std::atomic<bool> enabled { true };
+    std::atomic<bool> lowPower { false };
+    std::atomic<int> underruns { 0 };
+    std::atomic<int> rewinds { 0 };
+    std::atomic<int> wakeups { 0 };
+    std::atomic<float> cpuLoad { 0.0f };
+    std::atomic<double> deviceLatencySeconds { 0.0 };
+    std::atomic<double> editLatencyMs { 0.0 };
+    std::atomic<int> editsMeasured { 0 };
+
+    // The latest change the engine thread has rendered and the ring position
+    // its audio starts at, until the device callback reaches it; 0 when none
+    std::atomic<juce::int64> editTicks { 0 };
+    std::atomic<juce::int64> editFrom { 0 };
+
+    // Ring positions count samples since prepareToPlay and never wrap
+    juce::AudioBuffer<float> ring;
+    int ringSize = 0;
+    std::atomic<juce::int64> writePos { 0 };
+    std::atomic<juce::int64> readPos { 0 };
+
+    // Fixed between prepareToPlay and releaseResources
+    bool active = false;
+    int aheadSamples = 0;
+    int guardSamples = 0;
+    double currentSampleRate = 44100.0;
+
+    // Audio thread
+    bool primed = false;
+    bool stalled = false;
+
+    // Engine thread, or the audio thread with render-ahead off
+    juce::AudioBuffer<float> renderScratch;
+    juce::uint32 seenChanges = 0;
+    int spliceRemaining = 0;
+    bool bursting = true;
+
+    static constexpr int kNumChannels = 2;
+    static constexpr int kSpliceSamples = 256;
+    static constexpr int kPollMs = 2;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RenderAheadSource)
+};
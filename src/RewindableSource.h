@@ -0,0 +1,20 @@
+#pragma once
+
+// A layer source with state beyond its read position that a rewind has to
+// put back, such as which file of a sequence is playing or which one-shots
+// are sounding.  The LayerGate saves it at the start of every block into one
+// of kRewindSlots slots and restores a slot when the transport rewinds to
+// that block.  Both are called on the audio thread, between blocks.
+class RewindableSource
+{
+public:
+    virtual ~RewindableSource() = default;
+
+    virtual void saveRewindState(int slot) = 0;
+
+    // False if the source can't go back to that point, in which case the
+    // gate leaves the read position where it is as well
+    virtual bool restoreRewindState(int slot) = 0;
+
+    static constexpr int kRewindSlots = 256;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+// Publishes a small trivially-copyable struct as one unit.
+//
+// Writers are serialised with a spin lock and must never be the audio thread.
+// The audio thread calls tryRead(), which never blocks: if a write is in
+// flight it fails and the caller keeps using its previous snapshot.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>, "SeqLock values must be trivially copyable");
+
+public:
+    SeqLock() { publish(T{}); }
+    explicit SeqLock(const T& initial) { publish(initial); }
+
+    void write(const T& value)
+    {
+        const juce::SpinLock::ScopedLockType sl(writeLock);
+        publish(value);
+    }
+
+    // Read-modify-write under the writer lock, so concurrent setters that
+    // touch different fields never lose each other's updates.
+    template <typename Fn>
+    void modify(Fn&& fn)
+    {
+        const juce::SpinLock::ScopedLockType sl(writeLock);
+        auto value = latest;
+        fn(value);
+        publish(value);
+    }
+
+    // Wait-free; returns false if a writer was mid-publish.
+    bool tryRead(T& dest, std::uint32_t& version) const noexcept
+    {
+        const auto before = sequence.load(std::memory_order_acquire);
+        if ((before & 1u) != 0)
+            return false;
+
+        std::array<Word, numWords> raw;
+        for (size_t i = 0; i < numWords; ++i)
+            raw[i] = words[i].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != before)
+            return false;
+
+        std::memcpy(static_cast<void*>(&dest), raw.data(), sizeof(T));
+        version = before;
+        return true;
+    }
+
+    // For non-realtime readers (GUI, preset code).
+    T read() const noexcept
+    {
+        T value;
+        std::uint32_t version = 0;
+        while (!tryRead(value, version))
+            std::this_thread::yield();
+        return value;
+    }
+
+    std::uint32_t getVersion() const noexcept { return sequence.load(std::memory_order_acquire); }
+
+private:
+    using Word = std::uint64_t;
+    static constexpr size_t numWords = (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+    void publish(const T& value) noexcept
+    {
+        std::array<Word, numWords> raw {};
+        std::memcpy(raw.data(), &value, sizeof(T));
+
+        const auto seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < numWords; ++i)
+            words[i].store(raw[i], std::memory_order_relaxed);
+
+        sequence.store(seq + 2, std::memory_order_release);
+        latest = value;
+    }
+
+    std::array<std::atomic<Word>, numWords> words {};
+    std::atomic<std::uint32_t> sequence { 0 };
+    juce::SpinLock writeLock;
+    T latest {};
+
+    JUCE_DECLARE_NON_COPYABLE(SeqLock)
+};
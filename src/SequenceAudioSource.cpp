@@ -0,0 +1,233 @@
+#include "SequenceAudioSource.h"
+#include <cmath>
+
+SequenceAudioSource::SequenceAudioSource(juce::AudioFormatManager& fm, const juce::Array<juce::File>& fileList,
+                                         juce::TimeSliceThread& backgroundThread, size_t memoryBudgetBytesPerFile,
+                                         std::shared_ptr<const SoundscapeBundle> bundleToPlayFrom)
+    : formatManager(fm),
+      thread(backgroundThread),
+      files(fileList),
+      budgetPerFile(memoryBudgetBytesPerFile),
+      bundle(std::move(bundleToPlayFrom))
+{
+    int first = 0;
+    current = openFrom(first);
+
+    if (current == nullptr)
+        return;
+
+    sampleRate = current->getSampleRate();
+    currentLength = current->getTotalLength();
+    currentIndex.store(first);
+
+    thread.addTimeSliceClient(this);
+}
+
+SequenceAudioSource::~SequenceAudioSource()
+{
+    if (isValid())
+        thread.removeTimeSliceClient(this);
+
+    delete ready.exchange(nullptr);
+    delete retired.exchange(nullptr);
+}
+
+// Opens the first usable file at or after index, wrapping; index is updated
+// to the file actually opened.  Files that fail to open or don't match the
+// sequence's sample rate are skipped.
+std::unique_ptr<StreamingAudioSource> SequenceAudioSource::openFrom(int& index) const
+{
+    for (int tries = 0; tries < files.size(); ++tries)
+    {
+        const int candidate = (index + tries) % files.size();
+        auto stream = std::make_unique<StreamingAudioSource>(formatManager, files[candidate],
+                                                             thread, budgetPerFile, bundle);
+
+        if (!stream->isValid() || stream->getTotalLength() <= 0)
+            continue;
+
+        if (sampleRate > 0.0 && stream->getSampleRate() != sampleRate)
+            continue;
+
+        // Straight run from the head; the crossfade moves this along as it plays
+        stream->setPlaybackHint(0, 0, 0, 0);
+        index = candidate;
+        return stream;
+    }
+
+    return nullptr;
+}
+
+int SequenceAudioSource::useTimeSlice()
+{
+    delete retired.exchange(nullptr);
+
+    // Open the file after the current one as soon as the last hand-off is
+    // taken, so it has the whole of the current file to prefetch its head
+    const int playing = currentIndex.load();
+
+    if (ready.load() == nullptr && preparedFor != playing)
+    {
+        int next = (playing + 1) % files.size();
+
+        if (auto stream = openFrom(next))
+        {
+            readyIndex.store(next);
+            ready.store(stream.release(), std::memory_order_release);
+        }
+
+        preparedFor = playing;
+        return 20;
+    }
+
+    return 50;
+}
+
+void SequenceAudioSource::prepareToPlay(int samplesPerBlockExpected, double)
+{
+    headScratch.setSize(2, samplesPerBlockExpected);
+}
+
+void SequenceAudioSource::releaseResources()
+{
+    headScratch.setSize(0, 0);
+}
+
+void SequenceAudioSource::setNextReadPosition(juce::int64 newPosition)
+{
+    pendingSeek.store(juce::jmax(static_cast<juce::int64>(0), newPosition));
+}
+
+bool SequenceAudioSource::swapToUpcoming()
+{
+    auto* next = upcoming != nullptr ? upcoming : ready.load(std::memory_order_acquire);
+
+    // The previous file has to be collected before this one can be handed back
+    if (next == nullptr || retired.load() != nullptr)
+        return false;
+
+    ready.store(nullptr);
+    retired.store(current.release(), std::memory_order_release);
+    current.reset(next);
+    currentLength = current->getTotalLength();
+    currentIndex.store(readyIndex.load());
+
+    // After a crossfade the head up to activeXfade has already been played
+    position = upcoming != nullptr ? static_cast<juce::int64>(juce::jmax(0, activeXfade)) : 0;
+    upcoming = nullptr;
+    activeXfade = -1;
+    return true;
+}
+
+void SequenceAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const auto seekTarget = pendingSeek.exchange(-1);
+    if (seekTarget >= 0 && current != nullptr)
+    {
+        position = juce::jmin(seekTarget, currentLength);
+
+        // A seek into the tail re-decides whether to crossfade
+        upcoming = nullptr;
+        activeXfade = -1;
+    }
+
+    int samplesRemaining = bufferToFill.numSamples;
+    int destOffset = bufferToFill.startSample;
+    auto& buffer = *bufferToFill.buffer;
+
+    while (samplesRemaining > 0)
+    {
+        if (current == nullptr)
+        {
+            buffer.clear(destOffset, samplesRemaining);
+            break;
+        }
+
+        if (activeXfade < 0)
+        {
+            const auto zoneStart = currentLength - juce::jmin(static_cast<juce::int64>(crossfadeSamples.load()),
+                                                              currentLength / 2);
+
+            if (position < zoneStart)
+            {
+                const auto count = static_cast<int>(juce::jmin(static_cast<juce::int64>(samplesRemaining),
+                                                               zoneStart - position));
+                current->read(buffer, destOffset, count, position);
+
+                position += count;
+                destOffset += count;
+                samplesRemaining -= count;
+                continue;
+            }
+
+            // Entering the tail: only blend if the next file is already open
+            upcoming = ready.load(std::memory_order_acquire);
+            activeXfade = upcoming != nullptr
+                ? static_cast<int>(juce::jmin(currentLength - position, upcoming->getTotalLength() / 2))
+                : 0;
+        }
+
+        if (position < currentLength)
+        {
+            auto count = static_cast<int>(juce::jmin(static_cast<juce::int64>(samplesRemaining),
+                                                     currentLength - position));
+            const bool blending = upcoming != nullptr && activeXfade > 0 && headScratch.getNumSamples() > 0;
+
+            if (blending)
+                count = juce::jmin(count, headScratch.getNumSamples());
+
+            current->read(buffer, destOffset, count, position);
+
+            if (blending)
+            {
+                const auto xfadeStart = currentLength - activeXfade;
+                const auto posInXfade = position - xfadeStart;
+                upcoming->read(headScratch, 0, count, posInXfade);
+                upcoming->setPlaybackHint(posInXfade + count, 0, 0, 0);
+
+                // The tail of one file and the head of the next are
+                // different audio, so equal power keeps the level from
+                // dipping in the middle of the fade
+                for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+                {
+                    auto* dest = buffer.getWritePointer(ch, destOffset);
+                    const auto* head = headScratch.getReadPointer(juce::jmin(ch, headScratch.getNumChannels() - 1));
+
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const auto angle = static_cast<float>(static_cast<double>(posInXfade + i) / activeXfade)
+                                         * juce::MathConstants<float>::halfPi;
+                        dest[i] = dest[i] * std::cos(angle) + head[i] * std::sin(angle);
+                    }
+                }
+            }
+
+            position += count;
+            destOffset += count;
+            samplesRemaining -= count;
+            continue;
+        }
+
+        // End of the current file
+        if (!swapToUpcoming())
+        {
+            // Only reachable if the next file couldn't be opened in a whole
+            // file's time; hold silence here until it arrives
+            if (!stalled)
+                underruns.fetch_add(1);
+
+            stalled = true;
+            activeXfade = -1;
+            buffer.clear(destOffset, samplesRemaining);
+            break;
+        }
+
+        stalled = false;
+    }
+
+    if (current != nullptr)
+        current->setPlaybackHint(position, 0, 0, 0);
+
+    if (pendingSeek.load() < 0)
+        nextPlayPos.store(position);
+}
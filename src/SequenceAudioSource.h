@@ -0,0 +1,93 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <array>
+#include <atomic>
+#include "RewindableSource.h"
+#include "StreamingAudioSource.h"
+
+// Plays a list of files back to back as one continuous stream, wrapping from
+// the last file to the first.
+//
+// Each file is served by its own StreamingAudioSource.  While one file plays,
+// the read-ahead thread opens the next and prefetches its head, so at the
+// boundary the audio thread only swaps pointers: no file open and no decoder
+// start-up ever happens in the callback.  An optional crossfade blends the
+// end of each file into the start of the next.
+//
+// Positions are within the file currently playing; a seek never changes file.
+// A rewind back into a file that has already been handed over is refused,
+// since its reader is gone, and playback carries on in the current one.
+class SequenceAudioSource : public juce::PositionableAudioSource,
+                            public RewindableSource,
+                            private juce::TimeSliceClient
+{
+public:
+    SequenceAudioSource(juce::AudioFormatManager& formatManager, const juce::Array<juce::File>& files,
+                        juce::TimeSliceThread& backgroundThread, size_t memoryBudgetBytesPerFile,
+                        std::shared_ptr<const SoundscapeBundle> bundle = nullptr);
+    ~SequenceAudioSource() override;
+
+    bool isValid() const { return current != nullptr; }
+    double getSampleRate() const { return sampleRate; }
+    const juce::Array<juce::File>& getFiles() const { return files; }
+    int getCurrentFileIndex() const { return currentIndex.load(); }
+
+    void setCrossfadeSamples(int samples) { crossfadeSamples.store(juce::jmax(0, samples)); }
+    int getCrossfadeSamples() const { return crossfadeSamples.load(); }
+
+    // Boundaries the next file wasn't ready for; should stay at zero
+    int getUnderrunCount() const { return underruns.load(); }
+
+    // PositionableAudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override;
+    juce::int64 getNextReadPosition() const override { return nextPlayPos.load(); }
+    juce::int64 getTotalLength() const override { return std::numeric_limits<juce::int64>::max(); }
+    bool isLooping() const override { return true; }
+
+    // RewindableSource overrides
+    void saveRewindState(int slot) override { rewindFiles[static_cast<size_t>(slot)] = currentIndex.load(); }
+    bool restoreRewindState(int slot) override { return rewindFiles[static_cast<size_t>(slot)] == currentIndex.load(); }
+
+private:
+    int useTimeSlice() override;
+
+    std::unique_ptr<StreamingAudioSource> openFrom(int& index) const;
+    bool swapToUpcoming();
+
+    juce::AudioFormatManager& formatManager;
+    juce::TimeSliceThread& thread;
+    const juce::Array<juce::File> files;
+    const size_t budgetPerFile;
+    const std::shared_ptr<const SoundscapeBundle> bundle;
+    double sampleRate = 0.0;
+
+    // Audio thread; the first file is opened by the constructor
+    std::unique_ptr<StreamingAudioSource> current;
+    juce::int64 currentLength = 0;
+    juce::int64 position = 0;
+    StreamingAudioSource* upcoming = nullptr;
+    int activeXfade = -1;   // fixed on entering the crossfade zone, -1 before
+    bool stalled = false;
+    juce::AudioBuffer<float> headScratch;
+    std::array<int, kRewindSlots> rewindFiles {};
+
+    // Hand-offs: the background thread publishes the next file in ready and
+    // deletes whatever the audio thread leaves in retired
+    std::atomic<StreamingAudioSource*> ready { nullptr };
+    std::atomic<int> readyIndex { 0 };
+    std::atomic<StreamingAudioSource*> retired { nullptr };
+    int preparedFor = -1;   // background thread only
+
+    std::atomic<int> currentIndex { 0 };
+    std::atomic<int> crossfadeSamples { 0 };
+    std::atomic<juce::int64> nextPlayPos { 0 };
+    std::atomic<juce::int64> pendingSeek { -1 };
+    std::atomic<int> underruns { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SequenceAudioSource)
+};
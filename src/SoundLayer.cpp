@@ -1,11 +1,14 @@
 #include "SoundLayer.h"
 
-SoundLayer::SoundLayer(juce::AudioFormatManager& fm, juce::TimeSliceThread& thread)
-    : formatManager(fm),
-      readAheadThread(thread),
-      waveformDisplay(fm)
+SoundLayer::SoundLayer(EngineLayer& engineLayer, juce::AudioFormatManager& fm, juce::AudioThumbnailCache& thumbnailCache)
+    : layer(engineLayer),
+      waveformDisplay(fm, thumbnailCache)
 {
-    waveformDisplay.setTransportSource(&transportSource);
+    waveformDisplay.setLayer(&layer);
+    waveformDisplay.onLoopEdited = [this] {
+        if (onLoopEdited)
+            onLoopEdited(this);
+    };
 
     removeButton.onClick = [this] {
         if (onRemove)
@@ -19,142 +22,273 @@ SoundLayer::SoundLayer(juce::AudioFormatManager& fm, juce::TimeSliceThread& thre
         }
     };
 
-    crossfadeSlider.setRange(0.0, 5000.0, 1.0);
+    crossfadeSlider.setRange(0.0, kMaxCrossfadeMs, 1.0);
+    crossfadeSlider.setSkewFactorFromMidPoint(5000.0);
     crossfadeSlider.setValue(0.0, juce::dontSendNotification);
     crossfadeSlider.setTextValueSuffix(" ms");
     crossfadeSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 60, 20);
     crossfadeSlider.setDoubleClickReturnValue(true, 0.0);
     crossfadeSlider.onValueChange = [this] {
-        if (loopingSource != nullptr && fileSampleRate > 0.0)
-        {
-            const int samples = static_cast<int>(crossfadeSlider.getValue() * fileSampleRate / 1000.0);
-            loopingSource->setCrossfadeSamples(samples);
-            waveformDisplay.repaint();
-        }
+        const auto fileSampleRate = layer.getFileSampleRate();
+        if (fileSampleRate <= 0.0)
+            return;
+
+        layer.setCrossfadeSamples(static_cast<int>(crossfadeSlider.getValue() * fileSampleRate / 1000.0));
+        waveformDisplay.repaint();
     };
 
+    findLoopButton.setTooltip("Search near the end handle for a seamless loop point");
+    findLoopButton.onClick = [this] {
+        if (onFindLoopPoint && layer.getLoopingSource() != nullptr)
+            onFindLoopPoint(this);
+    };
+
+    equalPowerButton.setTooltip("Equal-power crossfade, for material that doesn't line up");
+    equalPowerButton.onClick = [this] { layer.setCrossfadeEqualPower(equalPowerButton.getToggleState()); };
+
+    segmentsButton.setTooltip("Play further loop segments of this file in turn");
+    segmentsButton.onClick = [this] { showSegmentsMenu(); };
+
     crossfadeLabel.setJustificationType(juce::Justification::centredRight);
     crossfadeLabel.attachToComponent(&crossfadeSlider, true);
 
+    eventRateSlider.setRange(0.0, 600.0, 0.1);
+    eventRateSlider.setSkewFactorFromMidPoint(20.0);
+    eventRateSlider.setTextValueSuffix(" /min");
+    eventRateSlider.setTextBoxStyle(juce::Slider::TextBoxRight, false, 70, 20);
+    eventRateSlider.onValueChange = [this] {
+        if (layer.isEventLayer())
+        {
+            auto settings = layer.getEventSettings();
+            settings.eventsPerMinute = static_cast<float>(eventRateSlider.getValue());
+            layer.setEventSettings(settings);
+        }
+    };
+
+    eventRateLabel.setJustificationType(juce::Justification::centredRight);
+    eventRateLabel.attachToComponent(&eventRateSlider, true);
+
     volumeKnob.setSliderStyle(juce::Slider::RotaryVerticalDrag);
     volumeKnob.setRange(0.0, 1.5, 0.01);
     volumeKnob.setValue(1.0, juce::dontSendNotification);
     volumeKnob.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 14);
     volumeKnob.setDoubleClickReturnValue(true, 1.0);
-    volumeKnob.onValueChange = [this] {
-        transportSource.setGain(static_cast<float>(volumeKnob.getValue()));
-    };
+    volumeKnob.onValueChange = [this] { layer.setVolume(static_cast<float>(volumeKnob.getValue())); };
 
     volumeLabel.setJustificationType(juce::Justification::centred);
 
-    curveEditor.onCurveChanged = [this](float cx, float cy) {
-        if (loopingSource != nullptr)
-            loopingSource->setCrossfadeCurve(cx, cy);
-    };
+    autoGainButton.setTooltip("Match this loop to the preset's target loudness");
+    autoGainButton.onClick = [this] { layer.setAutoGainEnabled(autoGainButton.getToggleState()); };
+
+    setupToneKnob(highPassKnob, highPassLabel, LayerMixer::kMinHighPassHz, 2000.0, LayerMixer::kMinHighPassHz);
+    highPassKnob.setSkewFactorFromMidPoint(200.0);
+
+    setupToneKnob(tiltKnob, tiltLabel, -LayerMixer::kMaxTiltDb, LayerMixer::kMaxTiltDb, 0.0);
+
+    setupToneKnob(lowPassKnob, lowPassLabel, 200.0, LayerMixer::kMaxLowPassHz, LayerMixer::kMaxLowPassHz);
+    lowPassKnob.setSkewFactorFromMidPoint(2000.0);
+
+    setupToneKnob(azimuthKnob, azimuthLabel, -LayerMixer::kMaxAzimuthDegrees, LayerMixer::kMaxAzimuthDegrees, 0.0);
+
+    setupToneKnob(distanceKnob, distanceLabel, 1.0, LayerMixer::kMaxDistanceMetres, 1.0);
+    distanceKnob.setSkewFactorFromMidPoint(10.0);
+    distanceKnob.setTextValueSuffix(" m");
+
+    setupToneKnob(widthKnob, widthLabel, 0.0, 1.0, 1.0);
+    widthKnob.setRange(0.0, 1.0, 0.01);
+
+    curveEditor.onCurveChanged = [this](float cx, float cy) { layer.setCrossfadeCurve(cx, cy); };
+
+    // Show the layer as the engine loaded it.  Nothing is written back: the
+    // engine has already clamped the preset, and a write would redo the
+    // render ahead every time a row scrolls into view.
+    const auto settings = layer.describe();
+
+    volumeKnob.setValue(static_cast<double>(settings.volume), juce::dontSendNotification);
+    autoGainButton.setToggleState(settings.autoGain, juce::dontSendNotification);
+    equalPowerButton.setToggleState(settings.equalPower, juce::dontSendNotification);
+
+    highPassKnob.setValue(static_cast<double>(settings.tone.highPassHz), juce::dontSendNotification);
+    tiltKnob.setValue(static_cast<double>(settings.tone.tiltDb), juce::dontSendNotification);
+    lowPassKnob.setValue(static_cast<double>(settings.tone.lowPassHz), juce::dontSendNotification);
+    azimuthKnob.setValue(static_cast<double>(settings.tone.azimuthDegrees), juce::dontSendNotification);
+    distanceKnob.setValue(static_cast<double>(settings.tone.distanceMetres), juce::dontSendNotification);
+    widthKnob.setValue(static_cast<double>(settings.tone.width), juce::dontSendNotification);
+
+    if (auto* looping = layer.getLoopingSource())
+    {
+        curveEditor.setControlPoint(settings.curveX, settings.curveY);
+        setLoopControlsEnabled(true);
+        showCrossfade(settings.crossfadeSamples);
+
+        waveformDisplay.setSampleRate(layer.getFileSampleRate());
+        waveformDisplay.setTotalLength(layer.getTotalLength());
+        waveformDisplay.setLoopingSource(looping);
+        showPlaylist(settings.playlist);
+    }
+    else if (layer.isSequence())
+    {
+        // The waveform shows where the sequence starts; there are no handles to drag
+        setLoopControlsEnabled(false);
+        showCrossfade(settings.crossfadeSamples);
+        waveformDisplay.setSampleRate(layer.getFileSampleRate());
+    }
+    else
+    {
+        setLoopControlsEnabled(false);
+        crossfadeSlider.setVisible(false);
+        eventRateSlider.setVisible(true);
+        eventRateSlider.setValue(settings.eventSettings.eventsPerMinute, juce::dontSendNotification);
+    }
+
+    if (auto* embedded = layer.getEmbeddedAudio())
+        waveformDisplay.setSummary(embedded);
+    else
+        waveformDisplay.setFile(layer.getFilePath());
 
     addAndMakeVisible(waveformDisplay);
+    addAndMakeVisible(levelMeter);
     addAndMakeVisible(removeButton);
     addAndMakeVisible(volumeKnob);
     addAndMakeVisible(volumeLabel);
-    addAndMakeVisible(crossfadeSlider);
+    addAndMakeVisible(autoGainButton);
+    addAndMakeVisible(findLoopButton);
+    addAndMakeVisible(equalPowerButton);
+    addAndMakeVisible(segmentsButton);
+    addChildComponent(crossfadeSlider);
     addAndMakeVisible(crossfadeLabel);
+    addChildComponent(eventRateSlider);
     addAndMakeVisible(curveEditor);
 }
 
-SoundLayer::~SoundLayer()
+void SoundLayer::setLoopControlsEnabled(bool enabled)
 {
-    transportSource.stop();
-    transportSource.setSource(nullptr);
-    loopingSource.reset();
-    readerSource.reset();
+    juce::Component* loopControls[] = { &findLoopButton, &equalPowerButton, &segmentsButton,
+                                        &curveEditor, &autoGainButton };
+
+    for (auto* control : loopControls)
+        control->setEnabled(enabled);
 }
 
-bool SoundLayer::loadFile(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
-                          int crossfadeSamples, float curveX, float curveY)
+void SoundLayer::showCrossfade(int samples)
 {
-    transportSource.stop();
-    transportSource.setSource(nullptr);
-    loopingSource.reset();
-    readerSource.reset();
-
-    auto* reader = formatManager.createReaderFor(file);
-    if (reader == nullptr)
-        return false;
-
-    fileSampleRate = reader->sampleRate;
-
-    auto totalSamples = static_cast<juce::int64>(reader->lengthInSamples);
-    if (loopEnd < 0 || loopEnd > totalSamples)
-        loopEnd = totalSamples;
-    if (loopStart < 0 || loopStart >= loopEnd)
-        loopStart = 0;
-
-    readerSource = std::make_unique<juce::AudioFormatReaderSource>(reader, true);
-    loopingSource = std::make_unique<LoopingAudioSource>(readerSource.get(), false);
-    loopingSource->setLoopRange(loopStart, loopEnd);
-    loopingSource->setLooping(true);
-    loopingSource->setCrossfadeSamples(crossfadeSamples);
-    loopingSource->setCrossfadeCurve(curveX, curveY);
-
-    curveEditor.setControlPoint(curveX, curveY);
+    const auto fileSampleRate = layer.getFileSampleRate();
+    crossfadeSlider.setVisible(true);
+    crossfadeSlider.setValue(fileSampleRate > 0.0 ? static_cast<double>(samples) / fileSampleRate * 1000.0 : 0.0,
+                             juce::dontSendNotification);
+}
 
-    transportSource.setSource(loopingSource.get(), 32768, &readAheadThread, reader->sampleRate);
+void SoundLayer::applyLoopSuggestion(const LoopPointFinder::Suggestion& suggestion)
+{
+    if (layer.getLoopingSource() == nullptr || layer.getFileSampleRate() <= 0.0)
+        return;
 
-    waveformDisplay.setSampleRate(reader->sampleRate);
-    waveformDisplay.setLoopingSource(loopingSource.get());
-    waveformDisplay.setFile(file);
+    layer.applyLoopSuggestion(suggestion);
 
-    // Set slider to match loaded crossfade value
-    if (fileSampleRate > 0.0)
-        crossfadeSlider.setValue(static_cast<double>(crossfadeSamples) / fileSampleRate * 1000.0, juce::dontSendNotification);
-    else
-        crossfadeSlider.setValue(0.0, juce::dontSendNotification);
+    curveEditor.setControlPoint(suggestion.curveX, suggestion.curveY);
+    equalPowerButton.setToggleState(suggestion.equalPower, juce::dontSendNotification);
+    showCrossfade(suggestion.crossfadeSamples);
+    waveformDisplay.repaint();
 
-    filePath = file;
-    return true;
+    if (onLoopEdited)
+        onLoopEdited(this);
 }
 
-int SoundLayer::getCrossfadeSamples() const
+void SoundLayer::setPlaylist(const LoopingAudioSource::Playlist& playlist)
 {
-    if (loopingSource != nullptr)
-        return loopingSource->getCrossfadeSamples();
-    return 0;
-}
+    if (layer.getLoopingSource() == nullptr)
+        return;
 
-float SoundLayer::getCrossfadeCurveX() const
-{
-    if (loopingSource != nullptr)
-        return loopingSource->getCurveX();
-    return curveEditor.getControlPointX();
+    layer.setPlaylist(playlist);
+    showPlaylist(playlist);
 }
 
-float SoundLayer::getCrossfadeCurveY() const
+void SoundLayer::showPlaylist(const LoopingAudioSource::Playlist& playlist)
 {
-    if (loopingSource != nullptr)
-        return loopingSource->getCurveY();
-    return curveEditor.getControlPointY();
+    segmentsButton.setButtonText(playlist.numSegments > 0 ? "Segments (" + juce::String(playlist.numSegments) + ")"
+                                                          : juce::String("Segments"));
+    waveformDisplay.repaint();
 }
 
-float SoundLayer::getVolume() const
+void SoundLayer::showSegmentsMenu()
 {
-    return transportSource.getGain();
+    auto* looping = layer.getLoopingSource();
+    if (looping == nullptr)
+        return;
+
+    const auto playlist = looping->getPlaylist();
+    const bool full = playlist.numSegments >= LoopingAudioSource::kMaxSegments;
+
+    juce::PopupMenu menu;
+    menu.addItem(1, "Add current loop as segment", !full);
+    menu.addItem(2, "Random order", playlist.numSegments > 0, playlist.randomOrder);
+    menu.addSeparator();
+    menu.addItem(3, "Clear segments", playlist.numSegments > 0);
+
+    auto safeThis = juce::Component::SafePointer<SoundLayer>(this);
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&segmentsButton),
+                       [safeThis](int result) {
+        auto* self = safeThis.getComponent();
+        if (self == nullptr || result == 0)
+            return;
+
+        auto* loop = self->layer.getLoopingSource();
+        if (loop == nullptr)
+            return;
+
+        auto updated = loop->getPlaylist();
+
+        if (result == 1 && updated.numSegments < LoopingAudioSource::kMaxSegments)
+        {
+            // Snapshot the handles; moving them afterwards edits the main loop only
+            auto& segment = updated.segments[static_cast<size_t>(updated.numSegments++)];
+            segment.start = loop->getLoopStart();
+            segment.end = loop->getLoopEnd();
+            segment.weight = 1.0f;
+        }
+        else if (result == 2)
+        {
+            updated.randomOrder = !updated.randomOrder;
+        }
+        else if (result == 3)
+        {
+            updated = {};
+        }
+
+        self->setPlaylist(updated);
+    });
 }
 
-void SoundLayer::setVolume(float v)
+void SoundLayer::setAnimating(bool shouldAnimate)
 {
-    volumeKnob.setValue(static_cast<double>(v), juce::dontSendNotification);
-    transportSource.setGain(v);
+    waveformDisplay.setAnimating(shouldAnimate);
+    levelMeter.setAnimating(shouldAnimate);
 }
 
-void SoundLayer::startPlayback()
+void SoundLayer::setupToneKnob(juce::Slider& knob, juce::Label& label, double min, double max,
+                               double defaultValue)
 {
-    if (readerSource != nullptr)
-        transportSource.start();
+    knob.setSliderStyle(juce::Slider::RotaryVerticalDrag);
+    knob.setRange(min, max, max > 100.0 ? 1.0 : 0.1);
+    knob.setValue(defaultValue, juce::dontSendNotification);
+    knob.setTextBoxStyle(juce::Slider::TextBoxBelow, false, 40, 14);
+    knob.setDoubleClickReturnValue(true, defaultValue);
+    knob.onValueChange = [this] { applyTone(); };
+
+    label.setJustificationType(juce::Justification::centred);
+
+    addAndMakeVisible(knob);
+    addAndMakeVisible(label);
 }
 
-void SoundLayer::stopPlayback()
+void SoundLayer::applyTone()
 {
-    transportSource.stop();
+    layer.setTone({ static_cast<float>(highPassKnob.getValue()),
+                    static_cast<float>(lowPassKnob.getValue()),
+                    static_cast<float>(tiltKnob.getValue()),
+                    static_cast<float>(azimuthKnob.getValue()),
+                    static_cast<float>(distanceKnob.getValue()),
+                    static_cast<float>(widthKnob.getValue()) });
 }
 
 void SoundLayer::resized()
@@ -168,9 +302,28 @@ void SoundLayer::resized()
     auto volumeArea = controlStrip.removeFromLeft(50);
     volumeKnob.setBounds(volumeArea.removeFromTop(50));
     volumeLabel.setBounds(volumeArea);
+    autoGainButton.setBounds(controlStrip.removeFromLeft(56).withSizeKeepingCentre(56, 24));
+
+    for (auto knobAndLabel : { std::make_pair(&highPassKnob, &highPassLabel),
+                               std::make_pair(&tiltKnob, &tiltLabel),
+                               std::make_pair(&lowPassKnob, &lowPassLabel),
+                               std::make_pair(&azimuthKnob, &azimuthLabel),
+                               std::make_pair(&distanceKnob, &distanceLabel),
+                               std::make_pair(&widthKnob, &widthLabel) })
+    {
+        auto knobArea = controlStrip.removeFromLeft(50);
+        knobAndLabel.first->setBounds(knobArea.removeFromTop(50));
+        knobAndLabel.second->setBounds(knobArea);
+    }
+
+    findLoopButton.setBounds(controlStrip.removeFromLeft(56).withSizeKeepingCentre(48, 24));
+    equalPowerButton.setBounds(controlStrip.removeFromLeft(90).withSizeKeepingCentre(86, 24));
+    segmentsButton.setBounds(controlStrip.removeFromLeft(100).withSizeKeepingCentre(94, 24));
 
     controlStrip.removeFromLeft(50); // space for XFade label
     crossfadeSlider.setBounds(controlStrip);
+    eventRateSlider.setBounds(controlStrip);
 
+    levelMeter.setBounds(area.removeFromRight(16));
     waveformDisplay.setBounds(area);
 }
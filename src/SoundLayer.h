@@ -1,59 +1,77 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "LoopingAudioSource.h"
+#include "EngineLayer.h"
 #include "WaveformDisplay.h"
 #include "CrossfadeCurveEditor.h"
+#include "LevelMeter.h"
+#include "LoopPointFinder.h"
 
+// The controls for one EngineLayer.  The engine owns the audio; this only
+// shows it and passes edits on, so it must go before its layer does.  It
+// holds no state of its own, so it can be dropped when scrolled out of sight
+// and made again from the layer.  Waveforms come from the shared cache.
 class SoundLayer : public juce::Component
 {
 public:
-    SoundLayer(juce::AudioFormatManager& formatManager, juce::TimeSliceThread& readAheadThread);
-    ~SoundLayer() override;
+    SoundLayer(EngineLayer& layer, juce::AudioFormatManager& formatManager,
+               juce::AudioThumbnailCache& thumbnailCache);
 
-    bool loadFile(const juce::File& file, juce::int64 loopStart, juce::int64 loopEnd,
-                  int crossfadeSamples = 0, float curveX = 0.25f, float curveY = 0.75f);
-    int getCrossfadeSamples() const;
-    float getCrossfadeCurveX() const;
-    float getCrossfadeCurveY() const;
+    EngineLayer& getEngineLayer() { return layer; }
 
-    float getVolume() const;
-    void setVolume(float v);
+    // EngineLayer::applyLoopSuggestion(), with the controls following
+    void applyLoopSuggestion(const LoopPointFinder::Suggestion& suggestion);
 
-    void startPlayback();
-    void stopPlayback();
-
-    juce::AudioTransportSource& getTransportSource() { return transportSource; }
-    const juce::AudioTransportSource& getTransportSource() const { return transportSource; }
-    LoopingAudioSource* getLoopingSource() { return loopingSource.get(); }
-    const juce::File& getFilePath() const { return filePath; }
-    bool isFileLoaded() const { return readerSource != nullptr; }
+    // Stops the waveform and meter refreshing while the window is out of sight
+    void setAnimating(bool shouldAnimate);
 
     std::function<void(SoundLayer*)> onRemove;
+    std::function<void(SoundLayer*)> onLoopEdited;
+    std::function<void(SoundLayer*)> onFindLoopPoint;
 
     void resized() override;
 
 private:
-    juce::AudioFormatManager& formatManager;
-    juce::TimeSliceThread& readAheadThread;
+    void showCrossfade(int samples);
+    void setPlaylist(const LoopingAudioSource::Playlist& playlist);
+    void showPlaylist(const LoopingAudioSource::Playlist& playlist);
+    void applyTone();
+    void setLoopControlsEnabled(bool enabled);
+    void showSegmentsMenu();
+    void setupToneKnob(juce::Slider& knob, juce::Label& label, double min, double max,
+                       double defaultValue);
 
-    // Audio chain
-    std::unique_ptr<juce::AudioFormatReaderSource> readerSource;
-    std::unique_ptr<LoopingAudioSource> loopingSource;
-    juce::AudioTransportSource transportSource;
+    EngineLayer& layer;
 
     // GUI
     WaveformDisplay waveformDisplay;
+    LevelMeter levelMeter { layer.getAnalysisTap() };
     juce::TextButton removeButton { "X" };
     juce::Slider volumeKnob;
     juce::Label volumeLabel { {}, "Vol" };
+    juce::ToggleButton autoGainButton { "Auto" };
+    juce::Slider highPassKnob;
+    juce::Label highPassLabel { {}, "HPF" };
+    juce::Slider tiltKnob;
+    juce::Label tiltLabel { {}, "Tilt" };
+    juce::Slider lowPassKnob;
+    juce::Label lowPassLabel { {}, "LPF" };
+    juce::Slider azimuthKnob;
+    juce::Label azimuthLabel { {}, "Pan" };
+    juce::Slider distanceKnob;
+    juce::Label distanceLabel { {}, "Dist" };
+    juce::Slider widthKnob;
+    juce::Label widthLabel { {}, "Width" };
+    juce::TextButton findLoopButton { "Find" };
+    juce::ToggleButton equalPowerButton { "Eq. power" };
+    juce::TextButton segmentsButton { "Segments" };
     juce::Slider crossfadeSlider;
     juce::Label crossfadeLabel { {}, "XFade" };
+    juce::Slider eventRateSlider;
+    juce::Label eventRateLabel { {}, "Rate" };
     CrossfadeCurveEditor curveEditor;
 
-    // State
-    juce::File filePath;
-    double fileSampleRate = 0.0;
+    static constexpr double kMaxCrossfadeMs = 300000.0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoundLayer)
 };
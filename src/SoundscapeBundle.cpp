@@ -0,0 +1,565 @@
+#include "SoundscapeBundle.h"
+
+void BundleAudio::read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples, juce::int64 filePos) const
+{
+    const auto offset = filePos - regionStart;
+    const auto total = static_cast<juce::int64>(numSamples);
+    const auto first = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0), total, -offset));
+    const auto last = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0), total, regionLength - offset));
+
+    if (first > 0)
+        dest.clear(destStartSample, first);
+    if (last < numSamples)
+        dest.clear(destStartSample + last, numSamples - last);
+    if (last <= first)
+        return;
+
+    const auto at = static_cast<size_t>(offset + first);
+    const int count = last - first;
+
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+    {
+        const auto* plane = planes + planeStride * static_cast<size_t>(juce::jmin(ch, numChannels - 1));
+        auto* out = dest.getWritePointer(ch, destStartSample + first);
+
+        if (format == Format::Float32)
+        {
+            juce::FloatVectorOperations::copy(out, reinterpret_cast<const float*>(plane) + at, count);
+            continue;
+        }
+
+        const auto* in = reinterpret_cast<const juce::int16*>(plane) + at;
+        for (int i = 0; i < count; ++i)
+            out[i] = static_cast<float>(in[i]) * (1.0f / 32768.0f);
+    }
+}
+
+void BundleAudio::touch(juce::int64 start, juce::int64 end) const
+{
+    start = juce::jmax(start, regionStart) - regionStart;
+    end = juce::jmin(end, regionStart + regionLength) - regionStart;
+    if (end <= start)
+        return;
+
+    const auto bytes = static_cast<juce::int64>(format == Format::Int16 ? 2 : 4);
+    volatile char sink = 0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        const auto* plane = planes + planeStride * static_cast<size_t>(ch);
+
+        for (auto offset = start * bytes / 4096 * 4096; offset < end * bytes; offset += 4096)
+            sink = static_cast<char>(sink + plane[offset]);
+    }
+}
+
+juce::Range<float> BundleAudio::getLevelRange(int channel, juce::int64 start, juce::int64 end) const
+{
+    const auto firstBucket = juce::jmax(static_cast<juce::int64>(0), (start - regionStart) / kSummaryBucket);
+    const auto lastBucket = juce::jmin(static_cast<juce::int64>(numBuckets),
+                                       (end - regionStart + kSummaryBucket - 1) / kSummaryBucket);
+
+    if (summary == nullptr || lastBucket <= firstBucket || end <= regionStart)
+        return {};
+
+    const auto* pairs = summary + 2 * static_cast<size_t>(numBuckets) * static_cast<size_t>(juce::jlimit(0, numChannels - 1, channel));
+    int low = 127, high = -127;
+
+    for (auto bucket = firstBucket; bucket < lastBucket; ++bucket)
+    {
+        low = juce::jmin(low, static_cast<int>(pairs[2 * bucket]));
+        high = juce::jmax(high, static_cast<int>(pairs[2 * bucket + 1]));
+    }
+
+    return { static_cast<float>(low) / 127.0f, static_cast<float>(high) / 127.0f };
+}
+
+SoundscapeBundle::SoundscapeBundle(const juce::File& file)
+    : mapped(file, juce::MemoryMappedFile::readOnly, false)
+{
+    valid = parse();
+
+    if (!valid)
+    {
+        preset = {};
+        audio.clear();
+    }
+}
+
+const BundleAudio* SoundscapeBundle::findAudio(const juce::File& source) const
+{
+    for (const auto& entry : audio)
+        if (entry.source == source)
+            return &entry;
+
+    return nullptr;
+}
+
+// Layout, with the header and table little-endian and the PCM in native
+// order (little-endian on everything the app builds for):
+//   magic, version, entry count, state size     4 x int32
+//   engine state                                 writeState()
+//   entry table                                  writeTable()
+//   per entry, page aligned: one plane per channel, then the summary
+bool SoundscapeBundle::parse()
+{
+    const auto* data = static_cast<const char*>(mapped.getData());
+    const auto size = static_cast<juce::int64>(mapped.getSize());
+
+    if (data == nullptr || size < kHeaderBytes)
+        return false;
+
+    juce::MemoryInputStream in(data, static_cast<size_t>(size), false);
+
+    if (in.readInt() != kMagic || in.readInt() != kVersion)
+        return false;
+
+    const int numEntries = in.readInt();
+    const int stateBytes = in.readInt();
+
+    if (numEntries < 0 || stateBytes < 0 || kHeaderBytes + static_cast<juce::int64>(stateBytes) > size)
+        return false;
+
+    juce::MemoryInputStream stateIn(data + kHeaderBytes, static_cast<size_t>(stateBytes), false);
+    if (!readState(stateIn, preset))
+        return false;
+
+    in.setPosition(kHeaderBytes + stateBytes);
+    audio.reserve(static_cast<size_t>(numEntries));
+
+    for (int i = 0; i < numEntries; ++i)
+    {
+        BundleAudio entry;
+        entry.source = juce::File(in.readString());
+        entry.sampleRate = in.readDouble();
+        entry.numChannels = in.readInt();
+        const int format = in.readInt();
+        entry.totalLength = in.readInt64();
+        entry.regionStart = in.readInt64();
+        entry.regionLength = in.readInt64();
+        const auto dataOffset = in.readInt64();
+        const auto planeStride = in.readInt64();
+        const auto summaryOffset = in.readInt64();
+        entry.numBuckets = in.readInt();
+
+        if (entry.sampleRate <= 0.0 || entry.numChannels < 1 || entry.numChannels > kMaxChannels
+            || (format != static_cast<int>(BundleAudio::Format::Float32) && format != static_cast<int>(BundleAudio::Format::Int16)))
+            return false;
+
+        entry.format = static_cast<BundleAudio::Format>(format);
+
+        // Every term is checked against the file size before it's combined
+        // with another, so a corrupt table can't overflow its way past these
+        const auto bytes = static_cast<juce::int64>(bytesPerSample(entry.format));
+
+        if (entry.totalLength < 0 || entry.regionStart < 0 || entry.regionStart > entry.totalLength
+            || entry.regionLength < 0 || entry.regionLength > entry.totalLength - entry.regionStart
+            || entry.regionLength > size / bytes)
+            return false;
+
+        if (dataOffset < 0 || dataOffset > size || dataOffset % kAlignment != 0
+            || planeStride < entry.regionLength * bytes || planeStride % bytes != 0
+            || planeStride > (size - dataOffset) / entry.numChannels)
+            return false;
+
+        if (entry.numBuckets != static_cast<int>((entry.regionLength + BundleAudio::kSummaryBucket - 1) / BundleAudio::kSummaryBucket)
+            || summaryOffset < 0 || summaryOffset > size
+            || static_cast<juce::int64>(entry.numBuckets) * 2 * entry.numChannels > size - summaryOffset)
+            return false;
+
+        entry.planes = data + dataOffset;
+        entry.planeStride = static_cast<size_t>(planeStride);
+        entry.summary = reinterpret_cast<const juce::int8*>(data + summaryOffset);
+        audio.push_back(entry);
+    }
+
+    // As with a JSON preset, samples that can't be found are dropped and a
+    // loop is left for the caller
+    for (auto& layer : preset.layers)
+    {
+        if (layer.kind == PresetLayer::Kind::Loop)
+            continue;
+
+        for (int i = layer.files.size(); --i >= 0;)
+        {
+            if (findAudio(layer.files[i]) == nullptr && !layer.files[i].existsAsFile())
+            {
+                juce::Logger::writeToLog("Bundled sample missing: " + layer.files[i].getFullPathName());
+                layer.files.remove(i);
+            }
+        }
+    }
+
+    return true;
+}
+
+void SoundscapeBundle::writeState(juce::OutputStream& out, const Preset& state)
+{
+    out.writeFloat(state.masterVolume);
+    out.writeFloat(state.hpfCutoff);
+    out.writeFloat(state.lowShelfGain);
+    out.writeFloat(state.highShelfGain);
+    out.writeFloat(state.lpfCutoff);
+    out.writeDouble(state.targetLoudness);
+    out.writeString(state.reverbImpulse.getFullPathName());
+    out.writeFloat(state.reverbWet);
+    out.writeDouble(state.fadeInSeconds);
+    out.writeDouble(state.fadeOutSeconds);
+    out.writeDouble(state.startGridSeconds);
+    out.writeInt(static_cast<int>(state.layers.size()));
+
+    for (const auto& layer : state.layers)
+    {
+        out.writeInt(static_cast<int>(layer.kind));
+        out.writeInt(layer.files.size());
+        for (const auto& file : layer.files)
+            out.writeString(file.getFullPathName());
+
+        out.writeInt64(layer.loopStart);
+        out.writeInt64(layer.loopEnd);
+        out.writeInt(layer.crossfadeSamples);
+        out.writeFloat(layer.curveX);
+        out.writeFloat(layer.curveY);
+        out.writeBool(layer.equalPower);
+        out.writeFloat(layer.volume);
+        out.writeBool(layer.autoGain);
+        out.writeDouble(layer.measuredLoudness);
+
+        out.writeFloat(layer.tone.highPassHz);
+        out.writeFloat(layer.tone.lowPassHz);
+        out.writeFloat(layer.tone.tiltDb);
+        out.writeFloat(layer.tone.azimuthDegrees);
+        out.writeFloat(layer.tone.distanceMetres);
+        out.writeFloat(layer.tone.width);
+
+        const auto& playlist = layer.playlist;
+        out.writeInt(playlist.numSegments);
+        for (int i = 0; i < playlist.numSegments; ++i)
+        {
+            const auto& segment = playlist.segments[static_cast<size_t>(i)];
+            out.writeInt64(segment.start);
+            out.writeInt64(segment.end);
+            out.writeFloat(segment.weight);
+        }
+
+        out.writeBool(playlist.randomOrder);
+        out.writeFloat(playlist.primaryWeight);
+
+        const auto& settings = layer.eventSettings;
+        out.writeFloat(settings.eventsPerMinute);
+        out.writeFloat(settings.gainJitterDb);
+        out.writeFloat(settings.panSpread);
+        out.writeInt64(settings.seed);
+    }
+}
+
+bool SoundscapeBundle::readState(juce::InputStream& in, Preset& state)
+{
+    state = {};
+    state.masterVolume = in.readFloat();
+    state.hpfCutoff = in.readFloat();
+    state.lowShelfGain = in.readFloat();
+    state.highShelfGain = in.readFloat();
+    state.lpfCutoff = in.readFloat();
+    state.targetLoudness = in.readDouble();
+
+    const auto impulsePath = in.readString();
+    if (impulsePath.isNotEmpty())
+        state.reverbImpulse = juce::File(impulsePath);
+
+    state.reverbWet = in.readFloat();
+    state.fadeInSeconds = in.readDouble();
+    state.fadeOutSeconds = in.readDouble();
+    state.startGridSeconds = in.readDouble();
+
+    const int numLayers = in.readInt();
+    if (numLayers < 0)
+        return false;
+
+    for (int l = 0; l < numLayers; ++l)
+    {
+        // A short read comes back as zeros, so a damaged file mostly shows
+        // up as running out early
+        if (in.isExhausted())
+            return false;
+
+        PresetLayer layer;
+        const int kind = in.readInt();
+        if (kind < static_cast<int>(PresetLayer::Kind::Loop) || kind > static_cast<int>(PresetLayer::Kind::Events))
+            return false;
+
+        layer.kind = static_cast<PresetLayer::Kind>(kind);
+
+        const int numFiles = in.readInt();
+        if (numFiles < 0 || numFiles > in.getNumBytesRemaining())
+            return false;
+
+        for (int i = 0; i < numFiles && !in.isExhausted(); ++i)
+            layer.files.add(juce::File(in.readString()));
+
+        layer.loopStart = in.readInt64();
+        layer.loopEnd = in.readInt64();
+        layer.crossfadeSamples = in.readInt();
+        layer.curveX = in.readFloat();
+        layer.curveY = in.readFloat();
+        layer.equalPower = in.readBool();
+        layer.volume = in.readFloat();
+        layer.autoGain = in.readBool();
+        layer.measuredLoudness = in.readDouble();
+
+        layer.tone.highPassHz = in.readFloat();
+        layer.tone.lowPassHz = in.readFloat();
+        layer.tone.tiltDb = in.readFloat();
+        layer.tone.azimuthDegrees = in.readFloat();
+        layer.tone.distanceMetres = in.readFloat();
+        layer.tone.width = in.readFloat();
+
+        auto& playlist = layer.playlist;
+        playlist.numSegments = in.readInt();
+        if (playlist.numSegments < 0 || playlist.numSegments > LoopingAudioSource::kMaxSegments)
+            return false;
+
+        for (int i = 0; i < playlist.numSegments; ++i)
+        {
+            auto& segment = playlist.segments[static_cast<size_t>(i)];
+            segment.start = in.readInt64();
+            segment.end = in.readInt64();
+            segment.weight = in.readFloat();
+        }
+
+        playlist.randomOrder = in.readBool();
+        playlist.primaryWeight = in.readFloat();
+
+        auto& settings = layer.eventSettings;
+        settings.eventsPerMinute = in.readFloat();
+        settings.gainJitterDb = in.readFloat();
+        settings.panSpread = in.readFloat();
+        settings.seed = in.readInt64();
+
+        state.layers.push_back(layer);
+    }
+
+    return true;
+}
+
+void SoundscapeBundle::writeTable(juce::OutputStream& out, const std::vector<std::unique_ptr<Source>>& sources)
+{
+    for (const auto& source : sources)
+    {
+        out.writeString(source->file.getFullPathName());
+        out.writeDouble(source->sampleRate);
+        out.writeInt(source->numChannels);
+        out.writeInt(static_cast<int>(source->format));
+        out.writeInt64(source->totalLength);
+        out.writeInt64(source->start);
+        out.writeInt64(source->end - source->start);
+        out.writeInt64(source->dataOffset);
+        out.writeInt64(source->planeStride);
+        out.writeInt64(source->summaryOffset);
+        out.writeInt(source->numBuckets);
+    }
+}
+
+SoundscapeBundle::Source* SoundscapeBundle::addSource(std::vector<std::unique_ptr<Source>>& sources,
+                                                      const juce::File& file, juce::AudioFormatManager& formatManager,
+                                                      const std::function<const BundleAudio*(const juce::File&)>& findEmbedded)
+{
+    for (auto& existing : sources)
+        if (existing->file == file)
+            return existing.get();
+
+    auto source = std::make_unique<Source>();
+    source->file = file;
+
+    // The original file when there is one, since an embedded copy only
+    // holds the region its last bundle needed
+    if (file.existsAsFile())
+        source->reader.reset(formatManager.createReaderFor(file));
+
+    if (source->reader != nullptr && source->reader->sampleRate > 0.0 && source->reader->lengthInSamples > 0)
+    {
+        auto& reader = *source->reader;
+        source->sampleRate = reader.sampleRate;
+        source->numChannels = juce::jlimit(1, kMaxChannels, static_cast<int>(reader.numChannels));
+        source->totalLength = reader.lengthInSamples;
+        source->format = !reader.usesFloatingPointData && reader.bitsPerSample <= 16
+            ? BundleAudio::Format::Int16 : BundleAudio::Format::Float32;
+    }
+    else if (auto* embedded = findEmbedded != nullptr ? findEmbedded(file) : nullptr)
+    {
+        source->reader.reset();
+        source->embedded = embedded;
+        source->sampleRate = embedded->sampleRate;
+        source->numChannels = embedded->numChannels;
+        source->totalLength = embedded->totalLength;
+        source->format = embedded->format;
+    }
+    else
+    {
+        return nullptr;
+    }
+
+    // Empty until a layer claims part of it
+    source->start = source->totalLength;
+    source->end = 0;
+
+    sources.push_back(std::move(source));
+    return sources.back().get();
+}
+
+bool SoundscapeBundle::write(const juce::File& file, const Preset& preset, juce::AudioFormatManager& formatManager,
+                             const std::function<const BundleAudio*(const juce::File&)>& findEmbedded)
+{
+    std::vector<std::unique_ptr<Source>> sources;
+
+    for (const auto& layer : preset.layers)
+    {
+        for (const auto& layerFile : layer.files)
+        {
+            auto* source = addSource(sources, layerFile, formatManager, findEmbedded);
+            if (source == nullptr)
+            {
+                juce::Logger::writeToLog("Couldn't read for bundle: " + layerFile.getFullPathName());
+                return false;
+            }
+
+            auto start = static_cast<juce::int64>(0);
+            auto end = source->totalLength;
+
+            if (layer.kind == PresetLayer::Kind::Loop)
+            {
+                start = layer.loopStart;
+                end = layer.loopEnd < 0 ? source->totalLength : layer.loopEnd;
+
+                for (int i = 0; i < layer.playlist.numSegments; ++i)
+                {
+                    const auto& segment = layer.playlist.segments[static_cast<size_t>(i)];
+                    start = juce::jmin(start, segment.start);
+                    end = juce::jmax(end, segment.end);
+                }
+            }
+            else if (layer.kind == PresetLayer::Kind::Events)
+            {
+                end = juce::jmin(end, static_cast<juce::int64>(OneShotEventSource::kMaxSampleSeconds * source->sampleRate));
+            }
+
+            source->start = juce::jmin(source->start, juce::jlimit(static_cast<juce::int64>(0), source->totalLength, start));
+            source->end = juce::jmax(source->end, juce::jlimit(static_cast<juce::int64>(0), source->totalLength, end));
+        }
+    }
+
+    juce::MemoryOutputStream state;
+    writeState(state, preset);
+
+    // Entries are fixed size apart from their paths, so the table can be
+    // measured before the offsets in it are known
+    juce::MemoryOutputStream table;
+    writeTable(table, sources);
+    auto offset = align(kHeaderBytes + static_cast<juce::int64>(state.getDataSize() + table.getDataSize()));
+
+    for (auto& source : sources)
+    {
+        if (source->end <= source->start)
+            source->start = source->end = 0;
+
+        const auto length = source->end - source->start;
+        source->planeStride = align(length * bytesPerSample(source->format));
+        source->numBuckets = static_cast<int>((length + BundleAudio::kSummaryBucket - 1) / BundleAudio::kSummaryBucket);
+        source->dataOffset = offset;
+        source->summaryOffset = offset + source->planeStride * source->numChannels;
+        offset = align(source->summaryOffset + static_cast<juce::int64>(source->numBuckets) * 2 * source->numChannels);
+    }
+
+    table.reset();
+    writeTable(table, sources);
+
+    juce::TemporaryFile temp(file);
+
+    {
+        juce::FileOutputStream out(temp.getFile());
+        if (!out.openedOk())
+            return false;
+
+        out.writeInt(kMagic);
+        out.writeInt(kVersion);
+        out.writeInt(static_cast<int>(sources.size()));
+        out.writeInt(static_cast<int>(state.getDataSize()));
+        out.write(state.getData(), state.getDataSize());
+        out.write(table.getData(), table.getDataSize());
+
+        for (auto& source : sources)
+            if (!writeAudio(out, *source))
+                return false;
+
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+// Reads the region once, a chunk at a time, putting each channel's share in
+// its plane and summarising as it goes
+bool SoundscapeBundle::writeAudio(juce::OutputStream& out, Source& source)
+{
+    const auto length = source.end - source.start;
+    const auto bytes = bytesPerSample(source.format);
+
+    juce::AudioBuffer<float> chunk(source.numChannels, kChunkSamples);
+    std::vector<juce::int16> packed(source.format == BundleAudio::Format::Int16 ? static_cast<size_t>(kChunkSamples) : 0);
+    std::vector<juce::int8> summary(static_cast<size_t>(source.numBuckets) * 2 * static_cast<size_t>(source.numChannels));
+
+    for (size_t i = 0; i < summary.size(); i += 2)
+    {
+        summary[i] = 127;
+        summary[i + 1] = -127;
+    }
+
+    for (juce::int64 pos = 0; pos < length; pos += kChunkSamples)
+    {
+        const int count = static_cast<int>(juce::jmin(static_cast<juce::int64>(kChunkSamples), length - pos));
+
+        if (source.embedded != nullptr)
+            source.embedded->read(chunk, 0, count, source.start + pos);
+        else
+            source.reader->read(&chunk, 0, count, source.start + pos, true, true);
+
+        for (int ch = 0; ch < source.numChannels; ++ch)
+        {
+            const auto* samples = chunk.getReadPointer(ch);
+            auto* pairs = summary.data() + 2 * static_cast<size_t>(source.numBuckets) * static_cast<size_t>(ch);
+
+            for (int i = 0; i < count; ++i)
+            {
+                const auto bucket = static_cast<size_t>((pos + i) / BundleAudio::kSummaryBucket);
+                const auto level = static_cast<juce::int8>(juce::jlimit(-127, 127, juce::roundToInt(samples[i] * 127.0f)));
+                pairs[2 * bucket] = juce::jmin(pairs[2 * bucket], level);
+                pairs[2 * bucket + 1] = juce::jmax(pairs[2 * bucket + 1], level);
+            }
+
+            if (!out.setPosition(source.dataOffset + source.planeStride * ch + pos * bytes))
+                return false;
+
+            if (source.format == BundleAudio::Format::Float32)
+            {
+                if (!out.write(samples, static_cast<size_t>(count) * sizeof(float)))
+                    return false;
+
+                continue;
+            }
+
+            // Integer sources come back as n / 32768 exactly, so this is lossless
+            for (int i = 0; i < count; ++i)
+                packed[static_cast<size_t>(i)] = static_cast<juce::int16>(juce::jlimit(-32768, 32767, juce::roundToInt(samples[i] * 32768.0f)));
+
+            if (!out.write(packed.data(), static_cast<size_t>(count) * sizeof(juce::int16)))
+                return false;
+        }
+    }
+
+    // Past the last plane's padding, which the file system fills with zeros
+    return out.setPosition(source.summaryOffset)
+        && out.write(summary.data(), summary.size())
+        && out.writeRepeatedByte(0, static_cast<size_t>(align(out.getPosition()) - out.getPosition()));
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <functional>
+#include <vector>
+#include "Preset.h"
+
+// The part of one source file a bundle's layers use, stored in the bundle as
+// planar PCM with a min/max summary for drawing.  Positions are the source
+// file's samples; outside the embedded region it reads as silence.
+struct BundleAudio
+{
+    enum class Format { Float32 = 0, Int16 = 1 };
+
+    juce::File source;
+    double sampleRate = 0.0;
+    int numChannels = 0;
+    juce::int64 totalLength = 0;       // of the source file
+    juce::int64 regionStart = 0;
+    juce::int64 regionLength = 0;
+    Format format = Format::Float32;
+
+    // Inside the mapped bundle
+    const char* planes = nullptr;      // one per channel, planeStride bytes apart
+    size_t planeStride = 0;
+    const juce::int8* summary = nullptr;    // per channel, numBuckets (min, max) pairs
+    int numBuckets = 0;
+
+    // Any thread.  Never locks or allocates; float data is copied straight
+    // out of the mapping.
+    void read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples, juce::int64 filePos) const;
+
+    // Faults the pages behind [start, end) in, so the audio thread doesn't
+    void touch(juce::int64 start, juce::int64 end) const;
+
+    // One channel's lowest and highest sample over [start, end), as far as
+    // the summary can tell
+    juce::Range<float> getLevelRange(int channel, juce::int64 start, juce::int64 end) const;
+
+    static constexpr int kSummaryBucket = 256;
+};
+
+// A preset and the audio it plays in one file, for moving a scene between
+// machines.
+//
+// The engine state is stored as packed binary rather than JSON and the audio
+// as PCM, so opening a bundle parses no text and decodes nothing: the file
+// is memory-mapped and layers play straight out of the mapping.  Only what
+// the layers can reach is embedded: a loop's region and playlist segments,
+// the part of a one-shot that is ever played, and whole sequence files.
+// 16-bit sources are kept as 16-bit, everything else as 32-bit float.
+// Planes and summaries start on page boundaries.  The room impulse is still
+// referenced by path.
+//
+// Layers keep their original file paths; the engine looks them up here, so a
+// preset saved from a bundle on a machine without the files embeds the same
+// audio again.
+class SoundscapeBundle
+{
+public:
+    explicit SoundscapeBundle(const juce::File& file);
+
+    bool isValid() const { return valid; }
+    const Preset& getPreset() const { return preset; }
+
+    // The embedded audio for one of the preset's files, or nullptr
+    const BundleAudio* findAudio(const juce::File& source) const;
+
+    // Writes preset and the audio its layers use.  Audio that findEmbedded
+    // returns is copied from there, and everything else read from disk;
+    // fails if any layer's audio can't be found either way.
+    static bool write(const juce::File& file, const Preset& preset, juce::AudioFormatManager& formatManager,
+                      const std::function<const BundleAudio*(const juce::File&)>& findEmbedded);
+
+    static constexpr const char* kFileExtension = ".dremscape";
+
+private:
+    // One file to embed while a bundle is being written
+    struct Source
+    {
+        juce::File file;
+        const BundleAudio* embedded = nullptr;
+        std::unique_ptr<juce::AudioFormatReader> reader;
+        double sampleRate = 0.0;
+        int numChannels = 0;
+        juce::int64 totalLength = 0;
+        juce::int64 start = 0;
+        juce::int64 end = 0;
+        BundleAudio::Format format = BundleAudio::Format::Float32;
+        juce::int64 dataOffset = 0;
+        juce::int64 planeStride = 0;
+        juce::int64 summaryOffset = 0;
+        int numBuckets = 0;
+    };
+
+    bool parse();
+
+    static Source* addSource(std::vector<std::unique_ptr<Source>>& sources, const juce::File& file,
+                             juce::AudioFormatManager& formatManager,
+                             const std::function<const BundleAudio*(const juce::File&)>& findEmbedded);
+    static void writeState(juce::OutputStream& out, const Preset& state);
+    static bool readState(juce::InputStream& in, Preset& state);
+    static void writeTable(juce::OutputStream& out, const std::vector<std::unique_ptr<Source>>& sources);
+    static bool writeAudio(juce::OutputStream& out, Source& source);
+    static juce::int64 align(juce::int64 offset) { return (offset + kAlignment - 1) / kAlignment * kAlignment; }
+    static int bytesPerSample(BundleAudio::Format format) { return format == BundleAudio::Format::Int16 ? 2 : 4; }
+
+    juce::MemoryMappedFile mapped;
+    Preset preset;
+    std::vector<BundleAudio> audio;
+    bool valid = false;
+
+    static constexpr juce::int32 kMagic = 0x534d5244;   // "DRMS"
+    static constexpr juce::int32 kVersion = 1;
+    static constexpr int kHeaderBytes = 16;
+    static constexpr juce::int64 kAlignment = 4096;
+    static constexpr int kMaxChannels = 8;
+    static constexpr int kChunkSamples = 65536;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoundscapeBundle)
+};
@@ -0,0 +1,555 @@
+#include "SoundscapeEngine.h"
+#include <algorithm>
+
+static_assert(RenderAheadSource::kAheadSeconds <= AnalysisTap::kMaxBurstSeconds,
+              "the master tap's ring must hold a whole render-ahead refill");
+
+SoundscapeEngine::SoundscapeEngine()
+{
+    formatManager.registerBasicFormats();
+    readAheadThread.startThread(juce::Thread::Priority::normal);
+
+    analysisEngine.addTap(&masterTap);
+    masterLimiter.setOutputTap(&masterTap);
+
+    qualityGovernor.onLevelChanged = [this](QualityGovernor::Level) { applyQuality(); };
+}
+
+SoundscapeEngine::~SoundscapeEngine()
+{
+    for (auto& pending : pendingScenes)
+        pending->cancelled.store(true);
+
+    preloader.removeAllJobs(true, 5000);
+
+    // A half-written bundle is no use to anyone, so a save is let finish
+    bundleWriter.removeAllJobs(false, -1);
+
+    for (auto& pending : pendingScenes)
+        discardScene(*pending);
+
+    removeAllLayers();
+    mixer.removeAllInputs();
+    masterLimiter.setOutputTap(nullptr);
+    analysisEngine.removeTap(&masterTap);
+    readAheadThread.stopThread(500);
+}
+
+SoundscapeEngine::Status SoundscapeEngine::getStatus() const
+{
+    Status status;
+    status.playing = engineTransport.isPlaying();
+    status.numLayers = numLayers.load();
+    status.cpuLoad = renderAhead.getCpuLoad();
+    status.underruns = renderAhead.getUnderrunCount() + roomReverb.getUnderrunCount();
+    status.quality = quality.load();
+    return status;
+}
+
+EngineLayer* SoundscapeEngine::addLayer(const PresetLayer& settings)
+{
+    auto layer = std::make_unique<EngineLayer>(formatManager, readAheadThread, engineTransport);
+    layer->getGate().setScene(currentScene);
+
+    // Add to the mixer first so the transport is prepared before it loads
+    attachLayer(*layer);
+
+    if (!layer->load(settings))
+    {
+        detachLayer(*layer);
+        return nullptr;
+    }
+
+    analysisEngine.addTap(&layer->getAnalysisTap());
+    layer->setTargetLoudness(targetLoudness);
+    layer->setLinearCrossfades(quality.load() >= QualityGovernor::Level::LinearCrossfades);
+    requestLoudness(*layer);
+
+    if (engineTransport.isPlaying())
+        layer->startPlayback();
+
+    auto* added = layers.add(layer.release());
+    numLayers.store(layers.size());
+    return added;
+}
+
+void SoundscapeEngine::removeLayer(EngineLayer* layer)
+{
+    if (layer == nullptr || !layers.contains(layer))
+        return;
+
+    // A scene still loading can no longer keep this one
+    for (auto& pending : pendingScenes)
+        std::replace(pending->kept.begin(), pending->kept.end(), layer, static_cast<EngineLayer*>(nullptr));
+
+    detachLayer(*layer);
+    layers.removeObject(layer, true);
+    numLayers.store(layers.size());
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::removeAllLayers()
+{
+    for (auto& pending : pendingScenes)
+        std::fill(pending->kept.begin(), pending->kept.end(), nullptr);
+
+    for (auto* layer : layers)
+        detachLayer(*layer);
+    for (auto* layer : outgoing)
+        detachLayer(*layer);
+
+    layers.clear();
+    outgoing.clear();
+    numLayers.store(0);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::attachLayer(EngineLayer& layer)
+{
+    mixer.addInputSource(&layer.getGate(), &layer.getToneControl(), &layer.getAnalysisTap());
+}
+
+void SoundscapeEngine::detachLayer(EngineLayer& layer)
+{
+    mixer.removeInputSource(&layer.getGate());
+    analysisEngine.removeTap(&layer.getAnalysisTap());
+}
+
+bool SoundscapeEngine::playsSameFiles(const PresetLayer& wanted, const PresetLayer& current)
+{
+    return wanted.kind == current.kind && wanted.files == current.files;
+}
+
+void SoundscapeEngine::loadPreset(const Preset& preset, double crossfadeSeconds,
+                                  std::shared_ptr<const SoundscapeBundle> bundle)
+{
+    // Whatever is still loading has been overtaken
+    for (auto& pending : pendingScenes)
+        pending->cancelled.store(true);
+
+    auto pending = std::make_shared<PendingScene>();
+    pending->scene = nextScene++;
+    pending->preset = preset;
+    pending->preset.layers.clear();
+    pending->crossfadeSeconds = crossfadeSeconds;
+    pending->bundle = std::move(bundle);
+
+    std::vector<PresetLayer> playing;
+    std::vector<bool> claimed(static_cast<size_t>(layers.size()), false);
+
+    for (auto* layer : layers)
+        playing.push_back(layer->describe());
+
+    for (const auto& layerSettings : preset.layers)
+    {
+        // Sequences and event layers have already dropped missing files
+        if (layerSettings.files.isEmpty())
+            continue;
+
+        const auto& file = layerSettings.files.getFirst();
+        const bool embedded = pending->bundle != nullptr && pending->bundle->findAudio(file) != nullptr;
+
+        if (layerSettings.kind == PresetLayer::Kind::Loop && !embedded && !file.existsAsFile())
+        {
+            juce::Logger::writeToLog("Layer file missing: " + file.getFullPathName());
+            continue;
+        }
+
+        // Each playing layer can be kept for one of the new ones at most
+        EngineLayer* keep = nullptr;
+        for (size_t i = 0; i < playing.size() && keep == nullptr; ++i)
+        {
+            if (!claimed[i] && playsSameFiles(layerSettings, playing[i]))
+            {
+                claimed[i] = true;
+                keep = layers[static_cast<int>(i)];
+            }
+        }
+
+        pending->preset.layers.push_back(layerSettings);
+        pending->kept.push_back(keep);
+        pending->loaded.emplace_back();
+    }
+
+    pendingScenes.push_back(pending);
+    preloadScene(pending);
+}
+
+bool SoundscapeEngine::loadBundle(const juce::File& file, double crossfadeSeconds)
+{
+    auto bundle = std::make_shared<const SoundscapeBundle>(file);
+    if (!bundle->isValid())
+        return false;
+
+    loadPreset(bundle->getPreset(), crossfadeSeconds, bundle);
+    return true;
+}
+
+void SoundscapeEngine::saveBundle(const juce::File& file, const Preset& preset, std::function<void(bool)> onSaved)
+{
+    // Whatever is playing from a bundle can be saved again without its files.
+    // The bundles are held for the worker, which leaves the layers alone.
+    std::vector<std::shared_ptr<const SoundscapeBundle>> bundles;
+    for (auto* layer : layers)
+        if (auto& bundle = layer->getBundle())
+            bundles.push_back(bundle);
+
+    juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+    bundleWriter.addJob([this, weakThis, file, preset, bundles, onSaved]
+    {
+        const bool saved = SoundscapeBundle::write(file, preset, formatManager,
+                                                   [&bundles](const juce::File& source) -> const BundleAudio*
+        {
+            for (auto& bundle : bundles)
+                if (auto* embedded = bundle->findAudio(source))
+                    return embedded;
+
+            return nullptr;
+        });
+
+        juce::MessageManager::callAsync([weakThis, saved, onSaved]
+        {
+            if (weakThis.get() != nullptr)
+                onSaved(saved);
+        });
+    });
+}
+
+void SoundscapeEngine::preloadScene(std::shared_ptr<PendingScene> pending)
+{
+    juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+    // Opening readers and decoding one-shots is what used to stall a switch;
+    // none of these layers is in the mixer yet, so the worker has them alone
+    preloader.addJob([this, weakThis, pending]
+    {
+        for (size_t i = 0; i < pending->kept.size() && !pending->cancelled.load(); ++i)
+        {
+            if (pending->kept[i] != nullptr)
+                continue;
+
+            const auto& settings = pending->preset.layers[i];
+            auto layer = std::make_unique<EngineLayer>(formatManager, readAheadThread, engineTransport);
+            layer->setBundle(pending->bundle);
+
+            if (layer->load(settings))
+                pending->loaded[i] = std::move(layer);
+            else
+                juce::Logger::writeToLog("Couldn't load layer: " + settings.files.getFirst().getFullPathName());
+        }
+
+        juce::MessageManager::callAsync([weakThis, pending]
+        {
+            if (auto* self = weakThis.get())
+                self->primeScene(pending);
+        });
+    });
+}
+
+void SoundscapeEngine::primeScene(std::shared_ptr<PendingScene> pending)
+{
+    auto found = std::find(pendingScenes.begin(), pendingScenes.end(), pending);
+    if (found == pendingScenes.end())
+        return;
+
+    if (pending != pendingScenes.back())
+    {
+        discardScene(*pending);
+        pendingScenes.erase(found);
+        return;
+    }
+
+    // Into the mixer with their gates shut, so they are prepared for the
+    // device while the prefetcher fills their heads
+    if (!pending->attached)
+    {
+        for (auto& layer : pending->loaded)
+        {
+            if (layer != nullptr)
+            {
+                layer->getGate().setScene(pending->scene);
+                attachLayer(*layer);
+            }
+        }
+
+        pending->attached = true;
+    }
+
+    bool primed = true;
+    for (auto& layer : pending->loaded)
+        primed = primed && (layer == nullptr || layer->isPrimed());
+
+    // A slow disk only costs a few cache misses, which decode in place
+    if (!primed && pending->primeWaitMs < kMaxPrimeWaitMs)
+    {
+        pending->primeWaitMs += kPrimePollMs;
+        juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+        juce::Timer::callAfterDelay(kPrimePollMs, [weakThis, pending]
+        {
+            if (auto* self = weakThis.get())
+                self->primeScene(pending);
+        });
+        return;
+    }
+
+    pendingScenes.erase(found);
+    switchScene(*pending);
+}
+
+void SoundscapeEngine::discardScene(PendingScene& pending)
+{
+    // Only called once the worker is done with the scene
+    if (pending.attached)
+        for (auto& layer : pending.loaded)
+            if (layer != nullptr)
+                detachLayer(*layer);
+
+    pending.loaded.clear();
+}
+
+void SoundscapeEngine::switchScene(PendingScene& pending)
+{
+    juce::Array<EngineLayer*> leaving;
+    for (auto* layer : layers)
+        leaving.add(layer);
+
+    layers.clear(false);
+
+    for (size_t i = 0; i < pending.kept.size(); ++i)
+    {
+        if (auto* kept = pending.kept[i])
+        {
+            const auto before = kept->describe();
+            kept->applySettings(pending.preset.layers[i]);
+            kept->getGate().setScene(pending.scene);
+            leaving.removeFirstMatchingValue(kept);
+            layers.add(kept);
+
+            const auto after = kept->describe();
+            if (after.loopStart != before.loopStart || after.loopEnd != before.loopEnd)
+                requestLoudness(*kept);
+        }
+        else if (pending.loaded[i] != nullptr)
+        {
+            auto* added = layers.add(pending.loaded[i].release());
+            analysisEngine.addTap(&added->getAnalysisTap());
+            added->setLinearCrossfades(quality.load() >= QualityGovernor::Level::LinearCrossfades);
+            requestLoudness(*added);
+        }
+    }
+
+    for (auto* layer : leaving)
+    {
+        layer->getGate().retire();
+        outgoing.add(layer);
+    }
+
+    numLayers.store(layers.size());
+    currentScene = pending.scene;
+    applyMasterSettings(pending.preset);
+
+    // One event, so the old scene starts fading on the sample the new one does
+    if (engineTransport.isPlaying())
+    {
+        engineTransport.setSceneFadeSeconds(pending.crossfadeSeconds);
+        engineTransport.changeScene(pending.scene);
+    }
+
+    // Kept until the fade has been heard, including any wait for the grid
+    // line and audio already rendered ahead, so a rewind can still redo it
+    const auto fadeSeconds = juce::jmax(engineTransport.getSceneFadeSeconds() + engineTransport.getStartGrid(),
+                                        engineTransport.getFadeOutSeconds());
+    retireLayers(leaving, fadeSeconds + RenderAheadSource::kAheadSeconds + kRetireMarginSeconds);
+
+    if (onSceneChanged)
+        onSceneChanged();
+}
+
+void SoundscapeEngine::retireLayers(const juce::Array<EngineLayer*>& retiring, double afterSeconds)
+{
+    if (retiring.isEmpty())
+        return;
+
+    juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+    juce::Timer::callAfterDelay(juce::roundToInt(afterSeconds * 1000.0), [weakThis, retiring]
+    {
+        auto* self = weakThis.get();
+        if (self == nullptr)
+            return;
+
+        for (auto* layer : retiring)
+        {
+            if (!self->outgoing.contains(layer))
+                continue;
+
+            self->detachLayer(*layer);
+            self->outgoing.removeObject(layer, true);
+        }
+    });
+}
+
+void SoundscapeEngine::applyMasterSettings(const Preset& preset)
+{
+    masterLimiter.setMasterGain(preset.masterVolume);
+    filteredOutput.setHighPassFrequency(preset.hpfCutoff);
+    filteredOutput.setLowShelfGain(preset.lowShelfGain);
+    filteredOutput.setHighShelfGain(preset.highShelfGain);
+    filteredOutput.setLowPassFrequency(preset.lpfCutoff);
+    roomReverb.setWetLevel(preset.reverbWet);
+    engineTransport.setFadeTimes(preset.fadeInSeconds, preset.fadeOutSeconds);
+    engineTransport.setStartGrid(preset.startGridSeconds);
+    setTargetLoudness(preset.targetLoudness);
+
+    // The same room carries on rather than being built again
+    if (preset.reverbImpulse != roomReverb.getImpulseFile())
+    {
+        if (preset.reverbImpulse.existsAsFile())
+        {
+            loadRoomImpulse(preset.reverbImpulse);
+        }
+        else
+        {
+            if (preset.reverbImpulse != juce::File{})
+                juce::Logger::writeToLog("Impulse response missing: " + preset.reverbImpulse.getFullPathName());
+
+            clearRoomImpulse();
+        }
+    }
+
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::requestLoudness(EngineLayer& layer)
+{
+    auto* looping = layer.getLoopingSource();
+    if (looping == nullptr)
+        return;
+
+    const auto loopStart = looping->getLoopStart();
+    const auto loopEnd = looping->getLoopEnd();
+    auto* target = &layer;
+    juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+    loudnessAnalyzer.analyse(layer.getFilePath(), loopStart, loopEnd, [weakThis, target, loopStart, loopEnd](double lufs)
+    {
+        // The layer may have been removed while the measurement ran
+        auto* self = weakThis.get();
+        if (self == nullptr || !self->layers.contains(target) || target->getLoopingSource() == nullptr)
+            return;
+
+        // A result for a range the user has since dragged away from is stale
+        if (target->getLoopingSource()->getLoopStart() != loopStart
+            || target->getLoopingSource()->getLoopEnd() != loopEnd)
+            return;
+
+        // A file that is only in a bundle can't be measured here; keep
+        // the loudness the bundle brought
+        if (std::isnan(lufs))
+            return;
+
+        target->setMeasuredLoudness(lufs);
+    });
+}
+
+void SoundscapeEngine::setMasterVolume(float gain)
+{
+    masterLimiter.setMasterGain(gain);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::setMasterHighPass(float hz)
+{
+    filteredOutput.setHighPassFrequency(hz);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::setMasterLowShelf(float gainDb)
+{
+    filteredOutput.setLowShelfGain(gainDb);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::setMasterHighShelf(float gainDb)
+{
+    filteredOutput.setHighShelfGain(gainDb);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::setMasterLowPass(float hz)
+{
+    filteredOutput.setLowPassFrequency(hz);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::setTargetLoudness(double lufs)
+{
+    targetLoudness = lufs;
+
+    for (auto* layer : layers)
+        layer->setTargetLoudness(lufs);
+}
+
+void SoundscapeEngine::loadRoomImpulse(const juce::File& file)
+{
+    juce::WeakReference<SoundscapeEngine> weakThis(this);
+
+    roomReverb.loadImpulse(file, [weakThis, file](bool loaded)
+    {
+        auto* self = weakThis.get();
+        if (self == nullptr)
+            return;
+
+        self->engineTransport.parameterChanged();
+
+        if (loaded)
+            return;
+
+        juce::Logger::writeToLog("Couldn't read impulse response: " + file.getFullPathName());
+
+        if (self->roomReverb.getImpulseFile() == file)
+            self->roomReverb.clearImpulse();
+
+        self->notifyRoomChanged();
+    });
+
+    notifyRoomChanged();
+}
+
+void SoundscapeEngine::clearRoomImpulse()
+{
+    roomReverb.clearImpulse();
+    engineTransport.parameterChanged();
+    notifyRoomChanged();
+}
+
+void SoundscapeEngine::setRoomWet(float level)
+{
+    roomReverb.setWetLevel(level);
+    engineTransport.parameterChanged();
+}
+
+void SoundscapeEngine::notifyRoomChanged()
+{
+    if (onRoomChanged)
+        onRoomChanged();
+}
+
+void SoundscapeEngine::applyQuality()
+{
+    // Deliberately not a parameter change: re-rendering the ahead buffer
+    // would cost exactly the time the governor is trying to win back
+    using Level = QualityGovernor::Level;
+    const auto level = qualityGovernor.getLevel();
+    quality.store(level);
+
+    mixer.setLayerMetersEnabled(level < Level::NoLayerMeters);
+    mixer.setLayerFiltersEnabled(level < Level::NoLayerFilters);
+    mixer.setCullQuietLayers(level >= Level::CullQuietLayers);
+    roomReverb.setSuspended(level >= Level::NoRoom);
+
+    for (auto* layer : layers)
+        layer->setLinearCrossfades(level >= Level::LinearCrossfades);
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "EngineLayer.h"
+#include "EngineTransport.h"
+#include "LayerMixer.h"
+#include "FilteredAudioSource.h"
+#include "ConvolutionReverb.h"
+#include "MasterLimiter.h"
+#include "RenderAheadSource.h"
+#include "QualityGovernor.h"
+#include "LoudnessAnalyzer.h"
+#include "LoopPointFinder.h"
+#include "AnalysisEngine.h"
+#include "AnalysisTap.h"
+#include "Preset.h"
+#include "SoundscapeBundle.h"
+
+// Everything that makes sound, with no GUI: the layers, the mixer, the
+// shared transport, the master bus (filters, room, limiter and
+// render-ahead), the quality governor and the analysis behind the meters.
+// The owner plays getOutput() through a device or writes it to a file, and
+// must detach it before the engine goes.
+//
+// Control is message thread only.  getStatus(), the layers' getters and the
+// analysis taps can be read from anywhere without locking, which is all a
+// view needs to follow the engine.
+class SoundscapeEngine
+{
+public:
+    struct Status
+    {
+        bool playing = false;
+        int numLayers = 0;
+        float cpuLoad = 0.0f;           // whole mix, as a fraction of real time
+        int underruns = 0;              // render-ahead and room tail together
+        QualityGovernor::Level quality = QualityGovernor::Level::Full;
+    };
+
+    SoundscapeEngine();
+    ~SoundscapeEngine();
+
+    juce::AudioSource& getOutput() { return renderAhead; }
+    juce::AudioFormatManager& getFormatManager() { return formatManager; }
+    EngineTransport& getTransport() { return engineTransport; }
+    LoopPointFinder& getLoopPointFinder() { return loopPointFinder; }
+    AnalysisTap& getMasterTap() { return masterTap; }
+
+    Status getStatus() const;
+
+    // Replaces the scene without stopping.  Layers playing the same files as
+    // before are kept, with their readers and caches, and retuned; the rest
+    // are loaded on a worker while the old scene plays on.  Once their heads
+    // are in memory the new scene takes over: if the transport is running
+    // the two crossfade over crossfadeSeconds, starting on one sample.
+    // Layers whose files are missing are skipped with a log line, and a
+    // newer load supersedes one still in progress.  Files the bundle embeds
+    // are played from it, whether or not they are on disk.
+    void loadPreset(const Preset& preset, double crossfadeSeconds = kDefaultSceneFadeSeconds,
+                    std::shared_ptr<const SoundscapeBundle> bundle = nullptr);
+
+    // loadPreset() for a bundle file; false if it isn't one
+    bool loadBundle(const juce::File& file, double crossfadeSeconds = kDefaultSceneFadeSeconds);
+
+    // Writes preset with the audio it uses, taken from disk or from the
+    // bundles the layers are playing.  The copy runs on a worker; onSaved
+    // is called on the message thread with whether it succeeded.
+    void saveBundle(const juce::File& file, const Preset& preset, std::function<void(bool)> onSaved);
+
+    // Runs on the message thread once a loaded preset's layers have become
+    // getLayer()'s, while the old ones are still fading out
+    std::function<void()> onSceneChanged;
+
+    // The master bus, room and transport settings from a preset, leaving
+    // the layers alone
+    void applyMasterSettings(const Preset& preset);
+
+    // Loads and mixes one layer, or returns nullptr if it can't be read.
+    // The engine owns the layer until removeLayer().
+    EngineLayer* addLayer(const PresetLayer& settings);
+    void removeLayer(EngineLayer* layer);
+    void removeAllLayers();
+    int getNumLayers() const { return layers.size(); }
+    EngineLayer* getLayer(int index) const { return layers[index]; }
+    int indexOfLayer(const EngineLayer* layer) const { return layers.indexOf(layer); }
+
+    // Measures a loop layer's region for auto-gain; call again after the
+    // loop is edited
+    void requestLoudness(EngineLayer& layer);
+
+    void setMasterVolume(float gain);
+    void setMasterHighPass(float hz);
+    void setMasterLowShelf(float gainDb);
+    void setMasterHighShelf(float gainDb);
+    void setMasterLowPass(float hz);
+    void setTargetLoudness(double lufs);
+
+    // The room keeps playing its old impulse until the new one is ready.
+    // onRoomChanged runs on the message thread whenever the file changes,
+    // including when a load fails and the room is cleared.
+    void loadRoomImpulse(const juce::File& file);
+    void clearRoomImpulse();
+    juce::File getRoomImpulse() const { return roomReverb.getImpulseFile(); }
+    void setRoomWet(float level);
+    std::function<void()> onRoomChanged;
+
+    void start() { engineTransport.start(); }
+    void stop() { engineTransport.stop(); }
+    void seek(double seconds) { engineTransport.seek(seconds); }
+
+    // Takes effect the next time the output is prepared, so the owner
+    // should detach and reattach it around the call
+    void setRenderAheadEnabled(bool shouldRenderAhead) { renderAhead.setEnabled(shouldRenderAhead); }
+    bool isRenderAheadEnabled() const { return renderAhead.isEnabled(); }
+
+    void setLowPower(bool shouldSaveWakeups) { renderAhead.setLowPower(shouldSaveWakeups); }
+
+    // The device's output latency plus one of its buffers, so the edit
+    // latency covers the whole way to the speaker
+    void setDeviceLatency(double seconds) { renderAhead.setDeviceLatency(seconds); }
+
+    // Time from the latest setting change to hearing it, in milliseconds
+    double getEditLatencyMs() const { return renderAhead.getEditLatencyMs(); }
+
+    // With nothing drawing the meters, analysis only runs now and then
+    void setAnalysisIdle(bool shouldIdle) { analysisEngine.setIdle(shouldIdle); }
+
+    static constexpr double kDefaultSceneFadeSeconds = 2.0;
+
+private:
+    // A preset on its way in.  For each of its layers, either the playing
+    // layer it keeps or the one loaded for it in the background.
+    struct PendingScene
+    {
+        int scene = 0;
+        Preset preset;
+        double crossfadeSeconds = 0.0;
+        std::shared_ptr<const SoundscapeBundle> bundle;
+        std::vector<EngineLayer*> kept;
+        std::vector<std::unique_ptr<EngineLayer>> loaded;
+        bool attached = false;
+        int primeWaitMs = 0;
+        std::atomic<bool> cancelled { false };
+    };
+
+    void attachLayer(EngineLayer& layer);
+    void detachLayer(EngineLayer& layer);
+    void preloadScene(std::shared_ptr<PendingScene> pending);
+    void primeScene(std::shared_ptr<PendingScene> pending);
+    void discardScene(PendingScene& pending);
+    void switchScene(PendingScene& pending);
+    void retireLayers(const juce::Array<EngineLayer*>& retiring, double afterSeconds);
+    static bool playsSameFiles(const PresetLayer& wanted, const PresetLayer& current);
+
+    void applyQuality();
+    void notifyRoomChanged();
+
+    juce::AudioFormatManager formatManager;
+    juce::TimeSliceThread readAheadThread { "audio-read-ahead" };
+    LoudnessAnalyzer loudnessAnalyzer { formatManager };
+    LoopPointFinder loopPointFinder { formatManager };
+    AnalysisEngine analysisEngine;
+    AnalysisTap masterTap;
+
+    LayerMixer mixer;
+    EngineTransport engineTransport { &mixer };
+    FilteredAudioSource filteredOutput { &engineTransport };
+    ConvolutionReverb roomReverb { &filteredOutput, formatManager };
+    MasterLimiter masterLimiter { &roomReverb, engineTransport };
+    RenderAheadSource renderAhead { &masterLimiter, engineTransport };
+
+    // Sheds processing when the whole chain runs close to real time
+    QualityGovernor qualityGovernor { [this] { return renderAhead.getCpuLoad(); } };
+
+    juce::OwnedArray<EngineLayer> layers;
+    juce::OwnedArray<EngineLayer> outgoing;     // fading out after a scene change
+    std::atomic<int> numLayers { 0 };
+    int currentScene = 0;
+    int nextScene = 1;
+
+    // Loading or priming, newest last.  The engine deletes their layers
+    // itself, so none can outlive it in a queued callback.
+    std::vector<std::shared_ptr<PendingScene>> pendingScenes;
+    std::atomic<QualityGovernor::Level> quality { QualityGovernor::Level::Full };
+    double targetLoudness = -23.0;
+
+    // Last, so their jobs are finished before anything they use goes.  A
+    // bundle write has its own, so a long copy doesn't hold up a scene.
+    juce::ThreadPool preloader { 1 };
+    juce::ThreadPool bundleWriter { 1 };
+
+    static constexpr int kPrimePollMs = 20;
+    static constexpr int kMaxPrimeWaitMs = 2000;
+    static constexpr double kRetireMarginSeconds = 0.25;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(SoundscapeEngine)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SoundscapeEngine)
+};
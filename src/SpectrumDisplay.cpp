@@ -0,0 +1,92 @@
+#include "SpectrumDisplay.h"
+#include <cmath>
+
+SpectrumDisplay::SpectrumDisplay(const AnalysisTap& analysisTap)
+    : tap(analysisTap)
+{
+    setInterceptsMouseClicks(false, false);
+    startTimerHz(30);
+}
+
+SpectrumDisplay::~SpectrumDisplay()
+{
+    stopTimer();
+}
+
+void SpectrumDisplay::setAnimating(bool shouldAnimate)
+{
+    if (shouldAnimate == isTimerRunning())
+        return;
+
+    if (shouldAnimate)
+        startTimerHz(30);
+    else
+        stopTimer();
+}
+
+float SpectrumDisplay::frequencyToX(float hz, float width) const
+{
+    return width * std::log(hz / kMinHz) / std::log(kMaxHz / kMinHz);
+}
+
+float SpectrumDisplay::dbToY(float db, float height) const
+{
+    const float proportion = (juce::jlimit(kMinDb, kMaxDb, db) - kMinDb) / (kMaxDb - kMinDb);
+    return height * (1.0f - proportion);
+}
+
+void SpectrumDisplay::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colour(0xff181825));
+
+    const auto width = static_cast<float>(getWidth());
+    const auto height = static_cast<float>(getHeight());
+
+    // Decade grid lines
+    g.setColour(juce::Colours::white.withAlpha(0.1f));
+    for (float hz : { 100.0f, 1000.0f, 10000.0f })
+        g.fillRect(frequencyToX(hz, width), 0.0f, 1.0f, height);
+
+    const double sampleRate = tap.getSampleRate();
+    if (sampleRate <= 0.0)
+        return;
+
+    const auto binHz = static_cast<float>(sampleRate / AnalysisTap::kFftSize);
+
+    // High bins are far denser than pixels, so each pixel column takes the
+    // loudest bin that lands in it
+    juce::Path path;
+    bool started = false;
+    int lastX = -1;
+    float columnDb = kMinDb;
+
+    for (int bin = 1; bin < AnalysisTap::kNumBins; ++bin)
+    {
+        const float hz = static_cast<float>(bin) * binHz;
+        if (hz < kMinHz || hz > kMaxHz)
+            continue;
+
+        const int x = static_cast<int>(frequencyToX(hz, width));
+        columnDb = x == lastX ? juce::jmax(columnDb, snapshot.spectrumDb[static_cast<size_t>(bin)])
+                              : snapshot.spectrumDb[static_cast<size_t>(bin)];
+
+        const auto point = juce::Point<float>(static_cast<float>(x), dbToY(columnDb, height));
+
+        if (!started)
+            path.startNewSubPath(point);
+        else
+            path.lineTo(point);
+
+        started = true;
+        lastX = x;
+    }
+
+    g.setColour(juce::Colour(0xff89b4fa));
+    g.strokePath(path, juce::PathStrokeType(1.5f));
+}
+
+void SpectrumDisplay::timerCallback()
+{
+    snapshot = tap.getSnapshot();
+    repaint();
+}
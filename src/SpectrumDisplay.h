@@ -0,0 +1,32 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "AnalysisTap.h"
+
+// Log-frequency magnitude spectrum of one AnalysisTap
+class SpectrumDisplay : public juce::Component, private juce::Timer
+{
+public:
+    explicit SpectrumDisplay(const AnalysisTap& tap);
+    ~SpectrumDisplay() override;
+
+    // Stops the refresh timer while nobody can see the display
+    void setAnimating(bool shouldAnimate);
+
+    void paint(juce::Graphics& g) override;
+
+private:
+    void timerCallback() override;
+    float frequencyToX(float hz, float width) const;
+    float dbToY(float db, float height) const;
+
+    const AnalysisTap& tap;
+    AnalysisTap::Snapshot snapshot;
+
+    static constexpr float kMinHz = 20.0f;
+    static constexpr float kMaxHz = 20000.0f;
+    static constexpr float kMinDb = -90.0f;
+    static constexpr float kMaxDb = 0.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpectrumDisplay)
+};
@@ -0,0 +1,396 @@
+#include "StreamingAudioSource.h"
+#include "SoundscapeBundle.h"
+#include <algorithm>
+#include <thread>
+
+StreamingAudioSource::StreamingAudioSource(juce::AudioFormatManager& formatManager, const juce::File& file,
+                                           juce::TimeSliceThread& backgroundThread, size_t memoryBudgetBytes,
+                                           std::shared_ptr<const SoundscapeBundle> bundleToPlayFrom)
+    : thread(backgroundThread),
+      bundle(std::move(bundleToPlayFrom))
+{
+    embedded = bundle != nullptr ? bundle->findAudio(file) : nullptr;
+
+    if (embedded != nullptr)
+    {
+        sampleRate = embedded->sampleRate;
+        numFileChannels = embedded->numChannels;
+        lengthInSamples = embedded->totalLength;
+        hintLoopEnd.store(lengthInSamples);
+
+        thread.addTimeSliceClient(this);
+        return;
+    }
+
+    bundle.reset();
+    prefetchReader.reset(formatManager.createReaderFor(file));
+    directReader.reset(formatManager.createReaderFor(file));
+
+    if (!isValid())
+    {
+        prefetchReader.reset();
+        directReader.reset();
+        return;
+    }
+
+    sampleRate = prefetchReader->sampleRate;
+    numFileChannels = static_cast<int>(prefetchReader->numChannels);
+    lengthInSamples = prefetchReader->lengthInSamples;
+    numPages = (lengthInSamples + kPageSize - 1) / kPageSize;
+
+    const auto bytesPerPage = static_cast<size_t>(kPageSize) * static_cast<size_t>(numFileChannels) * sizeof(float);
+    const auto budgetPages = static_cast<juce::int64>(memoryBudgetBytes / bytesPerPage);
+    numSlots = static_cast<int>(juce::jlimit(static_cast<juce::int64>(1), juce::jmax(static_cast<juce::int64>(1), numPages),
+                                             budgetPages));
+
+    slots = std::make_unique<Slot[]>(static_cast<size_t>(numSlots));
+
+    pageToSlot = std::make_unique<std::atomic<int>[]>(static_cast<size_t>(numPages));
+    for (juce::int64 p = 0; p < numPages; ++p)
+        pageToSlot[p].store(-1);
+
+    hintLoopEnd.store(lengthInSamples);
+
+    thread.addTimeSliceClient(this);
+}
+
+StreamingAudioSource::~StreamingAudioSource()
+{
+    if (isValid())
+        thread.removeTimeSliceClient(this);
+}
+
+void StreamingAudioSource::prepareToPlay(int, double)
+{
+}
+
+void StreamingAudioSource::releaseResources()
+{
+}
+
+void StreamingAudioSource::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    const auto pos = nextReadPos.load();
+    read(*bufferToFill.buffer, bufferToFill.startSample, bufferToFill.numSamples, pos);
+    nextReadPos.store(pos + bufferToFill.numSamples);
+}
+
+void StreamingAudioSource::setPlaybackHint(juce::int64 position, juce::int64 loopStart,
+                                           juce::int64 loopEnd, int crossfadeSamples, juce::int64 upcomingStart)
+{
+    hintPosition.store(position, std::memory_order_relaxed);
+    hintLoopStart.store(loopStart, std::memory_order_relaxed);
+    hintLoopEnd.store(loopEnd, std::memory_order_relaxed);
+    hintCrossfade.store(crossfadeSamples, std::memory_order_relaxed);
+    hintUpcoming.store(upcomingStart, std::memory_order_relaxed);
+}
+
+void StreamingAudioSource::prefetchFrom(juce::int64 position)
+{
+    hintPosition.store(position, std::memory_order_relaxed);
+    touched.store(false, std::memory_order_relaxed);
+}
+
+void StreamingAudioSource::read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples,
+                                juce::int64 filePos)
+{
+    if (embedded != nullptr)
+    {
+        embedded->read(dest, destStartSample, numSamples, filePos);
+        return;
+    }
+
+    int done = 0;
+
+    while (done < numSamples)
+    {
+        const auto absPos = filePos + done;
+
+        if (absPos < 0)
+        {
+            const int count = static_cast<int>(juce::jmin(static_cast<juce::int64>(numSamples - done), -absPos));
+            dest.clear(destStartSample + done, count);
+            done += count;
+            continue;
+        }
+
+        if (absPos >= lengthInSamples || !isValid())
+        {
+            dest.clear(destStartSample + done, numSamples - done);
+            return;
+        }
+
+        const auto page = absPos / kPageSize;
+        const int offsetInPage = static_cast<int>(absPos - page * kPageSize);
+        const int count = static_cast<int>(juce::jmin(static_cast<juce::int64>(numSamples - done),
+                                                      static_cast<juce::int64>(kPageSize - offsetInPage),
+                                                      lengthInSamples - absPos));
+
+        if (!copyFromPage(page, offsetInPage, dest, destStartSample + done, count))
+        {
+            // Fast path: decode the miss right here rather than output a gap
+            cacheMisses.fetch_add(1, std::memory_order_relaxed);
+            directReader->read(&dest, destStartSample + done, count, absPos, true, true);
+        }
+
+        done += count;
+    }
+}
+
+bool StreamingAudioSource::copyFromPage(juce::int64 page, int offsetInPage, juce::AudioBuffer<float>& dest,
+                                        int destStartSample, int numSamples)
+{
+    const int slotIndex = pageToSlot[page].load(std::memory_order_acquire);
+    if (slotIndex < 0)
+        return false;
+
+    auto& slot = slots[slotIndex];
+
+    // Pin the slot, then re-check it wasn't evicted between the lookup and the pin.
+    // The prefetcher unmaps a page before waiting for readers to drain.
+    slot.readers.fetch_add(1);
+    if (pageToSlot[page].load() != slotIndex)
+    {
+        slot.readers.fetch_sub(1);
+        return false;
+    }
+
+    for (int ch = 0; ch < dest.getNumChannels(); ++ch)
+        dest.copyFrom(ch, destStartSample, slot.data, juce::jmin(ch, numFileChannels - 1), offsetInPage, numSamples);
+
+    slot.lastUsed.store(useClock.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.readers.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+bool StreamingAudioSource::isRangeResident(juce::int64 startSample, juce::int64 endSample) const
+{
+    if (!isValid())
+        return false;
+
+    // The mapping is the cache, once the prefetcher has been through it
+    if (embedded != nullptr)
+        return touched.load(std::memory_order_acquire);
+
+    const auto first = juce::jmax(static_cast<juce::int64>(0), startSample) / kPageSize;
+    const auto last = (juce::jmin(endSample, lengthInSamples) - 1) / kPageSize;
+
+    for (auto p = first; p <= last; ++p)
+        if (pageToSlot[p].load(std::memory_order_acquire) < 0)
+            return false;
+
+    return true;
+}
+
+void StreamingAudioSource::buildWantedPages()
+{
+    wantedPages.clear();
+
+    const auto pos = hintPosition.load(std::memory_order_relaxed);
+    auto lStart = hintLoopStart.load(std::memory_order_relaxed);
+    auto lEnd = hintLoopEnd.load(std::memory_order_relaxed);
+    const auto xfade = static_cast<juce::int64>(juce::jmax(0, hintCrossfade.load(std::memory_order_relaxed)));
+    auto upcoming = hintUpcoming.load(std::memory_order_relaxed);
+
+    // Hints are written field by field; a torn set only mis-aims one slice
+    lStart = juce::jlimit(static_cast<juce::int64>(0), lengthInSamples, lStart);
+    lEnd = juce::jlimit(static_cast<juce::int64>(0), lengthInSamples, lEnd);
+    upcoming = upcoming >= 0 ? juce::jmin(upcoming, lengthInSamples) : lStart;
+
+    auto addRange = [this](juce::int64 start, juce::int64 end)
+    {
+        start = juce::jmax(static_cast<juce::int64>(0), start);
+        end = juce::jmin(lengthInSamples, end);
+        if (end <= start)
+            return;
+
+        for (auto p = start / kPageSize; p <= (end - 1) / kPageSize; ++p)
+            if (static_cast<int>(wantedPages.size()) < 4 * numSlots)
+                wantedPages.push_back(p);
+    };
+
+    const auto prefetch = static_cast<juce::int64>(kPrefetchSeconds * sampleRate);
+    const bool loopValid = lEnd - lStart > 2 * xfade && lEnd > lStart;
+
+    if (loopValid)
+    {
+        // Head first: the crossfade reads it alongside the tail and every wrap
+        // lands here.  With a playlist that is the next segment's head, which
+        // has to be in before this segment's tail starts.  A separate head
+        // reader covers the crossfade itself, leaving only what follows it.
+        if (headStreamedSeparately.load(std::memory_order_relaxed))
+            addRange(upcoming + xfade, upcoming + xfade + kPageSize);
+        else
+            addRange(upcoming, upcoming + xfade + kPageSize);
+
+        // Then the playback path ahead of the playhead, following the wrap
+        auto p = (pos >= lStart && pos < lEnd) ? pos : lStart;
+        auto remaining = prefetch;
+
+        for (int lap = 0; lap < 4 && remaining > 0; ++lap)
+        {
+            const auto runEnd = juce::jmin(lEnd, p + remaining);
+            addRange(p, runEnd);
+            remaining -= runEnd - p;
+            p = upcoming + xfade;
+
+            // Past the first wrap the next segment's bounds are unknown, so
+            // read straight on from its head
+            if (upcoming != lStart)
+            {
+                addRange(p, p + remaining);
+                break;
+            }
+        }
+
+        // Keep the whole loop resident when the budget allows
+        const auto loopPages = (lEnd - 1) / kPageSize - lStart / kPageSize + 1;
+        if (loopPages <= numSlots)
+            addRange(lStart, lEnd);
+    }
+    else
+    {
+        addRange(pos, pos + prefetch);
+    }
+
+    // De-duplicate in priority order and cap at what the cache can hold
+    wantedSorted = wantedPages;
+    std::sort(wantedSorted.begin(), wantedSorted.end());
+    wantedSorted.erase(std::unique(wantedSorted.begin(), wantedSorted.end()), wantedSorted.end());
+
+    wantedTaken.assign(wantedSorted.size(), 0);
+    size_t kept = 0;
+
+    for (size_t i = 0; i < wantedPages.size() && static_cast<int>(kept) < numSlots; ++i)
+    {
+        const auto page = wantedPages[i];
+        const auto index = static_cast<size_t>(std::lower_bound(wantedSorted.begin(), wantedSorted.end(), page)
+                                               - wantedSorted.begin());
+        if (wantedTaken[index] != 0)
+            continue;
+
+        wantedTaken[index] = 1;
+        wantedPages[kept++] = page;
+    }
+
+    wantedPages.resize(kept);
+
+    if (kept < wantedSorted.size())
+    {
+        wantedSorted = wantedPages;
+        std::sort(wantedSorted.begin(), wantedSorted.end());
+    }
+}
+
+int StreamingAudioSource::findVictimSlot() const
+{
+    int victim = -1;
+    juce::uint32 oldest = 0;
+
+    for (int i = 0; i < numAllocated; ++i)
+    {
+        const auto page = slots[i].page.load(std::memory_order_relaxed);
+        if (page < 0)
+            return i;
+
+        if (std::binary_search(wantedSorted.begin(), wantedSorted.end(), page))
+            continue;
+
+        const auto used = slots[i].lastUsed.load(std::memory_order_relaxed);
+        if (victim < 0 || used < oldest)
+        {
+            victim = i;
+            oldest = used;
+        }
+    }
+
+    return victim;
+}
+
+int StreamingAudioSource::addSlot()
+{
+    if (numAllocated >= numSlots)
+        return -1;
+
+    // Sized before any page maps to it, so the audio thread never sees it empty
+    slots[numAllocated].data.setSize(numFileChannels, kPageSize);
+    return numAllocated++;
+}
+
+void StreamingAudioSource::loadPage(juce::int64 page, int slotIndex)
+{
+    auto& slot = slots[slotIndex];
+
+    const auto oldPage = slot.page.load(std::memory_order_relaxed);
+    if (oldPage >= 0)
+    {
+        pageToSlot[oldPage].store(-1);
+
+        while (slot.readers.load() != 0)
+            std::this_thread::yield();
+    }
+
+    const auto start = page * kPageSize;
+    const int count = static_cast<int>(juce::jmin(static_cast<juce::int64>(kPageSize), lengthInSamples - start));
+
+    prefetchReader->read(&slot.data, 0, count, start, true, true);
+    if (count < kPageSize)
+        slot.data.clear(count, kPageSize - count);
+
+    slot.page.store(page, std::memory_order_relaxed);
+    slot.lastUsed.store(useClock.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    pageToSlot[page].store(slotIndex, std::memory_order_release);
+}
+
+void StreamingAudioSource::touchAhead()
+{
+    const auto pos = hintPosition.load(std::memory_order_relaxed);
+    const auto loopStart = hintLoopStart.load(std::memory_order_relaxed);
+    const auto loopEnd = hintLoopEnd.load(std::memory_order_relaxed);
+    const auto xfade = static_cast<juce::int64>(juce::jmax(0, hintCrossfade.load(std::memory_order_relaxed)));
+    const auto upcoming = hintUpcoming.load(std::memory_order_relaxed);
+    const auto head = upcoming >= 0 ? upcoming : loopStart;
+    const auto prefetch = static_cast<juce::int64>(kPrefetchSeconds * sampleRate);
+
+    // Where the loop wraps to, then the path ahead, reading on past a wrap
+    embedded->touch(head, head + xfade + kPageSize);
+    embedded->touch(pos, pos + prefetch);
+
+    if (loopEnd > loopStart && pos + prefetch > loopEnd)
+        embedded->touch(head + xfade, head + xfade + pos + prefetch - loopEnd);
+
+    touched.store(true, std::memory_order_release);
+}
+
+int StreamingAudioSource::useTimeSlice()
+{
+    if (embedded != nullptr)
+    {
+        touchAhead();
+        return 20;
+    }
+
+    buildWantedPages();
+
+    int loaded = 0;
+
+    for (auto page : wantedPages)
+    {
+        if (pageToSlot[page].load(std::memory_order_acquire) >= 0)
+            continue;
+
+        // Reuse a page nobody wants before growing the cache
+        auto victim = findVictimSlot();
+        if (victim < 0)
+            victim = addSlot();
+        if (victim < 0)
+            break;
+
+        loadPage(page, victim);
+
+        if (++loaded >= kPagesPerSlice)
+            return 1;
+    }
+
+    return loaded > 0 ? 1 : 20;
+}
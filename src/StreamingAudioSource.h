@@ -0,0 +1,132 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class SoundscapeBundle;
+struct BundleAudio;
+
+// Serves a file to the loop engine from a bounded page cache.
+//
+// A background TimeSliceClient fills pages ahead of the loop engine's playback
+// path (including the wrap to the loop head or the next segment's head) and keeps the whole loop
+// region resident when it fits the memory budget.  Pages are allocated by the
+// prefetcher as it first needs them, and it reuses pages it no longer wants
+// before taking more, so the budget is a ceiling: a long file played
+// straight through holds little more than the read-ahead.  The audio thread copies
+// resident pages without locking; a miss is decoded synchronously from a
+// reader reserved for the audio thread, so edits and seeks never wait for
+// the prefetcher.
+//
+// A file embedded in a SoundscapeBundle is instead read straight out of the
+// mapped bundle: there is nothing to decode or cache, and the background
+// client only touches the pages ahead of playback so the audio thread
+// doesn't fault them in.
+class StreamingAudioSource : public juce::PositionableAudioSource,
+                             private juce::TimeSliceClient
+{
+public:
+    StreamingAudioSource(juce::AudioFormatManager& formatManager, const juce::File& file,
+                         juce::TimeSliceThread& backgroundThread, size_t memoryBudgetBytes,
+                         std::shared_ptr<const SoundscapeBundle> bundle = nullptr);
+    ~StreamingAudioSource() override;
+
+    bool isValid() const { return embedded != nullptr || (prefetchReader != nullptr && directReader != nullptr); }
+    double getSampleRate() const { return sampleRate; }
+    int getNumChannels() const { return numFileChannels; }
+
+    // Called by the loop engine every block; read by the prefetcher.
+    // upcomingStart is where playback goes after loopEnd when that is not
+    // loopStart (the next segment of a playlist), or -1.
+    void setPlaybackHint(juce::int64 position, juce::int64 loopStart, juce::int64 loopEnd, int crossfadeSamples,
+                         juce::int64 upcomingStart = -1);
+
+    // Re-aims the prefetcher at a seek target before the audio thread gets there.
+    void prefetchFrom(juce::int64 position);
+
+    // Set when a second stream serves the crossfade head, so this one only
+    // needs the point the loop wraps to
+    void setHeadStreamedSeparately(bool separately) { headStreamedSeparately.store(separately); }
+
+    // Audio-thread read of [filePos, filePos + numSamples) into dest.
+    void read(juce::AudioBuffer<float>& dest, int destStartSample, int numSamples, juce::int64 filePos);
+
+    bool isRangeResident(juce::int64 startSample, juce::int64 endSample) const;
+    int getCacheMissCount() const { return cacheMisses.load(); }
+
+    // PositionableAudioSource overrides
+    void prepareToPlay(int samplesPerBlockExpected, double sampleRate) override;
+    void releaseResources() override;
+    void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+    void setNextReadPosition(juce::int64 newPosition) override { nextReadPos.store(newPosition); }
+    juce::int64 getNextReadPosition() const override { return nextReadPos.load(); }
+    juce::int64 getTotalLength() const override { return lengthInSamples; }
+    bool isLooping() const override { return false; }
+
+    static constexpr int kPageSize = 4096;
+
+private:
+    struct Slot
+    {
+        juce::AudioBuffer<float> data;
+        std::atomic<juce::int64> page { -1 };
+        std::atomic<int> readers { 0 };
+        std::atomic<juce::uint32> lastUsed { 0 };
+    };
+
+    int useTimeSlice() override;
+
+    bool copyFromPage(juce::int64 page, int offsetInPage, juce::AudioBuffer<float>& dest,
+                      int destStartSample, int numSamples);
+    void buildWantedPages();
+    int findVictimSlot() const;
+    int addSlot();
+    void loadPage(juce::int64 page, int slotIndex);
+    void touchAhead();
+
+    juce::TimeSliceThread& thread;
+
+    // Set when the file is played from a bundle, which is then kept open
+    std::shared_ptr<const SoundscapeBundle> bundle;
+    const BundleAudio* embedded = nullptr;
+    std::atomic<bool> touched { false };
+
+    // One reader per thread: readers are not thread-safe, and keeping the
+    // prefetcher's reader sequential avoids decoder seeks on compressed files
+    std::unique_ptr<juce::AudioFormatReader> prefetchReader;
+    std::unique_ptr<juce::AudioFormatReader> directReader;
+
+    double sampleRate = 0.0;
+    int numFileChannels = 0;
+    juce::int64 lengthInSamples = 0;
+    juce::int64 numPages = 0;
+
+    int numSlots = 0;          // the most the budget allows
+    int numAllocated = 0;      // how many have page buffers; prefetcher only
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<std::atomic<int>[]> pageToSlot;
+
+    std::atomic<juce::int64> nextReadPos { 0 };
+    std::atomic<juce::uint32> useClock { 0 };
+    std::atomic<int> cacheMisses { 0 };
+
+    std::atomic<juce::int64> hintPosition  { 0 };
+    std::atomic<juce::int64> hintLoopStart { 0 };
+    std::atomic<juce::int64> hintLoopEnd   { 0 };
+    std::atomic<int> hintCrossfade { 0 };
+    std::atomic<juce::int64> hintUpcoming { -1 };
+    std::atomic<bool> headStreamedSeparately { false };
+
+    // Prefetcher scratch, only touched on the background thread
+    std::vector<juce::int64> wantedPages;
+    std::vector<juce::int64> wantedSorted;
+    std::vector<char> wantedTaken;
+
+    static constexpr double kPrefetchSeconds = 2.0;
+    static constexpr int kPagesPerSlice = 8;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamingAudioSource)
+};
@@ -1,17 +1,13 @@
 #include "WaveformDisplay.h"
 #include "LoopingAudioSource.h"
+#include "EngineLayer.h"
 
-WaveformDisplay::WaveformDisplay(juce::AudioFormatManager& formatManager)
+WaveformDisplay::WaveformDisplay(juce::AudioFormatManager& formatManager, juce::AudioThumbnailCache& thumbnailCache)
     : thumbnail(512, formatManager, thumbnailCache)
 {
     thumbnail.addChangeListener(this);
 }
 
-void WaveformDisplay::setTransportSource(juce::AudioTransportSource* source)
-{
-    transport = source;
-}
-
 WaveformDisplay::~WaveformDisplay()
 {
     thumbnail.removeChangeListener(this);
@@ -21,21 +17,45 @@ WaveformDisplay::~WaveformDisplay()
 void WaveformDisplay::setFile(const juce::File& file)
 {
     thumbnail.setSource(new juce::FileInputSource(file));
+    summary = nullptr;
     fileLoaded = true;
-    startTimerHz(30);
+    if (animating)
+        startTimerHz(30);
+    repaint();
+}
+
+void WaveformDisplay::setSummary(const BundleAudio* audio)
+{
+    thumbnail.clear();
+    summary = audio;
+    fileLoaded = summary != nullptr;
+    if (animating && fileLoaded)
+        startTimerHz(30);
     repaint();
 }
 
 void WaveformDisplay::clear()
 {
     thumbnail.clear();
+    summary = nullptr;
     fileLoaded = false;
     loopingSource = nullptr;
     sampleRate = 0.0;
+    totalSamples = 0;
     stopTimer();
     repaint();
 }
 
+void WaveformDisplay::setAnimating(bool shouldAnimate)
+{
+    animating = shouldAnimate;
+
+    if (animating && fileLoaded)
+        startTimerHz(30);
+    else
+        stopTimer();
+}
+
 void WaveformDisplay::setLoopingSource(LoopingAudioSource* source)
 {
     loopingSource = source;
@@ -47,25 +67,46 @@ void WaveformDisplay::setSampleRate(double rate)
     sampleRate = rate;
 }
 
-float WaveformDisplay::sampleToX(juce::int64 sample) const
+// One column per pixel, each channel in its own band as the thumbnail
+// draws them.  Outside the embedded region there is only a centre line.
+void WaveformDisplay::drawSummary(juce::Graphics& g) const
+{
+    const auto width = getWidth();
+    const auto length = static_cast<double>(summary->totalLength);
+    const auto bandHeight = static_cast<float>(getHeight()) / static_cast<float>(summary->numChannels);
+
+    for (int ch = 0; ch < summary->numChannels; ++ch)
+    {
+        const auto centre = bandHeight * (static_cast<float>(ch) + 0.5f);
+
+        for (int x = 0; x < width; ++x)
+        {
+            const auto start = static_cast<juce::int64>(x * length / width);
+            const auto end = juce::jmax(start + 1, static_cast<juce::int64>((x + 1) * length / width));
+            const auto range = summary->getLevelRange(ch, start, end);
+
+            g.fillRect(static_cast<float>(x), centre - range.getEnd() * bandHeight * 0.5f,
+                       1.0f, juce::jmax(1.0f, range.getLength() * bandHeight * 0.5f));
+        }
+    }
+}
+
+// Positions stay in samples and doubles until the final pixel, so multi-hour
+// files keep sample-accurate handles and playheads
+double WaveformDisplay::sampleToX(juce::int64 sample) const
 {
-    const double totalSeconds = thumbnail.getTotalLength();
-    if (totalSeconds <= 0.0 || sampleRate <= 0.0)
-        return 0.0f;
+    if (totalSamples <= 0 || getWidth() <= 0)
+        return 0.0;
 
-    const double totalSamples = totalSeconds * sampleRate;
-    return static_cast<float>((static_cast<double>(sample) / totalSamples) * getWidth());
+    return static_cast<double>(sample) / static_cast<double>(totalSamples) * getWidth();
 }
 
-juce::int64 WaveformDisplay::xToSample(float x) const
+juce::int64 WaveformDisplay::xToSample(double x) const
 {
-    const double totalSeconds = thumbnail.getTotalLength();
-    if (totalSeconds <= 0.0 || sampleRate <= 0.0)
+    if (totalSamples <= 0 || getWidth() <= 0)
         return 0;
 
-    const double totalSamples = totalSeconds * sampleRate;
-    const double ratio = static_cast<double>(x) / getWidth();
-    return static_cast<juce::int64>(ratio * totalSamples);
+    return static_cast<juce::int64>(std::llround(x / getWidth() * static_cast<double>(totalSamples)));
 }
 
 void WaveformDisplay::paint(juce::Graphics& g)
@@ -74,7 +115,7 @@ void WaveformDisplay::paint(juce::Graphics& g)
 
     g.fillAll(juce::Colour(0xff1e1e2e));
 
-    if (!fileLoaded || thumbnail.getTotalLength() <= 0.0)
+    if (!fileLoaded || (summary == nullptr && thumbnail.getTotalLength() <= 0.0))
     {
         g.setColour(juce::Colours::grey);
         g.setFont(15.0f);
@@ -84,13 +125,22 @@ void WaveformDisplay::paint(juce::Graphics& g)
 
     // Draw waveform
     g.setColour(juce::Colour(0xff94e2d5));
-    thumbnail.drawChannels(g, getLocalBounds(), 0.0, thumbnail.getTotalLength(), 1.0f);
+    if (summary != nullptr)
+        drawSummary(g);
+    else
+        thumbnail.drawChannels(g, getLocalBounds(), 0.0, thumbnail.getTotalLength(), 1.0f);
+
+    // One snapshot per paint so the overlay never mixes old and new loop edits
+    const auto loopParams = loopingSource != nullptr ? loopingSource->getParameters()
+                                                     : LoopingAudioSource::Parameters {};
+    const auto playlist = loopingSource != nullptr ? loopingSource->getPlaylist()
+                                                   : LoopingAudioSource::Playlist {};
 
     // Draw loop region overlay
     if (loopingSource != nullptr && sampleRate > 0.0)
     {
-        const float startX = sampleToX(loopingSource->getLoopStart());
-        const float endX   = sampleToX(loopingSource->getLoopEnd());
+        const auto startX = static_cast<float>(sampleToX(loopParams.loopStart));
+        const auto endX   = static_cast<float>(sampleToX(loopParams.loopEnd));
 
         // Dim non-loop regions
         g.setColour(juce::Colour(0x80000000));
@@ -108,11 +158,12 @@ void WaveformDisplay::paint(juce::Graphics& g)
         g.fillRect(endX - 4.0f, bounds.getY(), 8.0f, 10.0f);
 
         // Crossfade zone overlays
-        const int xfadeSamples = loopingSource->getCrossfadeSamples();
+        const auto xfadeSamples = juce::jmin(static_cast<juce::int64>(loopParams.crossfadeSamples),
+                                             (loopParams.loopEnd - loopParams.loopStart) / 2);
         if (xfadeSamples > 0)
         {
-            const float xfadeHeadEndX = sampleToX(loopingSource->getLoopStart() + xfadeSamples);
-            const float xfadeTailStartX = sampleToX(loopingSource->getLoopEnd() - xfadeSamples);
+            const auto xfadeHeadEndX = static_cast<float>(sampleToX(loopParams.loopStart + xfadeSamples));
+            const auto xfadeTailStartX = static_cast<float>(sampleToX(loopParams.loopEnd - xfadeSamples));
 
             // Head zone overlay (blue tint at loop start)
             g.setColour(juce::Colour(0x3089b4fa));
@@ -126,27 +177,54 @@ void WaveformDisplay::paint(juce::Graphics& g)
             g.drawLine(xfadeHeadEndX, bounds.getY(), xfadeHeadEndX, bounds.getBottom(), 1.0f);
             g.drawLine(xfadeTailStartX, bounds.getY(), xfadeTailStartX, bounds.getBottom(), 1.0f);
         }
+
+        // Further playlist segments (amber bands)
+        for (int i = 0; i < playlist.numSegments; ++i)
+        {
+            const auto& segment = playlist.segments[static_cast<size_t>(i)];
+            const auto segStartX = static_cast<float>(sampleToX(segment.start));
+            const auto segEndX = static_cast<float>(sampleToX(segment.end));
+
+            g.setColour(juce::Colour(0x28f9e2af));
+            g.fillRect(segStartX, bounds.getY(), segEndX - segStartX, bounds.getHeight());
+            g.setColour(juce::Colour(0xa0f9e2af));
+            g.fillRect(segStartX, bounds.getBottom() - 4.0f, segEndX - segStartX, 4.0f);
+        }
     }
 
     // Draw playhead — wrap the transport's linear position into the loop region
-    if (transport != nullptr && loopingSource != nullptr && sampleRate > 0.0
-        && (transport->isPlaying() || transport->getCurrentPosition() > 0.0))
+    const auto playState = layer != nullptr ? layer->getPlayState() : EngineLayer::PlayState {};
+
+    if (layer != nullptr && loopingSource != nullptr && sampleRate > 0.0
+        && (playState.playing || playState.positionSeconds > 0.0))
     {
-        const auto posSamples = static_cast<juce::int64>(transport->getCurrentPosition() * sampleRate);
-        const auto lStart = loopingSource->getLoopStart();
-        const auto lEnd   = loopingSource->getLoopEnd();
+        // Show what is audible: the master limiter holds output back by its lookahead
+        const auto posSamples = static_cast<juce::int64>(std::floor((playState.positionSeconds - playState.latencySeconds)
+                                                                    * sampleRate));
+        const auto lStart = loopParams.loopStart;
+        const auto lEnd   = loopParams.loopEnd;
         const auto loopLen = lEnd - lStart;
 
-        if (loopLen > 0)
+        if (playlist.numSegments > 0)
+        {
+            // The engine reports a file position inside whichever segment is
+            // playing, so there is nothing to wrap
+            const auto x = static_cast<float>(sampleToX(juce::jmax(static_cast<juce::int64>(0), posSamples)));
+            g.setColour(juce::Colours::white);
+            g.drawLine(x, bounds.getY(), x, bounds.getBottom(), 2.0f);
+        }
+        else if (loopLen > 0)
         {
             juce::int64 wrapped;
-            const int xfadeSamps = loopingSource->getCrossfadeSamples();
+
+            // Same clamp as the loop engine, so the wrap below can't divide by zero
+            const auto xfadeSamps = juce::jmin(static_cast<juce::int64>(loopParams.crossfadeSamples), loopLen / 2);
 
             if (xfadeSamps > 0 && posSamples >= lEnd)
             {
-                const auto effectiveLen = loopLen - static_cast<juce::int64>(xfadeSamps);
+                const auto effectiveLen = loopLen - xfadeSamps;
                 auto offset = (posSamples - lEnd) % effectiveLen;
-                wrapped = lStart + static_cast<juce::int64>(xfadeSamps) + offset;
+                wrapped = lStart + xfadeSamps + offset;
             }
             else
             {
@@ -155,29 +233,29 @@ void WaveformDisplay::paint(juce::Graphics& g)
                     wrapped = lStart;
             }
 
-            const auto xfadeStart = lEnd - static_cast<juce::int64>(xfadeSamps);
+            const auto xfadeStart = lEnd - xfadeSamps;
 
             if (xfadeSamps > 0 && wrapped >= xfadeStart)
             {
-                const float progress = static_cast<float>(wrapped - xfadeStart)
-                                     / static_cast<float>(xfadeSamps);
+                const auto progress = static_cast<float>(static_cast<double>(wrapped - xfadeStart)
+                                                         / static_cast<double>(xfadeSamps));
                 const float tailAlpha = juce::jmax(0.15f, 1.0f - progress);
                 const float headAlpha = juce::jmax(0.15f, progress);
 
                 // Tail playhead (fading out)
-                const float tailX = sampleToX(wrapped);
+                const auto tailX = static_cast<float>(sampleToX(wrapped));
                 g.setColour(juce::Colours::white.withAlpha(tailAlpha));
                 g.drawLine(tailX, bounds.getY(), tailX, bounds.getBottom(), 2.0f);
 
                 // Head playhead (fading in)
                 const auto headPos = lStart + (wrapped - xfadeStart);
-                const float headX = sampleToX(headPos);
+                const auto headX = static_cast<float>(sampleToX(headPos));
                 g.setColour(juce::Colours::white.withAlpha(headAlpha));
                 g.drawLine(headX, bounds.getY(), headX, bounds.getBottom(), 2.0f);
             }
             else
             {
-                const float x = sampleToX(wrapped);
+                const auto x = static_cast<float>(sampleToX(wrapped));
                 g.setColour(juce::Colours::white);
                 g.drawLine(x, bounds.getY(), x, bounds.getBottom(), 2.0f);
             }
@@ -190,9 +268,9 @@ void WaveformDisplay::mouseDown(const juce::MouseEvent& event)
     if (loopingSource == nullptr || sampleRate <= 0.0)
         return;
 
-    const float mx = static_cast<float>(event.x);
-    const float startX = sampleToX(loopingSource->getLoopStart());
-    const float endX   = sampleToX(loopingSource->getLoopEnd());
+    const auto mx = static_cast<double>(event.x);
+    const auto startX = sampleToX(loopingSource->getLoopStart());
+    const auto endX   = sampleToX(loopingSource->getLoopEnd());
 
     if (std::abs(mx - startX) <= handleHitRadius)
         dragging = DragTarget::Start;
@@ -203,12 +281,12 @@ void WaveformDisplay::mouseDown(const juce::MouseEvent& event)
         dragging = DragTarget::None;
 
         // Click-to-seek: reposition the playhead to the click location
-        if (transport != nullptr)
+        if (layer != nullptr)
         {
             const juce::int64 loopStart = loopingSource->getLoopStart();
             const juce::int64 loopEnd   = loopingSource->getLoopEnd();
             const juce::int64 sample    = juce::jlimit(loopStart, loopEnd, xToSample(mx));
-            transport->setPosition(static_cast<double>(sample) / sampleRate);
+            layer->setPosition(static_cast<double>(sample) / sampleRate);
             repaint();
         }
     }
@@ -219,31 +297,29 @@ void WaveformDisplay::mouseDown(const juce::MouseEvent& event)
 
 void WaveformDisplay::mouseDrag(const juce::MouseEvent& event)
 {
-    if (dragging == DragTarget::None || loopingSource == nullptr || sampleRate <= 0.0)
+    if (dragging == DragTarget::None || layer == nullptr || loopingSource == nullptr || sampleRate <= 0.0)
         return;
 
-    const double totalSeconds = thumbnail.getTotalLength();
-    const auto totalSamples = static_cast<juce::int64>(totalSeconds * sampleRate);
-
-    const float clampedX = juce::jlimit(0.0f, static_cast<float>(getWidth()), static_cast<float>(event.x));
+    const auto clampedX = juce::jlimit(0.0, static_cast<double>(getWidth()), static_cast<double>(event.x));
     juce::int64 sample = xToSample(clampedX);
 
-    juce::int64 loopStart = loopingSource->getLoopStart();
-    juce::int64 loopEnd   = loopingSource->getLoopEnd();
+    const auto loopParams = loopingSource->getParameters();
+    const juce::int64 loopStart = loopParams.loopStart;
+    const juce::int64 loopEnd   = loopParams.loopEnd;
 
     const juce::int64 minLoopSamples = juce::jmax(
         static_cast<juce::int64>(256),
-        static_cast<juce::int64>(loopingSource->getCrossfadeSamples() * 2));
+        static_cast<juce::int64>(loopParams.crossfadeSamples * 2));
 
     if (dragging == DragTarget::Start)
     {
         sample = juce::jlimit(static_cast<juce::int64>(0), loopEnd - minLoopSamples, sample);
-        loopingSource->setLoopRange(sample, loopEnd);
+        layer->setLoopRange(sample, loopEnd);
     }
     else
     {
         sample = juce::jlimit(loopStart + minLoopSamples, totalSamples, sample);
-        loopingSource->setLoopRange(loopStart, sample);
+        layer->setLoopRange(loopStart, sample);
     }
 
     repaint();
@@ -251,6 +327,9 @@ void WaveformDisplay::mouseDrag(const juce::MouseEvent& event)
 
 void WaveformDisplay::mouseUp(const juce::MouseEvent&)
 {
+    if (dragging != DragTarget::None && loopingSource != nullptr && onLoopEdited)
+        onLoopEdited();
+
     dragging = DragTarget::None;
     setMouseCursor(juce::MouseCursor::NormalCursor);
 }
@@ -263,9 +342,9 @@ void WaveformDisplay::mouseMove(const juce::MouseEvent& event)
         return;
     }
 
-    const float mx = static_cast<float>(event.x);
-    const float startX = sampleToX(loopingSource->getLoopStart());
-    const float endX   = sampleToX(loopingSource->getLoopEnd());
+    const auto mx = static_cast<double>(event.x);
+    const auto startX = sampleToX(loopingSource->getLoopStart());
+    const auto endX   = sampleToX(loopingSource->getLoopEnd());
 
     if (std::abs(mx - startX) <= handleHitRadius || std::abs(mx - endX) <= handleHitRadius)
         setMouseCursor(juce::MouseCursor::LeftRightResizeCursor);
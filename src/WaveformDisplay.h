@@ -3,21 +3,37 @@
 #include <JuceHeader.h>
 
 class LoopingAudioSource;
+class EngineLayer;
+struct BundleAudio;
 
 class WaveformDisplay : public juce::Component,
                         public juce::ChangeListener,
                         private juce::Timer
 {
 public:
-    explicit WaveformDisplay(juce::AudioFormatManager& formatManager);
+    // Thumbnails are kept in the cache, so a display made again for the
+    // same file draws at once instead of reading it
+    WaveformDisplay(juce::AudioFormatManager& formatManager, juce::AudioThumbnailCache& thumbnailCache);
     ~WaveformDisplay() override;
 
-    void setTransportSource(juce::AudioTransportSource* source);
+    // The layer the playhead follows and that clicks and handle drags edit
+    void setLayer(EngineLayer* layerToFollow) { layer = layerToFollow; }
     void setFile(const juce::File& file);
+
+    // Draws a bundle's stored summary instead of reading the file, which
+    // may not be on this machine.  The audio must outlive the display.
+    void setSummary(const BundleAudio* audio);
     void clear();
 
     void setLoopingSource(LoopingAudioSource* source);
     void setSampleRate(double rate);
+    void setTotalLength(juce::int64 numSamples) { totalSamples = numSamples; }
+
+    // Stops the playhead timer while nobody can see the display
+    void setAnimating(bool shouldAnimate);
+
+    // Called when the user lets go of a loop handle
+    std::function<void()> onLoopEdited;
 
     // Component overrides
     void paint(juce::Graphics& g) override;
@@ -32,21 +48,24 @@ public:
 
 private:
     void timerCallback() override;
-    float sampleToX(juce::int64 sample) const;
-    juce::int64 xToSample(float x) const;
+    void drawSummary(juce::Graphics& g) const;
+    double sampleToX(juce::int64 sample) const;
+    juce::int64 xToSample(double x) const;
 
     enum class DragTarget { None, Start, End };
 
-    juce::AudioTransportSource* transport = nullptr;
-    juce::AudioThumbnailCache thumbnailCache { 5 };
+    EngineLayer* layer = nullptr;
     juce::AudioThumbnail thumbnail;
+    const BundleAudio* summary = nullptr;
 
     bool fileLoaded = false;
+    bool animating = true;
     LoopingAudioSource* loopingSource = nullptr;
     double sampleRate = 0.0;
+    juce::int64 totalSamples = 0;
     DragTarget dragging = DragTarget::None;
 
-    static constexpr float handleHitRadius = 8.0f;
+    static constexpr double handleHitRadius = 8.0;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformDisplay)
 };
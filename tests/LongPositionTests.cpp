@@ -0,0 +1,213 @@
+#include "EngineJuceHeader.h"
+#include "LoopingAudioSource.h"
+#include "StreamingAudioSource.h"
+#include "SoundscapeBundle.h"
+#include "SyntheticAudio.h"
+
+// Loop wrapping, the streaming page cache and bundle regions at positions
+// that don't fit in 32 bits, against synthetic material whose samples say
+// where they came from.
+class LongPositionTests : public juce::UnitTest
+{
+public:
+    LongPositionTests() : juce::UnitTest("Positions past 2^31 samples", "Engine") {}
+
+    void runTest() override
+    {
+        testLoopWrap(kPast31);
+        testLoopWrap(kPast32);
+        testStreaming();
+        testBundle();
+    }
+
+private:
+    // Whether buffer[startSample, +numSamples) on every channel is the
+    // synthetic material from position on
+    bool matches(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples, juce::int64 position)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < numSamples; ++i)
+                if (buffer.getSample(ch, startSample + i) != SyntheticAudio::sampleAt(position + i, ch))
+                    return false;
+
+        return true;
+    }
+
+    bool isSilent(const juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            if (buffer.getMagnitude(ch, startSample, numSamples) != 0.0f)
+                return false;
+
+        return true;
+    }
+
+    void testLoopWrap(juce::int64 loopStart)
+    {
+        beginTest("Loop wrap from " + juce::String(loopStart));
+
+        const auto loopEnd = loopStart + 10000;
+        SyntheticAudio::Source file(loopEnd + 100000, 2);
+        LoopingAudioSource looping(&file, false);
+        looping.prepareToPlay(kBlock, kSampleRate);
+        looping.setLoopRange(loopStart, loopEnd);
+
+        juce::AudioBuffer<float> buffer(2, kBlock);
+
+        // A plain cut lands exactly on the loop start
+        looping.setNextReadPosition(loopEnd - 100);
+        looping.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, kBlock));
+        expect(matches(buffer, 0, 100, loopEnd - 100), "tail before the wrap");
+        expect(matches(buffer, 100, kBlock - 100, loopStart), "head after the wrap");
+        expectEquals(looping.getNextReadPosition(), loopStart + kBlock - 100);
+
+        // A seek several laps past the end is folded back into the loop.  The start
+        // of the block ramps out of the old position, so check after that.
+        looping.setNextReadPosition(loopEnd + 7 * (loopEnd - loopStart) + 37);
+        looping.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, kBlock));
+        expect(matches(buffer, kDeclicked, kBlock - kDeclicked, loopStart + 37 + kDeclicked), "seek past the end");
+
+        // With a crossfade the head it blended in is skipped after the wrap,
+        // and each lap is that much shorter
+        const int xfade = 1000;
+        looping.setCrossfadeSamples(xfade);
+
+        looping.setNextReadPosition(loopEnd - 10);
+        looping.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, 20));
+        expectEquals(looping.getNextReadPosition(), loopStart + xfade + 10);
+
+        looping.setNextReadPosition(loopEnd + 3 * (loopEnd - loopStart - xfade) + 37);
+        looping.getNextAudioBlock(juce::AudioSourceChannelInfo(&buffer, 0, kBlock));
+        expect(matches(buffer, kDeclicked, kBlock - kDeclicked, loopStart + xfade + 37 + kDeclicked),
+               "seek past the end with a crossfade");
+    }
+
+    void testStreaming()
+    {
+        beginTest("Streaming page cache");
+
+        const auto length = kPast32 + 1234;
+        juce::AudioFormatManager formatManager;
+        formatManager.registerFormat(new SyntheticAudio::Format(length, 2, kSampleRate), true);
+
+        juce::TemporaryFile file(SyntheticAudio::kFileExtension);
+        expect(file.getFile().replaceWithText("synthetic"));
+
+        juce::TimeSliceThread thread("streaming test");
+        thread.startThread();
+
+        {
+            StreamingAudioSource stream(formatManager, file.getFile(), thread, kBudgetBytes);
+            expect(stream.isValid());
+            expectEquals(stream.getTotalLength(), length);
+
+            juce::AudioBuffer<float> buffer(2, kBlock);
+
+            // Across a page boundary past 2^31, before anything is cached
+            const auto boundary = (kPast31 / StreamingAudioSource::kPageSize + 1) * StreamingAudioSource::kPageSize;
+            stream.read(buffer, 0, kBlock, boundary - 100);
+            expect(matches(buffer, 0, kBlock, boundary - 100), "uncached read across a page");
+
+            // Past the end reads as silence
+            stream.read(buffer, 0, kBlock, length - 10);
+            expect(matches(buffer, 0, 10, length - 10), "last samples");
+            expect(isSilent(buffer, 10, kBlock - 10), "past the end");
+
+            // Once the prefetcher has the region, reads come from the cache
+            const auto loopStart = kPast32 - 50000;
+            stream.setPlaybackHint(loopStart, loopStart, loopStart + 40000, 0);
+            stream.prefetchFrom(loopStart);
+
+            for (int tries = 0; tries < 500 && !stream.isRangeResident(loopStart, loopStart + 40000); ++tries)
+                juce::Thread::sleep(10);
+
+            expect(stream.isRangeResident(loopStart, loopStart + 40000), "region never became resident");
+
+            const auto misses = stream.getCacheMissCount();
+            stream.read(buffer, 0, kBlock, loopStart + 30000);
+            expect(matches(buffer, 0, kBlock, loopStart + 30000), "cached read");
+            expectEquals(stream.getCacheMissCount(), misses);
+        }
+
+        thread.stopThread(1000);
+    }
+
+    void testBundle()
+    {
+        beginTest("Bundle regions");
+
+        const auto length = kPast32 + 1234;
+        juce::AudioFormatManager formatManager;
+        formatManager.registerFormat(new SyntheticAudio::Format(length, 2, kSampleRate), true);
+
+        juce::TemporaryFile source(SyntheticAudio::kFileExtension);
+        expect(source.getFile().replaceWithText("synthetic"));
+
+        PresetLayer layer;
+        layer.kind = PresetLayer::Kind::Loop;
+        layer.files.add(source.getFile());
+        layer.loopStart = kPast32 - 300000;
+        layer.loopEnd = kPast32 + 1000;
+
+        Preset preset;
+        preset.layers.push_back(layer);
+
+        juce::TemporaryFile bundleFile(SoundscapeBundle::kFileExtension);
+        expect(SoundscapeBundle::write(bundleFile.getFile(), preset, formatManager, nullptr));
+
+        auto bundle = std::make_shared<const SoundscapeBundle>(bundleFile.getFile());
+        expect(bundle->isValid());
+        expectEquals(static_cast<int>(bundle->getPreset().layers.size()), 1);
+        if (bundle->getPreset().layers.size() != 1)
+            return;
+
+        expectEquals(bundle->getPreset().layers.front().loopStart, layer.loopStart);
+        expectEquals(bundle->getPreset().layers.front().loopEnd, layer.loopEnd);
+
+        const auto* audio = bundle->findAudio(source.getFile());
+        expect(audio != nullptr);
+        if (audio == nullptr)
+            return;
+
+        expectEquals(audio->totalLength, length);
+        expectEquals(audio->regionStart, layer.loopStart);
+        expectEquals(audio->regionLength, layer.loopEnd - layer.loopStart);
+
+        // Silence up to the region, then the material
+        juce::AudioBuffer<float> buffer(2, kBlock);
+        audio->read(buffer, 0, kBlock, layer.loopStart - 100);
+        expect(isSilent(buffer, 0, 100), "before the region");
+        expect(matches(buffer, 100, kBlock - 100, layer.loopStart), "start of the region");
+
+        audio->read(buffer, 0, kBlock, layer.loopEnd - 100);
+        expect(matches(buffer, 0, 100, layer.loopEnd - 100), "end of the region");
+        expect(isSilent(buffer, 100, kBlock - 100), "after the region");
+
+        // The summary covers the region and nothing either side of it
+        const auto inside = audio->getLevelRange(0, layer.loopStart, layer.loopEnd);
+        expect(inside.getStart() < 0.0f && inside.getEnd() > 0.0f, "summary of the region");
+        expect(audio->getLevelRange(0, 0, layer.loopStart).isEmpty(), "summary before the region");
+
+        // A stream over the bundle plays the same samples
+        juce::TimeSliceThread thread("bundle test");
+        thread.startThread();
+
+        {
+            StreamingAudioSource stream(formatManager, source.getFile(), thread, kBudgetBytes, bundle);
+            expect(stream.isValid());
+            stream.read(buffer, 0, kBlock, kPast32 - 10);
+            expect(matches(buffer, 0, kBlock, kPast32 - 10), "stream over the bundle");
+        }
+
+        thread.stopThread(1000);
+    }
+
+    static constexpr juce::int64 kPast31 = (static_cast<juce::int64>(1) << 31) + 12345;
+    static constexpr juce::int64 kPast32 = (static_cast<juce::int64>(1) << 32) + 12345;
+    static constexpr double kSampleRate = 48000.0;
+    static constexpr int kBlock = 512;
+    static constexpr int kDeclicked = 300;    // past LoopingAudioSource's seek ramp
+    static constexpr size_t kBudgetBytes = 4 * 1024 * 1024;
+};
+
+static LongPositionTests longPositionTests;
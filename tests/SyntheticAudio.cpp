@@ -0,0 +1,77 @@
+#include "SyntheticAudio.h"
+
+float SyntheticAudio::sampleAt(juce::int64 position, int channel)
+{
+    const auto step = (position + 7 * channel) % kPeriod;
+    return static_cast<float>(step - kPeriod / 2) / static_cast<float>(kPeriod);
+}
+
+SyntheticAudio::Source::Source(juce::int64 lengthInSamples, int numChannels)
+    : length(lengthInSamples),
+      channels(numChannels)
+{
+}
+
+void SyntheticAudio::Source::getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill)
+{
+    auto& buffer = *bufferToFill.buffer;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        auto* dest = buffer.getWritePointer(ch, bufferToFill.startSample);
+
+        for (int i = 0; i < bufferToFill.numSamples; ++i)
+        {
+            const auto at = position + i;
+            dest[i] = at >= 0 && at < length ? sampleAt(at, juce::jmin(ch, channels - 1)) : 0.0f;
+        }
+    }
+
+    position += bufferToFill.numSamples;
+}
+
+SyntheticAudio::Format::Format(juce::int64 lengthInSamples, int numChannels, double sampleRate)
+    : juce::AudioFormat("Synthetic", kFileExtension),
+      length(lengthInSamples),
+      channels(numChannels),
+      rate(sampleRate)
+{
+}
+
+juce::AudioFormatReader* SyntheticAudio::Format::createReaderFor(juce::InputStream* sourceStream, bool)
+{
+    return new Reader(sourceStream, length, channels, rate);
+}
+
+SyntheticAudio::Reader::Reader(juce::InputStream* sourceStream, juce::int64 totalLength, int channelCount,
+                               double rate)
+    : juce::AudioFormatReader(sourceStream, "Synthetic")
+{
+    sampleRate = rate;
+    lengthInSamples = totalLength;
+    numChannels = static_cast<unsigned int>(channelCount);
+    bitsPerSample = 32;
+    usesFloatingPointData = true;
+}
+
+bool SyntheticAudio::Reader::readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                                         juce::int64 startSampleInFile, int numSamples)
+{
+    for (int ch = 0; ch < numDestChannels; ++ch)
+    {
+        if (destChannels[ch] == nullptr)
+            continue;
+
+        // Floating-point readers hand their samples back through the int pointers
+        auto* dest = reinterpret_cast<float*>(destChannels[ch]) + startOffsetInDestBuffer;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto at = startSampleInFile + i;
+            dest[i] = at >= 0 && at < lengthInSamples
+                ? sampleAt(at, juce::jmin(ch, static_cast<int>(numChannels) - 1)) : 0.0f;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "EngineJuceHeader.h"
+
+// Audio whose every sample says where it came from, so tests can check
+// positions without real files.  Values repeat every 32768 samples and are
+// exact in float and in 16-bit, so a copy can be compared sample for sample.
+//
+// The same material is offered as a PositionableAudioSource and, for code
+// that opens files, as an AudioFormat: register it with a format manager
+// and any file with the extension opens as a reader of the given length.
+// The file has to exist; its contents are ignored.
+class SyntheticAudio
+{
+public:
+    static float sampleAt(juce::int64 position, int channel);
+
+    static constexpr const char* kFileExtension = ".synth";
+
+    class Source : public juce::PositionableAudioSource
+    {
+    public:
+        Source(juce::int64 lengthInSamples, int numChannels);
+
+        void prepareToPlay(int, double) override {}
+        void releaseResources() override {}
+        void getNextAudioBlock(const juce::AudioSourceChannelInfo& bufferToFill) override;
+
+        void setNextReadPosition(juce::int64 newPosition) override { position = newPosition; }
+        juce::int64 getNextReadPosition() const override { return position; }
+        juce::int64 getTotalLength() const override { return length; }
+        bool isLooping() const override { return false; }
+
+    private:
+        juce::int64 length;
+        int channels;
+        juce::int64 position = 0;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Source)
+    };
+
+    class Format : public juce::AudioFormat
+    {
+    public:
+        Format(juce::int64 lengthInSamples, int numChannels, double sampleRate);
+
+        juce::Array<int> getPossibleSampleRates() override { return { juce::roundToInt(rate) }; }
+        juce::Array<int> getPossibleBitDepths() override { return { 32 }; }
+        bool canDoStereo() override { return true; }
+        bool canDoMono() override { return true; }
+
+        juce::AudioFormatReader* createReaderFor(juce::InputStream* sourceStream, bool deleteStreamIfOpeningFails) override;
+
+        using juce::AudioFormat::createWriterFor;
+        juce::AudioFormatWriter* createWriterFor(juce::OutputStream*, double, unsigned int, int,
+                                                 const juce::StringPairArray&, int) override { return nullptr; }
+
+    private:
+        juce::int64 length;
+        int channels;
+        double rate;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Format)
+    };
+
+private:
+    class Reader : public juce::AudioFormatReader
+    {
+    public:
+        Reader(juce::InputStream* sourceStream, juce::int64 totalLength, int channelCount, double rate);
+
+        bool readSamples(int* const* destChannels, int numDestChannels, int startOffsetInDestBuffer,
+                         juce::int64 startSampleInFile, int numSamples) override;
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Reader)
+    };
+
+    static constexpr juce::int64 kPeriod = 32768;
+};